@@ -0,0 +1,305 @@
+// Load time of one mesh as OBJ, as .glb through the Builder and as .glb
+// through openGlbSource().
+//
+// usage: glb_load_bench [model.glb] [runs]
+//
+// Without a model a 512x512 grid with normals and uvs is written to the
+// temporary directory as both .glb and .obj. The OBJ row needs the same mesh,
+// so for a given model it is only timed when a .obj of the same name sits
+// next to it. Every path ends in host copies of the buffers Model::upload()
+// fills, standing in for its staging memory, and the first run of each warms
+// the page cache and is not timed. Nothing is optimized, which is what the
+// direct path requires.
+
+#include "loaders/gltf_loader.hpp"
+#include "loaders/obj_loader.hpp"
+#include "model.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace vkEngine;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int GRID_SIZE = 512;
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67;  // "glTF"
+constexpr uint32_t CHUNK_JSON = 0x4E4F534A; // "JSON"
+constexpr uint32_t CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+struct Grid {
+  std::vector<Model::Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// a gently curved GRID_SIZE x GRID_SIZE quad grid
+Grid makeGrid() {
+  Grid grid;
+  for (int y = 0; y <= GRID_SIZE; y++) {
+    for (int x = 0; x <= GRID_SIZE; x++) {
+      float u = static_cast<float>(x) / GRID_SIZE;
+      float v = static_cast<float>(y) / GRID_SIZE;
+      Model::Vertex vertex{};
+      vertex.position = {u * 2.f - 1.f, .1f * (u * u - v), v * 2.f - 1.f};
+      vertex.color = glm::vec3{1.f};
+      vertex.normal = glm::normalize(glm::vec3{-.1f * u, 1.f, .05f});
+      vertex.uv = {u, v};
+      grid.vertices.push_back(vertex);
+    }
+  }
+  for (uint32_t y = 0; y < GRID_SIZE; y++) {
+    for (uint32_t x = 0; x < GRID_SIZE; x++) {
+      uint32_t a = y * (GRID_SIZE + 1) + x;
+      uint32_t b = a + GRID_SIZE + 1;
+      grid.indices.insert(grid.indices.end(), {a, b, b + 1, a, b + 1, a + 1});
+    }
+  }
+  return grid;
+}
+
+void writeObj(const Grid &grid, const std::string &filepath) {
+  std::ofstream file{filepath};
+  for (const Model::Vertex &vertex : grid.vertices) {
+    file << "v " << vertex.position.x << ' ' << vertex.position.y << ' '
+         << vertex.position.z << "\nvt " << vertex.uv.x << ' ' << vertex.uv.y
+         << "\nvn " << vertex.normal.x << ' ' << vertex.normal.y << ' '
+         << vertex.normal.z << '\n';
+  }
+  // OBJ indices start at 1
+  for (size_t i = 0; i < grid.indices.size(); i++) {
+    uint32_t index = grid.indices[i] + 1;
+    file << (i % 3 == 0 ? "f " : " ") << index << '/' << index << '/'
+         << index << (i % 3 == 2 ? "\n" : "");
+  }
+  if (!file) {
+    throw std::runtime_error("Failed to write " + filepath);
+  }
+}
+
+// one primitive with positions, normals, uvs and 32 bit indices, each in a
+// buffer view of its own
+void writeGlb(const Grid &grid, const std::string &filepath) {
+  std::vector<char> binary;
+  auto append = [&](const void *data, size_t size) {
+    size_t offset = binary.size();
+    binary.insert(binary.end(), static_cast<const char *>(data),
+                  static_cast<const char *>(data) + size);
+    return offset;
+  };
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> uvs;
+  for (const Model::Vertex &vertex : grid.vertices) {
+    positions.push_back(vertex.position);
+    normals.push_back(vertex.normal);
+    uvs.push_back(vertex.uv);
+  }
+  size_t vertexCount = grid.vertices.size();
+  size_t views[] = {
+      append(positions.data(), positions.size() * sizeof(glm::vec3)),
+      append(normals.data(), normals.size() * sizeof(glm::vec3)),
+      append(uvs.data(), uvs.size() * sizeof(glm::vec2)),
+      append(grid.indices.data(), grid.indices.size() * sizeof(uint32_t)),
+  };
+  size_t viewSizes[] = {
+      vertexCount * sizeof(glm::vec3), vertexCount * sizeof(glm::vec3),
+      vertexCount * sizeof(glm::vec2), grid.indices.size() * sizeof(uint32_t)};
+
+  std::ostringstream json;
+  json << R"({"asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],)"
+       << R"("nodes":[{"mesh":0}],"meshes":[{"primitives":[{"attributes":)"
+       << R"({"POSITION":0,"NORMAL":1,"TEXCOORD_0":2},"indices":3}]}],)"
+       << R"("buffers":[{"byteLength":)" << binary.size()
+       << R"(}],"bufferViews":[)";
+  for (size_t i = 0; i < 4; i++) {
+    json << (i ? "," : "") << R"({"buffer":0,"byteOffset":)" << views[i]
+         << R"(,"byteLength":)" << viewSizes[i] << '}';
+  }
+  // 5126 is FLOAT, 5125 UNSIGNED_INT
+  json << R"(],"accessors":[)"
+       << R"({"bufferView":0,"componentType":5126,"type":"VEC3","count":)"
+       << vertexCount << "},"
+       << R"({"bufferView":1,"componentType":5126,"type":"VEC3","count":)"
+       << vertexCount << "},"
+       << R"({"bufferView":2,"componentType":5126,"type":"VEC2","count":)"
+       << vertexCount << "},"
+       << R"({"bufferView":3,"componentType":5125,"type":"SCALAR","count":)"
+       << grid.indices.size() << "}]}";
+
+  // chunks are 4 byte aligned, JSON with spaces and binary with zeros
+  std::string text = json.str();
+  text.resize((text.size() + 3) & ~size_t{3}, ' ');
+  binary.resize((binary.size() + 3) & ~size_t{3}, 0);
+  uint32_t header[] = {GLB_MAGIC, 2,
+                       static_cast<uint32_t>(12 + 8 + text.size() + 8 +
+                                             binary.size())};
+  uint32_t jsonHeader[] = {static_cast<uint32_t>(text.size()), CHUNK_JSON};
+  uint32_t binaryHeader[] = {static_cast<uint32_t>(binary.size()), CHUNK_BIN};
+
+  std::ofstream file{filepath, std::ios::binary};
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(jsonHeader), sizeof(jsonHeader));
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  file.write(reinterpret_cast<const char *>(binaryHeader),
+             sizeof(binaryHeader));
+  file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+  if (!file) {
+    throw std::runtime_error("Failed to write " + filepath);
+  }
+}
+
+// host copies of the buffers Model::upload() fills
+struct Staging {
+  std::vector<glm::vec3> positions;
+  std::vector<char> attributes;
+  std::vector<glm::vec4> tangents;
+  std::vector<char> indices;
+};
+
+// what Model::createVertexBuffers() and createIndexBuffers() write
+void stage(const Model::MeshData &data, Staging &staging) {
+  constexpr size_t attributeSize =
+      sizeof(Model::Vertex) - sizeof(Model::Vertex::position);
+  staging.positions.resize(data.vertexCount);
+  staging.attributes.resize(size_t{data.vertexCount} * attributeSize);
+  staging.tangents.resize(data.hasTangents ? data.vertexCount : 0);
+  staging.indices.resize(size_t{data.indexCount} *
+                         Model::getIndexSize(data.indexType));
+
+  if (const Model::MeshSource *source = data.source) {
+    source->writePositions(staging.positions.data());
+    source->writeAttributes(staging.attributes.data());
+    if (data.hasTangents) {
+      source->writeTangents(staging.tangents.data());
+    }
+    source->writeIndices(staging.indices.data());
+    return;
+  }
+
+  for (uint32_t v = 0; v < data.vertexCount; v++) {
+    staging.positions[v] = data.vertices[v].position;
+    std::memcpy(staging.attributes.data() + v * attributeSize,
+                &data.vertices[v].color, attributeSize);
+  }
+  if (data.hasTangents) {
+    std::memcpy(staging.tangents.data(), data.tangents,
+                staging.tangents.size() * sizeof(glm::vec4));
+  }
+  std::memcpy(staging.indices.data(), data.indices, staging.indices.size());
+}
+
+// what Model(device, builder) uploads
+void stageBuilder(const Model::Builder &builder, Staging &staging) {
+  VkIndexType indexType = Model::getIndexType(builder.vertices.size());
+  std::vector<uint8_t> indices = Model::packIndices(builder.indices, indexType);
+  stage(Model::getMeshData(builder, indices.data(), indexType), staging);
+}
+
+struct Result {
+  double medianMs = 0.0;
+  size_t vertexCount = 0;
+};
+
+Result run(const std::function<void(Staging &)> &load, int runs) {
+  Staging staging;
+  load(staging);
+
+  std::vector<double> times;
+  for (int i = 0; i < runs; i++) {
+    auto start = Clock::now();
+    load(staging);
+    times.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], staging.positions.size()};
+}
+
+void report(const char *name, const Result &result) {
+  std::cout << name << ": " << result.medianMs << " ms, "
+            << result.vertexCount << " vertices\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+  try {
+    std::filesystem::path glbPath;
+    std::filesystem::path objPath;
+    if (argc > 1) {
+      glbPath = std::string{ENGINE_DIR} + argv[1];
+      objPath = std::filesystem::path{glbPath}.replace_extension(".obj");
+    } else {
+      std::filesystem::path directory =
+          std::filesystem::temp_directory_path();
+      glbPath = directory / "glb_load_bench.glb";
+      objPath = directory / "glb_load_bench.obj";
+      Grid grid = makeGrid();
+      writeGlb(grid, glbPath.string());
+      writeObj(grid, objPath.string());
+    }
+    std::string glb = glbPath.string();
+    std::string obj = objPath.string();
+
+    Model::LoadOptions options{};
+    options.optimizeMeshes = false;
+    options.normalGeneration = Model::NormalGeneration::None;
+    if (!openGlbSource(glb, options)) {
+      throw std::runtime_error(glb + " cannot be uploaded directly");
+    }
+
+    std::cout << glb << ", median of " << runs << " runs\n";
+    if (std::filesystem::exists(objPath)) {
+      Result parsed = run(
+          [&](Staging &staging) {
+            Model::Builder builder{};
+            loadObjParallel(obj, builder);
+            stageBuilder(builder, staging);
+          },
+          runs);
+      report("OBJ, Builder        ", parsed);
+    }
+    Result builder = run(
+        [&](Staging &staging) {
+          Model::Builder builder{};
+          loadGlb(glb, builder);
+          stageBuilder(builder, staging);
+        },
+        runs);
+    Result direct = run(
+        [&](Staging &staging) {
+          std::unique_ptr<Model::MeshSource> source =
+              openGlbSource(glb, options);
+          stage(source->getMeshData(), staging);
+        },
+        runs);
+    report(".glb, Builder       ", builder);
+    report(".glb, openGlbSource ", direct);
+    std::cout << "direct upload " << builder.medianMs / direct.medianMs
+              << "x faster than the Builder\n";
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
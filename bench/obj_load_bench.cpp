@@ -0,0 +1,138 @@
+// Parse throughput of loadObjParallel() against the tinyobj path it replaced.
+//
+// usage: obj_load_bench [model.obj] [runs]
+//
+// Without a model a grid of positions, uvs and normals is written to the
+// temporary directory, about 40 MB of v/vt/vn faces. Both parsers read the
+// same file and weld the same vertices, and the first run of each warms the
+// page cache and is not timed.
+
+#include "loaders/obj_loader.hpp"
+#include "model.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace vkEngine;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int GRID_SIZE = 512;
+
+// a GRID_SIZE x GRID_SIZE quad grid, every corner with its own uv and normal
+// index like an exporter writes them
+std::string writeGrid() {
+  std::string filepath =
+      (std::filesystem::temp_directory_path() / "obj_load_bench.obj").string();
+  std::ofstream file{filepath};
+  if (!file) {
+    throw std::runtime_error("Failed to create " + filepath);
+  }
+
+  for (int y = 0; y <= GRID_SIZE; y++) {
+    for (int x = 0; x <= GRID_SIZE; x++) {
+      float u = static_cast<float>(x) / GRID_SIZE;
+      float v = static_cast<float>(y) / GRID_SIZE;
+      file << "v " << u * 2.f - 1.f << ' ' << 0.1f * (u * u - v) << ' '
+           << v * 2.f - 1.f << '\n'
+           << "vt " << u << ' ' << v << '\n'
+           << "vn 0 1 0\n";
+    }
+  }
+  // OBJ indices start at 1
+  auto corner = [&](int x, int y) {
+    int index = y * (GRID_SIZE + 1) + x + 1;
+    file << ' ' << index << '/' << index << '/' << index;
+  };
+  for (int y = 0; y < GRID_SIZE; y++) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+      file << 'f';
+      corner(x, y);
+      corner(x, y + 1);
+      corner(x + 1, y + 1);
+      corner(x + 1, y);
+      file << '\n';
+    }
+  }
+  if (!file) {
+    throw std::runtime_error("Failed to write " + filepath);
+  }
+  return filepath;
+}
+
+struct Result {
+  double medianMs = 0.0;
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+};
+
+template <typename Load>
+Result run(Load load, const std::string &filepath, int runs) {
+  Model::Builder builder{};
+  load(filepath, builder);
+
+  std::vector<double> times;
+  for (int i = 0; i < runs; i++) {
+    auto start = Clock::now();
+    load(filepath, builder);
+    times.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], builder.vertices.size(),
+          builder.indices.size()};
+}
+
+void report(const char *name, const Result &result, uintmax_t fileSize) {
+  std::cout << name << ": " << result.medianMs << " ms, "
+            << static_cast<double>(fileSize) / (result.medianMs * 1e3)
+            << " MB/s, " << result.vertexCount << " vertices, "
+            << result.indexCount << " indices\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+
+  try {
+    std::string filepath = argc > 1 ? std::string{ENGINE_DIR} + argv[1]
+                                    : writeGrid();
+    uintmax_t fileSize = std::filesystem::file_size(filepath);
+
+    Result tinyobj = run(
+        [](const std::string &path, Model::Builder &builder) {
+          builder.loadTinyObj(path);
+        },
+        filepath, runs);
+    Result parallel = run(loadObjParallel, filepath, runs);
+
+    std::cout << filepath << ", "
+              << static_cast<double>(fileSize) / 1e6 << " MB, median of "
+              << runs << " runs\n";
+    report("tinyobj ", tinyobj, fileSize);
+    report("parallel", parallel, fileSize);
+    std::cout << "speedup " << tinyobj.medianMs / parallel.medianMs << "x\n";
+    if (tinyobj.vertexCount != parallel.vertexCount ||
+        tinyobj.indexCount != parallel.indexCount) {
+      std::cout << "the parsers disagree on the mesh\n";
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
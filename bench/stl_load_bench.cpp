@@ -0,0 +1,129 @@
+// Load time and vertex reduction of the STL loader against triangle soup.
+//
+// usage: stl_load_bench [model.stl] [runs]
+//
+// The soup baseline copies every facet into three vertices of its own, which
+// is what uploading STL without welding costs. Both paths read the same
+// mapping, and the first run of each warms the page cache and is not timed.
+
+#include "loaders/stl_loader.hpp"
+#include "mapped_file.hpp"
+#include "model.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace vkEngine;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t STL_HEADER_SIZE = 84;
+constexpr size_t STL_RECORD_SIZE = 50;
+
+glm::vec3 readVec3(const char *data) {
+  glm::vec3 value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// binary STL only, as an unwelded loader would read it
+void loadSoup(const std::string &filepath, Model::Builder &builder) {
+  MappedFile file{filepath, MappedFile::Access::Sequential};
+  uint32_t triangleCount = 0;
+  if (file.size() >= STL_HEADER_SIZE) {
+    std::memcpy(&triangleCount, file.data() + STL_HEADER_SIZE - 4,
+                sizeof(triangleCount));
+  }
+  if (file.size() != STL_HEADER_SIZE + uint64_t{triangleCount} * STL_RECORD_SIZE) {
+    throw std::runtime_error("the soup baseline needs a binary STL file");
+  }
+
+  builder.vertices.clear();
+  builder.indices.clear();
+  builder.vertices.reserve(size_t{triangleCount} * 3);
+  builder.indices.reserve(size_t{triangleCount} * 3);
+  for (size_t i = 0; i < triangleCount; i++) {
+    const char *record = file.data() + STL_HEADER_SIZE + i * STL_RECORD_SIZE;
+    for (size_t corner = 0; corner < 3; corner++) {
+      Model::Vertex vertex{};
+      vertex.position = readVec3(record + 12 + corner * 12);
+      vertex.color = glm::vec3{1.f};
+      vertex.normal = readVec3(record);
+      builder.indices.push_back(static_cast<uint32_t>(builder.vertices.size()));
+      builder.vertices.push_back(vertex);
+    }
+  }
+}
+
+struct Result {
+  double medianMs = 0.0;
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+};
+
+template <typename Load>
+Result run(Load load, const std::string &filepath, int runs) {
+  Model::Builder builder{};
+  load(filepath, builder);
+
+  std::vector<double> times;
+  for (int i = 0; i < runs; i++) {
+    auto start = Clock::now();
+    load(filepath, builder);
+    times.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], builder.vertices.size(),
+          builder.indices.size()};
+}
+
+void report(const char *name, const Result &result) {
+  // what Model uploads: the vertex streams and 32 bit indices at most
+  double uploadMb =
+      static_cast<double>(result.vertexCount * sizeof(Model::Vertex) +
+                          result.indexCount * sizeof(uint32_t)) /
+      1e6;
+  std::cout << name << ": " << result.medianMs << " ms, "
+            << result.vertexCount << " vertices, " << result.indexCount
+            << " indices, " << uploadMb << " MB before packing\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string filepath = std::string{ENGINE_DIR} +
+                         (argc > 1 ? argv[1]
+                                   : "models/L4_intervertebral_disc_3d.stl");
+  int runs = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+  try {
+    Result soup = run(loadSoup, filepath, runs);
+    Result welded = run(loadStl, filepath, runs);
+
+    std::cout << filepath << ", median of " << runs << " runs\n";
+    report("triangle soup", soup);
+    report("welded       ", welded);
+    std::cout << "vertex reduction "
+              << static_cast<double>(soup.vertexCount) /
+                     static_cast<double>(welded.vertexCount)
+              << "x, load time " << welded.medianMs / soup.medianMs
+              << "x the soup's\n";
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
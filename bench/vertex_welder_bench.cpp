@@ -0,0 +1,127 @@
+// VertexWelder against the std::unordered_map deduplication it replaced.
+//
+// usage: vertex_welder_bench [index count...]
+//
+// Each input references index count / 6 unique vertices, about the ratio of
+// a closed triangle mesh, in random order. That is the worst case for both
+// tables: real meshes reference vertices with far more locality. Vertices are
+// generated from their id while welding, so only the output is held in
+// memory and 50M indices fit in a few GB.
+
+#include "model.hpp"
+#include "utils.hpp"
+#include "vertex_welder.hpp"
+
+// libs
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace vkEngine;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// the hash Model::Builder used before the welder
+struct VertexHash {
+  size_t operator()(const Model::Vertex &vertex) const {
+    size_t seed = 0;
+    hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+    return seed;
+  }
+};
+
+Model::Vertex makeVertex(uint32_t id) {
+  float f = static_cast<float>(id);
+  Model::Vertex vertex{};
+  vertex.position = {f * .5f, f * .25f + 1.f, -f};
+  vertex.color = glm::vec3{1.f};
+  vertex.normal = {0.f, 1.f, 0.f};
+  vertex.uv = {f * 1e-3f, .5f};
+  return vertex;
+}
+
+struct Result {
+  double seconds = 0.0;
+  size_t vertexCount = 0;
+};
+
+// count and operator[], as loadModel deduplicated before
+Result weldUnorderedMap(const std::vector<uint32_t> &ids) {
+  auto start = Clock::now();
+  std::vector<Model::Vertex> vertices;
+  std::vector<uint32_t> indices;
+  indices.reserve(ids.size());
+  std::unordered_map<Model::Vertex, uint32_t, VertexHash> uniqueVertices{};
+  for (uint32_t id : ids) {
+    Model::Vertex vertex = makeVertex(id);
+    if (uniqueVertices.count(vertex) == 0) {
+      uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+      vertices.push_back(vertex);
+    }
+    indices.push_back(uniqueVertices[vertex]);
+  }
+  return {std::chrono::duration<double>(Clock::now() - start).count(),
+          vertices.size()};
+}
+
+Result weldVertexWelder(const std::vector<uint32_t> &ids, float epsilon) {
+  auto start = Clock::now();
+  std::vector<Model::Vertex> vertices;
+  std::vector<uint32_t> indices;
+  indices.reserve(ids.size());
+  VertexWelder welder{vertices, epsilon};
+  for (uint32_t id : ids) {
+    indices.push_back(welder.weld(makeVertex(id)));
+  }
+  return {std::chrono::duration<double>(Clock::now() - start).count(),
+          vertices.size()};
+}
+
+void report(const char *name, size_t indexCount, const Result &result) {
+  std::cout << "  " << name << result.seconds << " s, "
+            << static_cast<double>(indexCount) / result.seconds / 1e6
+            << " M indices/s, " << result.vertexCount << " vertices\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<size_t> indexCounts;
+  for (int i = 1; i < argc; i++) {
+    indexCounts.push_back(std::strtoull(argv[i], nullptr, 10));
+  }
+  if (indexCounts.empty()) {
+    indexCounts = {1000000, 10000000, 50000000};
+  }
+
+  for (size_t indexCount : indexCounts) {
+    uint32_t uniqueCount = static_cast<uint32_t>(std::max<size_t>(indexCount / 6, 1));
+    std::mt19937 random{5};
+    std::vector<uint32_t> ids(indexCount);
+    for (uint32_t &id : ids) {
+      id = random() % uniqueCount;
+    }
+
+    std::cout << indexCount << " indices, " << uniqueCount << " unique\n";
+    Result map = weldUnorderedMap(ids);
+    report("unordered_map:         ", indexCount, map);
+    Result exact = weldVertexWelder(ids, 0.f);
+    report("VertexWelder, exact:   ", indexCount, exact);
+    Result snapped = weldVertexWelder(ids, 1e-5f);
+    report("VertexWelder, epsilon: ", indexCount, snapped);
+    std::cout << "  speedup " << map.seconds / exact.seconds << "x exact, "
+              << map.seconds / snapped.seconds << "x epsilon\n";
+  }
+  return EXIT_SUCCESS;
+}
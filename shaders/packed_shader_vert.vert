@@ -0,0 +1,43 @@
+#version 450
+
+// Model::PackedVertex, the formats expand to floats on fetch
+layout(location = 0) in vec4 position; // unorm in the mesh bounds
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 normal; // octahedral
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	vec4 ambientLightColor;
+	vec3 lightPosition;
+	vec4 lightColor;
+} ubo;
+
+// push constant is limited to 128 bytes of memory
+// the model matrix also maps the mesh bounds back to model space
+layout(push_constant) uniform Push {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+} push;
+
+vec3 octahedralDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() {
+	vec4 positionWorld = push.modelMatrix * vec4(position.xyz, 1.0);
+	gl_Position = ubo.projection * (ubo.view * positionWorld);
+
+	fragNormalWorld = normalize(mat3(push.normalMatrix) * octahedralDecode(normal));
+	fragPosWorld = positionWorld.xyz;
+	fragColor = color.rgb;
+}
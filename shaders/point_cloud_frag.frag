@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	// round sprites, squares show their corners once points get large
+	vec2 offset = gl_PointCoord * 2.0 - 1.0;
+	if (dot(offset, offset) > 1.0) {
+		discard;
+	}
+	outColor = vec4(fragColor, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	vec4 ambientLightColor;
+	vec3 lightPosition;
+	vec4 lightColor;
+} ubo;
+
+layout(push_constant) uniform Push {
+	mat4 modelMatrix;
+	float pointSize;
+} push;
+
+void main() {
+	gl_Position = ubo.projection * (ubo.view * (push.modelMatrix * vec4(position, 1.0)));
+	// picked on the CPU from the cloud's size on screen and the points drawn
+	gl_PointSize = push.pointSize;
+	fragColor = color.rgb;
+}
@@ -0,0 +1,550 @@
+#include "allocator.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace vkEngine {
+
+namespace {
+
+// second level classes per power of two
+constexpr uint32_t SL_BITS = 4;
+constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+constexpr uint32_t NO_CHUNK = ~0u;
+// heaps at least this large get blocks of the allocator's block size
+constexpr VkDeviceSize LARGE_HEAP_SIZE = 1024ull * 1024 * 1024;
+
+uint32_t findFirstSet(uint64_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+}
+
+uint32_t findLastSet(uint64_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(63 - __builtin_clzll(x));
+#endif
+}
+
+// alignment is a power of two
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+  return value & ~(alignment - 1);
+}
+
+// size class of a free chunk: the power of two, then SL_BITS bits below it
+void getSizeClass(VkDeviceSize size, uint32_t &fl, uint32_t &sl) {
+  if (size < SL_COUNT) {
+    fl = 0;
+    sl = static_cast<uint32_t>(size);
+    return;
+  }
+  uint32_t msb = findLastSet(size);
+  fl = msb - SL_BITS + 1;
+  sl = static_cast<uint32_t>(size >> (msb - SL_BITS)) & (SL_COUNT - 1);
+}
+
+} // namespace
+
+// One vkAllocateMemory allocation, handed out in ranges by its strategy.
+class MemoryBlock {
+public:
+  MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void *mapped,
+              VkEngineAllocator::Strategy strategy, uint32_t pool)
+      : memory{memory}, size{size}, mapped{mapped}, strategy{strategy},
+        pool{pool} {
+    for (auto &heads : freeHeads) {
+      heads.fill(NO_CHUNK);
+    }
+    if (strategy == VkEngineAllocator::Strategy::Tlsf) {
+      chunks.push_back({0, size, NO_CHUNK, NO_CHUNK, NO_CHUNK, NO_CHUNK, true});
+      insertFree(0);
+    }
+  }
+
+  MemoryBlock(const MemoryBlock &) = delete;
+  MemoryBlock &operator=(const MemoryBlock &) = delete;
+
+  // false when no free range fits
+  bool allocate(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                VkDeviceSize &offset, uint32_t &chunk) {
+    bool found = strategy == VkEngineAllocator::Strategy::Linear
+                     ? allocateLinear(allocationSize, alignment, offset)
+                     : allocateTlsf(allocationSize, alignment, offset, chunk);
+    allocationCount += found;
+    return found;
+  }
+
+  void free(uint32_t chunk) {
+    allocationCount--;
+    if (strategy == VkEngineAllocator::Strategy::Linear) {
+      // ranges are only reused once all of them are free
+      if (allocationCount == 0) {
+        top = 0;
+      }
+      return;
+    }
+    freeTlsf(chunk);
+  }
+
+  bool empty() const { return allocationCount == 0; }
+
+  const VkDeviceMemory memory;
+  const VkDeviceSize size;
+  void *const mapped;
+  const VkEngineAllocator::Strategy strategy;
+  const uint32_t pool;
+
+private:
+  // a range of the block, linked to its physical neighbours and, while free,
+  // to the other free chunks of its size class
+  struct Chunk {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+    uint32_t prevFree;
+    uint32_t nextFree;
+    bool free;
+  };
+
+  bool allocateLinear(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                      VkDeviceSize &offset) {
+    VkDeviceSize start = alignUp(top, alignment);
+    if (start > size || allocationSize > size - start) {
+      return false;
+    }
+    offset = start;
+    top = start + allocationSize;
+    return true;
+  }
+
+  bool allocateTlsf(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                    VkDeviceSize &offset, uint32_t &chunk) {
+    // rounded up to the next class, whose chunks all fit before alignment
+    VkDeviceSize searchSize = allocationSize;
+    if (searchSize >= SL_COUNT) {
+      searchSize += (VkDeviceSize{1} << (findLastSet(searchSize) - SL_BITS)) - 1;
+    }
+    uint32_t fl, sl;
+    getSizeClass(searchSize, fl, sl);
+
+    while (findFreeClass(fl, sl)) {
+      for (uint32_t index = freeHeads[fl][sl]; index != NO_CHUNK;
+           index = chunks[index].nextFree) {
+        const Chunk &candidate = chunks[index];
+        VkDeviceSize start = alignUp(candidate.offset, alignment);
+        if (start + allocationSize <= candidate.offset + candidate.size) {
+          chunk = use(index, start, allocationSize);
+          offset = start;
+          return true;
+        }
+      }
+      // only the alignment padding didn't fit, try the larger classes
+      if (++sl == SL_COUNT) {
+        sl = 0;
+        if (++fl == FL_COUNT) {
+          break;
+        }
+      }
+    }
+    return false;
+  }
+
+  // first non empty class at or above fl, sl
+  bool findFreeClass(uint32_t &fl, uint32_t &sl) const {
+    uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+    if (slMap == 0) {
+      uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+      if (flMap == 0) {
+        return false;
+      }
+      fl = findFirstSet(flMap);
+      slMap = slBitmaps[fl];
+    }
+    sl = findFirstSet(slMap);
+    return true;
+  }
+
+  // takes [start, start + allocationSize) out of the free chunk index, the
+  // padding in front and the rest behind become free chunks of their own
+  uint32_t use(uint32_t index, VkDeviceSize start, VkDeviceSize allocationSize) {
+    removeFree(index);
+    if (start > chunks[index].offset) {
+      // split keeps index in front, as padding, and returns the rest
+      uint32_t padding = index;
+      index = split(padding, start - chunks[padding].offset);
+      insertFree(padding);
+    }
+    if (chunks[index].size > allocationSize) {
+      insertFree(split(index, allocationSize));
+    }
+    chunks[index].free = false;
+    return index;
+  }
+
+  // cuts index after length bytes and returns the chunk of the rest, which
+  // is marked as free but not yet in a free list
+  uint32_t split(uint32_t index, VkDeviceSize length) {
+    uint32_t rest = newChunk();
+    Chunk &first = chunks[index];
+    chunks[rest] = {first.offset + length, first.size - length, index,
+                    first.nextPhysical, NO_CHUNK, NO_CHUNK, true};
+    if (first.nextPhysical != NO_CHUNK) {
+      chunks[first.nextPhysical].prevPhysical = rest;
+    }
+    first.size = length;
+    first.nextPhysical = rest;
+    return rest;
+  }
+
+  void freeTlsf(uint32_t index) {
+    chunks[index].free = true;
+    uint32_t prev = chunks[index].prevPhysical;
+    if (prev != NO_CHUNK && chunks[prev].free) {
+      removeFree(prev);
+      merge(prev, index);
+      index = prev;
+    }
+    uint32_t next = chunks[index].nextPhysical;
+    if (next != NO_CHUNK && chunks[next].free) {
+      removeFree(next);
+      merge(index, next);
+    }
+    insertFree(index);
+  }
+
+  // appends next to its physical predecessor index
+  void merge(uint32_t index, uint32_t next) {
+    Chunk &chunk = chunks[index];
+    chunk.size += chunks[next].size;
+    chunk.nextPhysical = chunks[next].nextPhysical;
+    if (chunk.nextPhysical != NO_CHUNK) {
+      chunks[chunk.nextPhysical].prevPhysical = index;
+    }
+    unusedChunks.push_back(next);
+  }
+
+  void insertFree(uint32_t index) {
+    uint32_t fl, sl;
+    getSizeClass(chunks[index].size, fl, sl);
+    Chunk &chunk = chunks[index];
+    chunk.free = true;
+    chunk.prevFree = NO_CHUNK;
+    chunk.nextFree = freeHeads[fl][sl];
+    if (chunk.nextFree != NO_CHUNK) {
+      chunks[chunk.nextFree].prevFree = index;
+    }
+    freeHeads[fl][sl] = index;
+    slBitmaps[fl] |= 1u << sl;
+    flBitmap |= 1ull << fl;
+  }
+
+  void removeFree(uint32_t index) {
+    const Chunk &chunk = chunks[index];
+    if (chunk.prevFree != NO_CHUNK) {
+      chunks[chunk.prevFree].nextFree = chunk.nextFree;
+    } else {
+      uint32_t fl, sl;
+      getSizeClass(chunk.size, fl, sl);
+      freeHeads[fl][sl] = chunk.nextFree;
+      if (chunk.nextFree == NO_CHUNK) {
+        slBitmaps[fl] &= ~(1u << sl);
+        if (slBitmaps[fl] == 0) {
+          flBitmap &= ~(1ull << fl);
+        }
+      }
+    }
+    if (chunk.nextFree != NO_CHUNK) {
+      chunks[chunk.nextFree].prevFree = chunk.prevFree;
+    }
+  }
+
+  uint32_t newChunk() {
+    if (unusedChunks.empty()) {
+      chunks.emplace_back();
+      return static_cast<uint32_t>(chunks.size() - 1);
+    }
+    uint32_t index = unusedChunks.back();
+    unusedChunks.pop_back();
+    return index;
+  }
+
+  uint32_t allocationCount = 0;
+
+  // Strategy::Linear
+  VkDeviceSize top = 0;
+
+  // Strategy::Tlsf, chunks are addressed by index and recycled
+  std::vector<Chunk> chunks;
+  std::vector<uint32_t> unusedChunks;
+  uint64_t flBitmap = 0;
+  std::array<uint32_t, FL_COUNT> slBitmaps{};
+  std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> freeHeads;
+};
+
+VkEngineAllocator::VkEngineAllocator(VkPhysicalDevice physicalDevice,
+                                     VkDevice device, VkDeviceSize blockSize)
+    : device{device}, blockSize{blockSize} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  nonCoherentAtomSize =
+      std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+  // a pool per memory type, resource kind and strategy
+  pools.resize(memoryProperties.memoryTypeCount * 4);
+}
+
+VkEngineAllocator::~VkEngineAllocator() {
+  for (Pool &pool : pools) {
+    for (auto &block : pool.blocks) {
+      vkFreeMemory(device, block->memory, nullptr);
+    }
+  }
+}
+
+VkEngineAllocation
+VkEngineAllocator::allocate(const VkMemoryRequirements &requirements,
+                            VkMemoryPropertyFlags properties,
+                            Resource resource, Strategy strategy) {
+  uint32_t memoryType =
+      findMemoryType(requirements.memoryTypeBits, properties);
+  VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+  if (!isCoherent(memoryType)) {
+    // flushes are rounded out to atoms, which then never touch a neighbour
+    alignment = std::max(alignment, nonCoherentAtomSize);
+  }
+
+  VkEngineAllocation allocation{};
+  allocation.size = requirements.size;
+  allocation.memoryType = memoryType;
+
+  std::lock_guard<std::mutex> lock{mutex};
+  VkDeviceSize typeBlockSize = getBlockSize(memoryType);
+  if (requirements.size > typeBlockSize / 2) {
+    allocateDedicated(allocation);
+  } else {
+    uint32_t poolIndex = getPoolIndex(memoryType, resource, strategy);
+    Pool &pool = pools[poolIndex];
+    MemoryBlock *block = nullptr;
+    for (auto &candidate : pool.blocks) {
+      if (candidate->allocate(requirements.size, alignment, allocation.offset,
+                              allocation.chunk)) {
+        block = candidate.get();
+        break;
+      }
+    }
+
+    if (block == nullptr) {
+      // smaller blocks when the heap is running out
+      VkDeviceSize size = typeBlockSize;
+      void *mapped = nullptr;
+      VkDeviceMemory memory = allocateMemory(size, memoryType, &mapped);
+      while (memory == VK_NULL_HANDLE && size / 2 >= requirements.size) {
+        size /= 2;
+        memory = allocateMemory(size, memoryType, &mapped);
+      }
+      if (memory == VK_NULL_HANDLE) {
+        throw std::runtime_error("failed to allocate memory block!");
+      }
+      pool.blocks.push_back(std::make_unique<MemoryBlock>(
+          memory, size, mapped, strategy, poolIndex));
+      stats.blockCount++;
+      stats.reservedBytes += size;
+      // a fresh block at least twice the request fits it, should it not the
+      // request gets memory of its own rather than a range nobody allocated,
+      // the empty block stays as the pool's spare
+      if (pool.blocks.back()->allocate(requirements.size, alignment,
+                                       allocation.offset, allocation.chunk)) {
+        block = pool.blocks.back().get();
+      }
+    }
+
+    if (block != nullptr) {
+      allocation.block = block;
+      allocation.memory = block->memory;
+      if (block->mapped) {
+        allocation.mapped =
+            static_cast<char *>(block->mapped) + allocation.offset;
+      }
+    } else {
+      allocation.offset = 0;
+      allocateDedicated(allocation);
+    }
+  }
+
+  stats.allocationCount++;
+  stats.totalAllocations++;
+  stats.usedBytes += requirements.size;
+  return allocation;
+}
+
+void VkEngineAllocator::free(VkEngineAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+  stats.allocationCount--;
+  stats.usedBytes -= allocation.size;
+  MemoryBlock *block = allocation.block;
+  if (block == nullptr) {
+    vkFreeMemory(device, allocation.memory, nullptr);
+    stats.dedicatedCount--;
+    stats.reservedBytes -= allocation.size;
+    allocation = {};
+    return;
+  }
+
+  block->free(allocation.chunk);
+  allocation = {};
+  if (!block->empty()) {
+    return;
+  }
+  // one empty block is kept, so a pool that is used in bursts doesn't
+  // allocate a block for every burst
+  auto &blocks = pools[block->pool].blocks;
+  bool hasSpare = std::any_of(blocks.begin(), blocks.end(), [&](const auto &other) {
+    return other.get() != block && other->empty();
+  });
+  if (hasSpare) {
+    stats.blockCount--;
+    stats.reservedBytes -= block->size;
+    vkFreeMemory(device, block->memory, nullptr);
+    blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&](const auto &other) {
+      return other.get() == block;
+    }));
+  }
+}
+
+VkResult VkEngineAllocator::flush(const VkEngineAllocation &allocation,
+                                  VkDeviceSize offset, VkDeviceSize size) {
+  if (isCoherent(allocation.memoryType)) {
+    return VK_SUCCESS;
+  }
+  VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+  return vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+VkResult VkEngineAllocator::invalidate(const VkEngineAllocation &allocation,
+                                       VkDeviceSize offset,
+                                       VkDeviceSize size) {
+  if (isCoherent(allocation.memoryType)) {
+    return VK_SUCCESS;
+  }
+  VkMappedMemoryRange range = getMappedRange(allocation, offset, size);
+  return vkInvalidateMappedMemoryRanges(device, 1, &range);
+}
+
+void VkEngineAllocator::allocateDedicated(VkEngineAllocation &allocation) {
+  allocation.memory = allocateMemory(allocation.size, allocation.memoryType,
+                                     &allocation.mapped);
+  if (allocation.memory == VK_NULL_HANDLE) {
+    throw std::runtime_error("failed to allocate dedicated memory!");
+  }
+  stats.dedicatedCount++;
+  stats.reservedBytes += allocation.size;
+}
+
+VkEngineAllocator::Stats VkEngineAllocator::getStats() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return stats;
+}
+
+uint32_t VkEngineAllocator::getPoolIndex(uint32_t memoryType,
+                                         Resource resource,
+                                         Strategy strategy) const {
+  return memoryType * 4 + static_cast<uint32_t>(resource) * 2 +
+         static_cast<uint32_t>(strategy);
+}
+
+uint32_t VkEngineAllocator::findMemoryType(
+    uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return i;
+    }
+  }
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize VkEngineAllocator::getBlockSize(uint32_t memoryType) const {
+  uint32_t heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+  VkDeviceSize heapSize = memoryProperties.memoryHeaps[heap].size;
+  return heapSize >= LARGE_HEAP_SIZE ? blockSize
+                                     : std::min(blockSize, heapSize / 8);
+}
+
+VkDeviceMemory VkEngineAllocator::allocateMemory(VkDeviceSize size,
+                                                 uint32_t memoryType,
+                                                 void **mapped) {
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  stats.deviceAllocations++;
+
+  *mapped = nullptr;
+  if (memoryProperties.memoryTypes[memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) !=
+        VK_SUCCESS) {
+      vkFreeMemory(device, memory, nullptr);
+      throw std::runtime_error("failed to map memory block!");
+    }
+  }
+  return memory;
+}
+
+VkMappedMemoryRange
+VkEngineAllocator::getMappedRange(const VkEngineAllocation &allocation,
+                                  VkDeviceSize offset,
+                                  VkDeviceSize size) const {
+  if (size == VK_WHOLE_SIZE) {
+    size = allocation.size - offset;
+  }
+  VkDeviceSize memorySize =
+      allocation.block ? allocation.block->size : allocation.size;
+  VkDeviceSize begin = alignDown(allocation.offset + offset, nonCoherentAtomSize);
+  VkDeviceSize end = alignUp(allocation.offset + offset + size, nonCoherentAtomSize);
+
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = allocation.memory;
+  range.offset = begin;
+  // the last atom of the memory may be partial
+  range.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+  return range;
+}
+
+bool VkEngineAllocator::isCoherent(uint32_t memoryType) const {
+  return memoryProperties.memoryTypes[memoryType].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+} // namespace vkEngine
@@ -0,0 +1,125 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace vkEngine {
+
+class MemoryBlock;
+
+// A range of device memory handed out by VkEngineAllocator. Buffers and
+// images are bound to memory at offset.
+struct VkEngineAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // start of the range in the block's persistent mapping, null unless the
+  // memory type is host visible
+  void *mapped = nullptr;
+
+  // the range's block and chunk, no block for a dedicated allocation
+  MemoryBlock *block = nullptr;
+  uint32_t chunk = 0;
+  uint32_t memoryType = 0;
+};
+
+// Sub-allocates buffers and images from large blocks of device memory, so
+// vkAllocateMemory is called once per block instead of once per resource
+// and maxMemoryAllocationCount stays out of reach.
+//
+// Blocks are pooled per memory type. Long lived resources share blocks
+// managed by a two level segregated fit (TLSF) allocator: constant time
+// allocation and freeing with immediate coalescing of free neighbours.
+// Short lived ones that are freed in batches, like the depth images of a
+// swap chain, use linear blocks, which only bump an offset and start over
+// once everything in them has been freed.
+//
+// Buffers and linearly tiled images never share a block with optimally tiled
+// images, so neighbours can't conflict within bufferImageGranularity. Host
+// visible blocks are mapped once when they are created and stay mapped.
+class VkEngineAllocator {
+public:
+  enum class Strategy : uint8_t { Tlsf, Linear };
+  // resources only conflict within bufferImageGranularity with the other kind
+  enum class Resource : uint8_t { Buffer, OptimalImage };
+
+  struct Stats {
+    uint32_t blockCount = 0;
+    // allocations too large to share a block, with memory of their own
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+    // device memory held, in blocks and dedicated allocations
+    VkDeviceSize reservedBytes = 0;
+    // of which handed out to resources
+    VkDeviceSize usedBytes = 0;
+    // vkAllocateMemory calls and allocations served since creation
+    uint64_t deviceAllocations = 0;
+    uint64_t totalAllocations = 0;
+  };
+
+  // size of the blocks of heaps of at least 1 GB, smaller heaps use an
+  // eighth of their size
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  VkEngineAllocator(VkPhysicalDevice physicalDevice, VkDevice device,
+                    VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+  ~VkEngineAllocator();
+
+  VkEngineAllocator(const VkEngineAllocator &) = delete;
+  VkEngineAllocator &operator=(const VkEngineAllocator &) = delete;
+
+  // Memory of the first type in requirements.memoryTypeBits with all of the
+  // properties. Throws when there is none or the device is out of memory.
+  VkEngineAllocation allocate(const VkMemoryRequirements &requirements,
+                              VkMemoryPropertyFlags properties,
+                              Resource resource,
+                              Strategy strategy = Strategy::Tlsf);
+  // Returns the range to its block and resets allocation. Blocks that become
+  // empty are released, except one spare per pool.
+  void free(VkEngineAllocation &allocation);
+
+  // Flush and invalidate a range relative to the allocation, rounded out to
+  // nonCoherentAtomSize. No-ops for host coherent memory.
+  VkResult flush(const VkEngineAllocation &allocation, VkDeviceSize offset,
+                 VkDeviceSize size);
+  VkResult invalidate(const VkEngineAllocation &allocation,
+                      VkDeviceSize offset, VkDeviceSize size);
+
+  Stats getStats() const;
+
+private:
+  struct Pool {
+    std::vector<std::unique_ptr<MemoryBlock>> blocks;
+  };
+
+  uint32_t getPoolIndex(uint32_t memoryType, Resource resource,
+                        Strategy strategy) const;
+  uint32_t findMemoryType(uint32_t typeFilter,
+                          VkMemoryPropertyFlags properties) const;
+  VkDeviceSize getBlockSize(uint32_t memoryType) const;
+  // device memory of memoryType, mapped when host visible
+  VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType,
+                                void **mapped);
+  // memory of its own for allocation's size and type, the mutex is held
+  void allocateDedicated(VkEngineAllocation &allocation);
+  VkMappedMemoryRange getMappedRange(const VkEngineAllocation &allocation,
+                                     VkDeviceSize offset,
+                                     VkDeviceSize size) const;
+  bool isCoherent(uint32_t memoryType) const;
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize blockSize;
+  VkDeviceSize nonCoherentAtomSize;
+
+  // blocks are created and released on any thread that creates resources
+  mutable std::mutex mutex;
+  std::vector<Pool> pools;
+  Stats stats{};
+};
+
+} // namespace vkEngine
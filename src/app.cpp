@@ -7,11 +7,17 @@
 #include "game_object.hpp"
 #include "keyboard_movement_controller.hpp"
 #include "model.hpp"
+#include "point_cloud.hpp"
+#include "ring_buffer.hpp"
+#include "staging_pool.hpp"
+#include "streamed_model.hpp"
 #include "swap_chain.hpp"
+#include "systems/point_cloud_render_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/simple_render_system.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdint>
@@ -24,6 +30,7 @@
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -45,11 +52,9 @@ struct GlobalUbo {
     alignas(16) glm::vec4 lightColor{1.f};
 };
 
-App::App() {
-    globalPool = VkEngineDescriptorPool::Builder(vkEngineDevice)
-                     .setMaxSets(VkEngineSwapChain::MAX_FRAMES_IN_FLIGHT)
-                     .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VkEngineSwapChain::MAX_FRAMES_IN_FLIGHT)
-                     .build();
+App::App(uint32_t benchmarkFrames) : benchmarkFrames{benchmarkFrames} {
+    // one set for all frames, each frame binds it at its own dynamic offset
+    globalPool = VkEngineDescriptorPool::Builder(vkEngineDevice).setMaxSets(1).addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1).build();
     loadGameObjects();
 }
 
@@ -61,31 +66,38 @@ App::run() {
     //   std::cout << object.getId() << std::endl;
     // }
 
-    std::vector<std::unique_ptr<VkEngineBuffer>> uboBuffers(VkEngineSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < uboBuffers.size(); i++) {
-        uboBuffers[i] = std::make_unique<VkEngineBuffer>(vkEngineDevice, sizeof(GlobalUbo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        uboBuffers[i]->map();
-    }
+    // the uniforms and any other per-frame data of all frames in flight
+    VkEngineRingBuffer frameRing{vkEngineDevice, FRAME_RING_BUDGET, VkEngineSwapChain::MAX_FRAMES_IN_FLIGHT};
 
-    auto globalSetLayout = VkEngineDescriptorSetLayout::Builder(vkEngineDevice).addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS).build();
+    auto globalSetLayout = VkEngineDescriptorSetLayout::Builder(vkEngineDevice).addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS).build();
 
-    std::vector<VkDescriptorSet> globalDescriptorSets(VkEngineSwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++) {
-        auto bufferInfo = uboBuffers[i]->descriptorInfo();
-        VkEngineDescriptorWriter(*globalSetLayout, *globalPool).writeBuffer(0, &bufferInfo).build(globalDescriptorSets[i]);
-    }
+    VkDescriptorSet globalDescriptorSet;
+    auto bufferInfo = frameRing.descriptorInfo(sizeof(GlobalUbo));
+    VkEngineDescriptorWriter(*globalSetLayout, *globalPool).writeBuffer(0, &bufferInfo).build(globalDescriptorSet);
 
     SimpleRenderSystem simpleRenderSystem(vkEngineDevice, vkEngineRenderer.getSwapChainrenderPass(), globalSetLayout->getDescriptorSetLayout());
 
     PointLightSystem pointLightSystem(vkEngineDevice, vkEngineRenderer.getSwapChainrenderPass(), globalSetLayout->getDescriptorSetLayout());
 
+    PointCloudRenderSystem pointCloudRenderSystem(vkEngineDevice, vkEngineRenderer.getSwapChainrenderPass(), globalSetLayout->getDescriptorSetLayout());
+
     VkEngineCamera camera{};
     camera.setViewTarget(glm::vec3{-1.f, -2.f, 2.f}, glm::vec3{0.f, 0.f, 2.5f});
 
     auto viewerObject = VkEngineGameObject::createGameObject();
     KeyBoardMovementController cameraController{};
 
+    // a benchmark draws the whole scene, every model has to be resident first
+    bool benchmarking = benchmarkFrames > 0;
+    while (benchmarking && modelLoader.getPendingCount() > 0) {
+        modelLoader.flushUploads();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint32_t benchmarkFrame = 0;
+    uint64_t benchmarkPoints = 0;
+
     auto currentTime = std::chrono::high_resolution_clock::now();
+    auto benchmarkStart = currentTime;
     while (!window.shouldClose()) {
         glfwPollEvents();
 
@@ -98,40 +110,83 @@ App::run() {
 
         // delta = glm::min(delta, MAX_FRAME_TIME);
 
-        cameraController.moveInPlaneXZ(window.getGLFWwindow(), delta, viewerObject);
+        if (!benchmarking) {
+            cameraController.moveInPlaneXZ(window.getGLFWwindow(), delta, viewerObject);
+        }
         camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
         float aspect = vkEngineRenderer.getAspectRatio();
         // camera.setOrthographicProjection(-aspect, aspect, -1, 1, -1, 1);
         camera.setPerspectiveProjection(glm::radians(70.f), aspect, .1f, 100.f);
 
+        modelLoader.flushUploads();
+
+        // streamed models page in the chunks this view needs before the frame is recorded
+        for (auto &kvPair : gameObjects) {
+            auto &obj = kvPair.second;
+            if (obj.streamedModel != nullptr) {
+                obj.streamedModel->update(camera, obj.transform.mat4());
+            }
+        }
+
         if (auto commandBuffer = vkEngineRenderer.beginFrame()) {
             int frameIndex = vkEngineRenderer.getFrameIndex();
-            FrameInfo frameInfo{frameIndex, delta, commandBuffer, camera, globalDescriptorSets[frameIndex], gameObjects};
+            // beginFrame has waited for this frame's fence, so its range is free again
+            frameRing.beginFrame(frameIndex);
 
             // update
             GlobalUbo ubo{};
             ubo.projection = camera.getProjection();
             ubo.view = camera.getView();
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
-            uboBuffers[frameIndex]->flush();
+            uint32_t globalUboOffset = frameRing.write(ubo).getDynamicOffset();
+
+            FrameInfo frameInfo{frameIndex, delta, commandBuffer, camera, globalDescriptorSet, globalUboOffset, gameObjects, vkEngineRenderer.getSwapChainExtent(), frameRing};
 
             // render
             vkEngineRenderer.beginSwapChainrenderPass(commandBuffer);
             simpleRenderSystem.renderGameObjects(frameInfo);
+            pointCloudRenderSystem.render(frameInfo);
+            uint64_t points = pointCloudRenderSystem.getDrawnPoints();
+            drawnPoints += points;
             pointLightSystem.render(frameInfo);
             vkEngineRenderer.endSwapChainrenderPass(commandBuffer);
+            frameRing.flush();
             vkEngineRenderer.endFrame();
+
+            if (benchmarking) {
+                benchmarkFrame++;
+                if (benchmarkFrame == BENCHMARK_WARMUP_FRAMES) {
+                    benchmarkStart = std::chrono::high_resolution_clock::now();
+                } else if (benchmarkFrame > BENCHMARK_WARMUP_FRAMES) {
+                    benchmarkPoints += points;
+                    if (benchmarkFrame == BENCHMARK_WARMUP_FRAMES + benchmarkFrames) {
+                        break;
+                    }
+                }
+            }
         }
     }
 
     vkDeviceWaitIdle(vkEngineDevice.device());
+
+    if (benchmarking && benchmarkFrame == BENCHMARK_WARMUP_FRAMES + benchmarkFrames) {
+        // the wait above is part of the time, the last frames were still on the GPU
+        float seconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - benchmarkStart).count();
+        VkExtent2D extent = vkEngineRenderer.getSwapChainExtent();
+        std::cout << "Benchmark: " << benchmarkFrames << " frames at " << extent.width << "x" << extent.height << " in " << seconds << " s, " << 1000.f * seconds / benchmarkFrames << " ms per frame, " << benchmarkPoints / benchmarkFrames << " points per frame, " << static_cast<float>(benchmarkPoints) / (seconds * 1e6f) << " M points/s" << std::endl;
+    }
 }
 
 void
 App::loadGameObjects() {
-    std::shared_ptr<Model> gameObjectModel = Model::createModelFromFile(vkEngineDevice, "models/viking_room.obj");
-    std::shared_ptr<Model> quadModel = Model::createModelFromFile(vkEngineDevice, "models/quad.obj");
+    // models are parsed in the background and show up once they are resident
+    std::shared_ptr<Model> gameObjectModel = modelRegistry.load("models/viking_room.obj").model;
+    std::shared_ptr<Model> quadModel = modelRegistry.load("models/quad.obj").model;
+    Model::LoadOptions scanOptions{};
+    scanOptions.generateMeshlets = true;
+    scanOptions.generateLods = true;
+    scanOptions.quantizeVertices = true;
+    std::shared_ptr<Model> discModel = modelRegistry.load("models/L4_intervertebral_disc_3d.stl", scanOptions).model;
 
     auto gObj = VkEngineGameObject::createGameObject();
     gObj.model = gameObjectModel;
@@ -148,6 +203,47 @@ App::loadGameObjects() {
     // glm::half_pi<float>(), 0.f};
     gObj.transform.rotation = glm::vec3{.0f};
     gameObjects.emplace(gObj.getId(), std::move(gObj));
+
+    // scanned STL is in millimetres
+    gObj = VkEngineGameObject::createGameObject();
+    gObj.model = discModel;
+    gObj.transform.translation = {-2.0f, 1.5f, 2.5f};
+    gObj.transform.scale = glm::vec3{.04f};
+    gameObjects.emplace(gObj.getId(), std::move(gObj));
+
+    // the disc again, cut into small chunks and streamed through a pool that
+    // holds about a third of them, so chunks page in and get evicted as the
+    // camera moves around it
+    try {
+        gObj = VkEngineGameObject::createGameObject();
+        gObj.streamedModel = StreamedModel::createFromFile(vkEngineDevice, "models/L4_intervertebral_disc_3d.stl", STREAMED_POOL_SIZE, STREAMED_CHUNK_TRIANGLES);
+        gObj.transform.translation = {.0f, 1.5f, 4.5f};
+        gObj.transform.scale = glm::vec3{.04f};
+        gameObjects.emplace(gObj.getId(), std::move(gObj));
+    } catch (const std::exception &e) {
+        std::cerr << "Skipping streamed model: " << e.what() << std::endl;
+    }
+
+    // an exported scene is optional too. The exporter already optimized it,
+    // so it is uploaded straight out of the mapped file instead of being
+    // parsed and cooked
+    Model::LoadOptions exportedOptions{};
+    exportedOptions.optimizeMeshes = false;
+    std::shared_ptr<Model> exportedModel = modelRegistry.load("models/scene.glb", exportedOptions).model;
+    gObj = VkEngineGameObject::createGameObject();
+    gObj.model = exportedModel;
+    gObj.transform.translation = {.0f, 1.5f, -2.5f};
+    gameObjects.emplace(gObj.getId(), std::move(gObj));
+
+    // scans are optional, the scene renders without one
+    try {
+        gObj = VkEngineGameObject::createGameObject();
+        gObj.pointCloud = PointCloud::createFromFile(vkEngineDevice, "models/scan.ply");
+        gObj.transform.translation = {2.0f, 1.5f, 2.5f};
+        gameObjects.emplace(gObj.getId(), std::move(gObj));
+    } catch (const std::exception &e) {
+        std::cerr << "Skipping point cloud: " << e.what() << std::endl;
+    }
 }
 
 void
@@ -158,8 +254,39 @@ App::calculateFrameRate(float delta) {
         int framerate = numFrames / timePassed;
         std::stringstream title;
         title << "Running at " << framerate << " fps.";
+
+        StreamedModel::Stats streamed{};
+        bool streaming = false;
+        for (auto &kvPair : gameObjects) {
+            if (kvPair.second.streamedModel == nullptr)
+                continue;
+            const StreamedModel::Stats &stats = kvPair.second.streamedModel->getStats();
+            streamed.chunkCount += stats.chunkCount;
+            streamed.residentChunks += stats.residentChunks;
+            streamed.loadingChunks += stats.loadingChunks;
+            streamed.residentBytes += stats.residentBytes;
+            streamed.poolBytes += stats.poolBytes;
+            streamed.evictions += stats.evictions;
+            streaming = true;
+        }
+        ModelRegistry::Stats models = modelRegistry.getStats();
+        if (drawnPoints > 0) {
+            title << " " << static_cast<float>(drawnPoints) / (timePassed * 1e6f) << " M points/s.";
+        }
+        title << " " << models.liveModels << " models, " << models.pathHits + models.contentHits << "/" << models.pathHits + models.contentHits + models.misses << " loads shared.";
+
+        VkEngineAllocator::Stats memory = vkEngineDevice.getAllocator().getStats();
+        title << " " << memory.allocationCount << " allocations in " << memory.blockCount + memory.dedicatedCount << " device allocations (" << memory.usedBytes / (1024 * 1024) << "/" << memory.reservedBytes / (1024 * 1024) << " MB).";
+        // every staged copy used to create a buffer of its own
+        const VkEngineStagingPool::Stats &staging = vkEngineDevice.getStagingPool().getStats();
+        title << " Staged " << staging.copies << " copies from " << staging.blocksCreated << " buffers (" << staging.copies - std::min(staging.copies, staging.blocksCreated) << " allocations saved).";
+
+        if (streaming) {
+            title << " Streaming " << streamed.residentChunks << "/" << streamed.chunkCount << " chunks resident (" << streamed.residentBytes / (1024 * 1024) << "/" << streamed.poolBytes / (1024 * 1024) << " MB), " << streamed.loadingChunks << " loading, " << streamed.evictions << " evicted.";
+        }
         glfwSetWindowTitle(window.getGLFWwindow(), title.str().c_str());
         numFrames = 0;
+        drawnPoints = 0;
         timePassed -= 1;
         // frameTime = float(1000.0 / framerate);
     }
@@ -2,6 +2,8 @@
 
 #include "device.hpp"
 #include "model.hpp"
+#include "model_loader.hpp"
+#include "model_registry.hpp"
 #include "renderer.hpp"
 #include "window.hpp"
 #include "game_object.hpp"
@@ -9,6 +11,7 @@
 
 // std
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -18,8 +21,19 @@ class App {
 public:
   static constexpr int WIDTH = 600;
   static constexpr int HEIGHT = 600;
+  // bytes of transient data, like uniforms, each frame can write
+  static constexpr VkDeviceSize FRAME_RING_BUDGET = 256 * 1024;
+  // frames a benchmark renders before it starts timing, for streaming and the
+  // driver to settle
+  static constexpr uint32_t BENCHMARK_WARMUP_FRAMES = 100;
+  // the streamed disc is cut into 16 chunks, the pool holds 6 of them
+  static constexpr uint32_t STREAMED_CHUNK_TRIANGLES = 1024;
+  static constexpr VkDeviceSize STREAMED_POOL_SIZE = 256 * 1024;
 
-  App();
+  // With benchmarkFrames, run() waits for the models, renders that many
+  // frames from the start pose without vsync and input, prints the frame
+  // time and point throughput and returns.
+  explicit App(uint32_t benchmarkFrames = 0);
   ~App();
 
   App(const App &) = delete;
@@ -31,13 +45,19 @@ private:
   void calculateFrameRate(float delta); 
   float timePassed = 0;
   int numFrames = 0;
+  uint64_t drawnPoints = 0;
 
   float MAX_FRAME_TIME = 0.1f;
   void loadGameObjects();
 
+  uint32_t benchmarkFrames;
+
   Window window{WIDTH, HEIGHT, "Vulkan Engine"};
   VkEngineDevice vkEngineDevice{window};
-  VkEngineRenderer vkEngineRenderer{window, vkEngineDevice};
+  VkEngineRenderer vkEngineRenderer{window, vkEngineDevice, benchmarkFrames == 0};
+  ModelLoader modelLoader{vkEngineDevice};
+  // loads go through the registry, so repeated assets share one model
+  ModelRegistry modelRegistry{modelLoader};
 
   // order of declerations matter
   std::unique_ptr<VkEngineDescriptorPool> globalPool{};
@@ -0,0 +1,285 @@
+#include "bounds.hpp"
+#include "frustum.hpp"
+#include "utils.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace vkEngine {
+
+namespace {
+
+// Ritter's sphere grown to include a point outside it
+void growSphere(glm::vec3 &center, float &radius, const glm::vec3 &point) {
+  glm::vec3 offset = point - center;
+  float distance = glm::length(offset);
+  float grown = (radius + distance) * .5f;
+  center += offset * ((grown - radius) / distance);
+  radius = grown;
+}
+
+// Ritter's initial sphere spans the farthest apart pair of per axis extremes
+BoundingSphere getInitialSphere(const glm::vec3 (&minimumPoints)[3],
+                                const glm::vec3 (&maximumPoints)[3]) {
+  int widest = 0;
+  float widestSpan = 0.f;
+  for (int axis = 0; axis < 3; axis++) {
+    glm::vec3 span = maximumPoints[axis] - minimumPoints[axis];
+    if (glm::dot(span, span) > widestSpan) {
+      widest = axis;
+      widestSpan = glm::dot(span, span);
+    }
+  }
+  return {(minimumPoints[widest] + maximumPoints[widest]) * .5f,
+          std::sqrt(widestSpan) * .5f};
+}
+
+Bounds finishBounds(const Aabb &box, float boxRadius,
+                    const BoundingSphere &ritter) {
+  Bounds bounds{};
+  bounds.box = box;
+  bounds.sphere = ritter.radius < boxRadius
+                      ? ritter
+                      : BoundingSphere{box.getCenter(), boxRadius};
+  return bounds;
+}
+
+#ifdef VKENGINE_SSE2
+
+struct FloatPositions {
+  const char *data;
+  size_t count;
+  size_t stride;
+
+  // w is always zero
+  __m128 load(size_t i) const {
+    const float *p = reinterpret_cast<const float *>(data + i * stride);
+    // the fourth float belongs to the element, or to the next one
+    if (stride >= 4 * sizeof(float) || i + 1 < count) {
+      return _mm_and_ps(_mm_loadu_ps(p), _mm_castsi128_ps(_mm_setr_epi32(
+                                             -1, -1, -1, 0)));
+    }
+    return _mm_setr_ps(p[0], p[1], p[2], 0.f);
+  }
+};
+
+struct PackedPositions {
+  const char *data;
+  size_t count;
+  size_t stride;
+  __m128 offset;
+  __m128 scale; // divided by 65535
+
+  __m128 load(size_t i) const {
+    __m128i packed = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i *>(data + i * stride));
+    __m128 position = _mm_cvtepi32_ps(
+        _mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+    return _mm_add_ps(offset, _mm_mul_ps(position, scale));
+  }
+};
+
+glm::vec3 toVec3(__m128 v) {
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, v);
+  return {lanes[0], lanes[1], lanes[2]};
+}
+
+__m128 select(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+template <int Axis> __m128 broadcast(__m128 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Axis, Axis, Axis, Axis));
+}
+
+// squared length in the low lane, w has to be zero
+__m128 lengthSquared(__m128 v) {
+  __m128 squared = _mm_mul_ps(v, v);
+  __m128 sum = _mm_add_ps(squared, _mm_movehl_ps(squared, squared));
+  return _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+template <typename Positions>
+Bounds computePositionBounds(const Positions &positions) {
+  // the box and the point on it per axis and side, for Ritter's first guess
+  __m128 minimum = positions.load(0);
+  __m128 maximum = minimum;
+  __m128 minimumPoints[3] = {minimum, minimum, minimum};
+  __m128 maximumPoints[3] = {minimum, minimum, minimum};
+  for (size_t i = 1; i < positions.count; i++) {
+    __m128 p = positions.load(i);
+    __m128 below = _mm_cmplt_ps(p, minimum);
+    __m128 above = _mm_cmpgt_ps(p, maximum);
+    minimum = _mm_min_ps(minimum, p);
+    maximum = _mm_max_ps(maximum, p);
+    // soon rare, most points are inside the box found so far
+    if (_mm_movemask_ps(_mm_or_ps(below, above)) != 0) {
+      minimumPoints[0] = select(broadcast<0>(below), p, minimumPoints[0]);
+      minimumPoints[1] = select(broadcast<1>(below), p, minimumPoints[1]);
+      minimumPoints[2] = select(broadcast<2>(below), p, minimumPoints[2]);
+      maximumPoints[0] = select(broadcast<0>(above), p, maximumPoints[0]);
+      maximumPoints[1] = select(broadcast<1>(above), p, maximumPoints[1]);
+      maximumPoints[2] = select(broadcast<2>(above), p, maximumPoints[2]);
+    }
+  }
+
+  Aabb box{toVec3(minimum), toVec3(maximum)};
+  glm::vec3 minimumExtremes[3];
+  glm::vec3 maximumExtremes[3];
+  for (int axis = 0; axis < 3; axis++) {
+    minimumExtremes[axis] = toVec3(minimumPoints[axis]);
+    maximumExtremes[axis] = toVec3(maximumPoints[axis]);
+  }
+  BoundingSphere ritter = getInitialSphere(minimumExtremes, maximumExtremes);
+
+  // one more pass grows Ritter's sphere and measures the one around the box
+  __m128 boxCenter = _mm_mul_ps(_mm_add_ps(minimum, maximum), _mm_set1_ps(.5f));
+  __m128 boxRadiusSquared = _mm_setzero_ps();
+  __m128 center = _mm_setr_ps(ritter.center.x, ritter.center.y,
+                              ritter.center.z, 0.f);
+  __m128 radiusSquared = _mm_set_ss(ritter.radius * ritter.radius);
+  for (size_t i = 0; i < positions.count; i++) {
+    __m128 p = positions.load(i);
+    boxRadiusSquared = _mm_max_ss(boxRadiusSquared,
+                                  lengthSquared(_mm_sub_ps(p, boxCenter)));
+    if (_mm_comigt_ss(lengthSquared(_mm_sub_ps(p, center)), radiusSquared)) {
+      growSphere(ritter.center, ritter.radius, toVec3(p));
+      center = _mm_setr_ps(ritter.center.x, ritter.center.y, ritter.center.z,
+                           0.f);
+      radiusSquared = _mm_set_ss(ritter.radius * ritter.radius);
+    }
+  }
+  return finishBounds(box, std::sqrt(_mm_cvtss_f32(boxRadiusSquared)), ritter);
+}
+
+#else
+
+struct FloatPositions {
+  const char *data;
+  size_t count;
+  size_t stride;
+
+  glm::vec3 load(size_t i) const {
+    const float *p = reinterpret_cast<const float *>(data + i * stride);
+    return {p[0], p[1], p[2]};
+  }
+};
+
+struct PackedPositions {
+  const char *data;
+  size_t count;
+  size_t stride;
+  glm::vec3 offset;
+  glm::vec3 scale; // divided by 65535
+
+  glm::vec3 load(size_t i) const {
+    const uint16_t *p = reinterpret_cast<const uint16_t *>(data + i * stride);
+    return offset + scale * glm::vec3{p[0], p[1], p[2]};
+  }
+};
+
+template <typename Positions>
+Bounds computePositionBounds(const Positions &positions) {
+  glm::vec3 first = positions.load(0);
+  Aabb box{first, first};
+  glm::vec3 minimumPoints[3] = {first, first, first};
+  glm::vec3 maximumPoints[3] = {first, first, first};
+  for (size_t i = 1; i < positions.count; i++) {
+    glm::vec3 p = positions.load(i);
+    for (int axis = 0; axis < 3; axis++) {
+      if (p[axis] < box.minimum[axis]) {
+        box.minimum[axis] = p[axis];
+        minimumPoints[axis] = p;
+      }
+      if (p[axis] > box.maximum[axis]) {
+        box.maximum[axis] = p[axis];
+        maximumPoints[axis] = p;
+      }
+    }
+  }
+
+  BoundingSphere ritter = getInitialSphere(minimumPoints, maximumPoints);
+  glm::vec3 boxCenter = box.getCenter();
+  float boxRadiusSquared = 0.f;
+  for (size_t i = 0; i < positions.count; i++) {
+    glm::vec3 p = positions.load(i);
+    boxRadiusSquared =
+        std::max(boxRadiusSquared, glm::dot(p - boxCenter, p - boxCenter));
+    glm::vec3 offset = p - ritter.center;
+    if (glm::dot(offset, offset) > ritter.radius * ritter.radius) {
+      growSphere(ritter.center, ritter.radius, p);
+    }
+  }
+  return finishBounds(box, std::sqrt(boxRadiusSquared), ritter);
+}
+
+#endif
+
+} // namespace
+
+Bounds Bounds::transformed(const glm::mat4 &transform) const {
+  // the extent along each world axis is the sum of the absolute
+  // contributions of the box axes (Arvo)
+  glm::vec3 halfExtent = box.getExtent() * .5f;
+  glm::vec3 center{transform * glm::vec4{box.getCenter(), 1.f}};
+  glm::vec3 worldHalfExtent = glm::abs(glm::vec3{transform[0]}) * halfExtent.x +
+                              glm::abs(glm::vec3{transform[1]}) * halfExtent.y +
+                              glm::abs(glm::vec3{transform[2]}) * halfExtent.z;
+
+  Bounds world{};
+  world.box = {center - worldHalfExtent, center + worldHalfExtent};
+  world.sphere.center = glm::vec3{transform * glm::vec4{sphere.center, 1.f}};
+  world.sphere.radius = sphere.radius * getMaxScale(transform);
+  return world;
+}
+
+Bounds computeBounds(const float *positions, size_t count, size_t stride) {
+  if (count == 0) {
+    return {};
+  }
+  return computePositionBounds(FloatPositions{
+      reinterpret_cast<const char *>(positions), count, stride});
+}
+
+Bounds computeBounds(const uint16_t *positions, size_t count, size_t stride,
+                     const glm::vec3 &offset, const glm::vec3 &scale) {
+  if (count == 0) {
+    return {};
+  }
+  glm::vec3 unitScale = scale / 65535.f;
+#ifdef VKENGINE_SSE2
+  return computePositionBounds(PackedPositions{
+      reinterpret_cast<const char *>(positions), count, stride,
+      _mm_setr_ps(offset.x, offset.y, offset.z, 0.f),
+      _mm_setr_ps(unitScale.x, unitScale.y, unitScale.z, 0.f)});
+#else
+  return computePositionBounds(PackedPositions{
+      reinterpret_cast<const char *>(positions), count, stride, offset,
+      unitScale});
+#endif
+}
+
+Bounds mergeBounds(const Bounds &a, const Bounds &b) {
+  Bounds merged{};
+  merged.box = {glm::min(a.box.minimum, b.box.minimum),
+                glm::max(a.box.maximum, b.box.maximum)};
+
+  glm::vec3 offset = b.sphere.center - a.sphere.center;
+  float distance = glm::length(offset);
+  if (distance + b.sphere.radius <= a.sphere.radius) {
+    merged.sphere = a.sphere;
+  } else if (distance + a.sphere.radius <= b.sphere.radius) {
+    merged.sphere = b.sphere;
+  } else {
+    // spans from the far side of a to the far side of b
+    float radius = (distance + a.sphere.radius + b.sphere.radius) * .5f;
+    merged.sphere = {a.sphere.center +
+                         offset * ((radius - a.sphere.radius) / distance),
+                     radius};
+  }
+  return merged;
+}
+
+} // namespace vkEngine
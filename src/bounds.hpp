@@ -0,0 +1,50 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+namespace vkEngine {
+
+struct Aabb {
+  glm::vec3 minimum{0.f};
+  glm::vec3 maximum{0.f};
+
+  glm::vec3 getCenter() const { return (minimum + maximum) * .5f; }
+  glm::vec3 getExtent() const { return maximum - minimum; }
+};
+
+struct BoundingSphere {
+  glm::vec3 center{0.f};
+  float radius = 0.f;
+};
+
+// Both volumes of a set of points. The sphere is the smaller of the one
+// around the box center and Ritter's, within a few percent of the minimal
+// sphere for typical meshes.
+struct Bounds {
+  Aabb box{};
+  BoundingSphere sphere{};
+
+  // Bounds of the transformed volumes: the box enclosing the transformed box
+  // and the sphere grown by the largest axis scale. Both stay conservative.
+  Bounds transformed(const glm::mat4 &transform) const;
+};
+
+// Bounds of count float positions, stride bytes apart. Uses SSE2 where
+// available, which reads the positions four floats at a time.
+Bounds computeBounds(const float *positions, size_t count, size_t stride);
+// Bounds of unorm16 positions (four components, w ignored) as offset +
+// scale * position / 65535, see Model::Quantization.
+Bounds computeBounds(const uint16_t *positions, size_t count, size_t stride,
+                     const glm::vec3 &offset, const glm::vec3 &scale);
+// Bounds enclosing both, e.g. of the parts of a mesh. The sphere is the
+// smallest one around both spheres, not around the points.
+Bounds mergeBounds(const Bounds &a, const Bounds &b);
+
+} // namespace vkEngine
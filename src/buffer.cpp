@@ -43,40 +43,43 @@ VkEngineBuffer::VkEngineBuffer(
       memoryPropertyFlags{memoryPropertyFlags} {
   alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
   bufferSize = alignmentSize * instanceCount;
-  device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+  device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
 }
 
 VkEngineBuffer::~VkEngineBuffer() {
   unmap();
   vkDestroyBuffer(vkEngineDevice.device(), buffer, nullptr);
-  vkFreeMemory(vkEngineDevice.device(), memory, nullptr);
+  vkEngineDevice.getAllocator().free(allocation);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory stays mapped by the allocator, this only points into its mapping
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
  *
- * @return VkResult of the buffer mapping call
+ * @return VkResult of the buffer mapping call, VK_ERROR_MEMORY_MAP_FAILED for memory that is not
+ * host visible or a range past the end of the buffer
  */
 VkResult VkEngineBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && memory && "Called map on buffer before create");
-  return vkMapMemory(vkEngineDevice.device(), memory, offset, size, 0, &mapped);
+  assert(buffer && allocation.memory && "Called map on buffer before create");
+  if (!allocation.mapped || offset > bufferSize ||
+      (size != VK_WHOLE_SIZE && size > bufferSize - offset)) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  mapped = static_cast<char *>(allocation.mapped) + offset;
+  return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The allocator's mapping of the memory stays, other buffers may share it
  */
-void VkEngineBuffer::unmap() {
-  if (mapped) {
-    vkUnmapMemory(vkEngineDevice.device(), memory);
-    mapped = nullptr;
-  }
-}
+void VkEngineBuffer::unmap() { mapped = nullptr; }
 
 /**
  * Copies the specified data to the mapped buffer. Default value writes whole buffer range
@@ -111,12 +114,7 @@ void VkEngineBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize o
  * @return VkResult of the flush call
  */
 VkResult VkEngineBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkFlushMappedMemoryRanges(vkEngineDevice.device(), 1, &mappedRange);
+  return vkEngineDevice.getAllocator().flush(allocation, offset, size);
 }
 
 /**
@@ -131,12 +129,7 @@ VkResult VkEngineBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult VkEngineBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkInvalidateMappedMemoryRanges(vkEngineDevice.device(), 1, &mappedRange);
+  return vkEngineDevice.getAllocator().invalidate(allocation, offset, size);
 }
 
 /**
@@ -32,6 +32,8 @@ class VkEngineBuffer {
   VkResult invalidateIndex(int index);
 
   VkBuffer getBuffer() const { return buffer; }
+  // the buffer's range of device memory, see VkEngineAllocator::getStats()
+  const VkEngineAllocation& getAllocation() const { return allocation; }
   void* getMappedMemory() const { return mapped; }
   uint32_t getInstanceCount() const { return instanceCount; }
   VkDeviceSize getInstanceSize() const { return instanceSize; }
@@ -46,7 +48,7 @@ class VkEngineBuffer {
   VkEngineDevice& vkEngineDevice;
   void* mapped = nullptr;
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkEngineAllocation allocation{};
 
   VkDeviceSize bufferSize;
   uint32_t instanceCount;
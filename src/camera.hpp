@@ -20,10 +20,13 @@ public:
 
   const glm::mat4 &getProjection() const { return projectionMatrix; }
   const glm::mat4 &getView() const { return viewMatrix; }
+  const glm::mat4 &getInverseView() const { return inverseViewMatrix; }
+  glm::vec3 getPosition() const { return glm::vec3{inverseViewMatrix[3]}; }
 
 private:
   glm::mat4 projectionMatrix{1.f};
   glm::mat4 viewMatrix{1.f};
+  glm::mat4 inverseViewMatrix{1.f};
 };
 
 } // namespace vkEngine
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include "chunked_mesh.hpp"
+#include "bounds.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace vkEngine {
+
+namespace {
+
+constexpr char CHUNKED_MESH_MAGIC[8] = {'V', 'K', 'C', 'H', 'U', 'N', 'K', 0};
+
+static_assert(sizeof(MeshChunk) == 48, "MeshChunk is stored as is");
+static_assert(offsetof(Model::Vertex, color) == sizeof(glm::vec3),
+              "The attribute stream starts after the position");
+
+constexpr size_t ATTRIBUTE_SIZE =
+    sizeof(Model::Vertex) - offsetof(Model::Vertex, color);
+
+void padTo(std::ofstream &file, uint64_t alignment) {
+  static const char zeros[MeshCache::MESH_CACHE_ALIGNMENT]{};
+  uint64_t position = static_cast<uint64_t>(file.tellp());
+  uint64_t padding = (alignment - position % alignment) % alignment;
+  file.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+uint64_t writeBlob(std::ofstream &file, const void *data, size_t bytes) {
+  padTo(file, MeshCache::MESH_CACHE_ALIGNMENT);
+  uint64_t offset = static_cast<uint64_t>(file.tellp());
+  file.write(static_cast<const char *>(data),
+             static_cast<std::streamsize>(bytes));
+  return offset;
+}
+
+} // namespace
+
+ChunkedMesh::ChunkedMesh(const std::string &filepath) : file{filepath} {
+  auto invalid = [&]() {
+    return std::runtime_error("Not a valid chunked mesh: " + filepath);
+  };
+  if (file.size() < sizeof(header)) {
+    throw invalid();
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, CHUNKED_MESH_MAGIC, sizeof(header.magic)) !=
+          0 ||
+      header.version != VERSION ||
+      header.chunkOffset % MeshCache::MESH_CACHE_ALIGNMENT != 0 ||
+      header.chunkOffset + uint64_t{header.chunkCount} * sizeof(MeshChunk) >
+          file.size()) {
+    throw invalid();
+  }
+  chunks = reinterpret_cast<const MeshChunk *>(file.data() + header.chunkOffset);
+
+  // a truncated file must not send an upload past the mapping
+  auto inside = [&](uint64_t offset, uint64_t bytes) {
+    return offset % MeshCache::MESH_CACHE_ALIGNMENT == 0 &&
+           offset <= file.size() && bytes <= file.size() - offset;
+  };
+  for (uint32_t i = 0; i < header.chunkCount; i++) {
+    const MeshChunk &chunk = chunks[i];
+    if (chunk.vertexCount > header.maxChunkVertices ||
+        chunk.indexCount > header.maxChunkIndices ||
+        !inside(chunk.positionOffset,
+                uint64_t{chunk.vertexCount} * sizeof(glm::vec3)) ||
+        !inside(chunk.attributeOffset,
+                uint64_t{chunk.vertexCount} * ATTRIBUTE_SIZE) ||
+        !inside(chunk.indexOffset,
+                uint64_t{chunk.indexCount} * sizeof(uint16_t))) {
+      throw invalid();
+    }
+  }
+}
+
+std::unique_ptr<ChunkedMesh> ChunkedMesh::open(const std::string &filepath,
+                                               uint32_t maxChunkTriangles) {
+  using Clock = std::chrono::high_resolution_clock;
+  std::string sourcePath = ENGINE_DIR + filepath;
+  MeshCache cache{ENGINE_DIR "cache"};
+  std::string chunkPath = cache.getEntryPath(sourcePath, ".vkchunks");
+  SourceStamp stamp = stampSource(sourcePath);
+
+  std::error_code error;
+  if (std::filesystem::exists(chunkPath, error)) {
+    try {
+      auto mesh = std::make_unique<ChunkedMesh>(chunkPath);
+      const ChunkedMeshHeader &header = mesh->getHeader();
+      if (header.maxChunkTriangles == maxChunkTriangles &&
+          header.sourceSize == stamp.size &&
+          (header.sourceModifiedTime == stamp.modifiedTime ||
+           header.sourceHash == hashSource(sourcePath))) {
+        return mesh;
+      }
+    } catch (const std::exception &e) {
+      std::cout << filepath << ": ignoring chunked mesh, " << e.what() << '\n';
+    }
+  }
+
+  auto start = Clock::now();
+  Model::Builder builder{};
+  // chunks are drawn at full detail, the LOD chain would only be thrown away
+  builder.options.generateLods = false;
+  builder.loadModel(filepath);
+
+  std::filesystem::create_directories(ENGINE_DIR "cache");
+  // written next to the file and renamed, so a reader never sees half a file
+  std::ostringstream tempPath;
+  tempPath << chunkPath << '.' << std::this_thread::get_id() << ".tmp";
+  cook(builder, tempPath.str(), maxChunkTriangles, stamp,
+       hashSource(sourcePath));
+  std::filesystem::rename(tempPath.str(), chunkPath);
+
+  auto mesh = std::make_unique<ChunkedMesh>(chunkPath);
+  std::ostringstream log;
+  log << filepath << ": cooked " << mesh->getChunkCount() << " chunks of up to "
+      << mesh->getHeader().maxChunkVertices << " vertices in "
+      << std::chrono::duration<float, std::chrono::milliseconds::period>(
+             Clock::now() - start)
+             .count()
+      << " ms\n";
+  std::cout << log.str() << std::flush;
+  return mesh;
+}
+
+void ChunkedMesh::cook(const Model::Builder &builder,
+                       const std::string &filepath, uint32_t maxChunkTriangles,
+                       const SourceStamp &stamp, uint64_t sourceHash) {
+  // 16 bit indices address every vertex of a chunk
+  maxChunkTriangles = std::clamp<uint32_t>(maxChunkTriangles, 1, 65536 / 3);
+  const std::vector<Model::Vertex> &vertices = builder.vertices;
+  size_t triangleCount = (builder.lods.empty() ? builder.indices.size()
+                                               : builder.lods[0].indexCount) /
+                         3;
+  const uint32_t *indices = builder.indices.data();
+
+  std::vector<glm::vec3> centroids(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++) {
+    centroids[t] = (vertices[indices[3 * t]].position +
+                    vertices[indices[3 * t + 1]].position +
+                    vertices[indices[3 * t + 2]].position) /
+                   3.f;
+  }
+
+  // median splits along the longest axis of the centroids, depth first so
+  // neighbouring chunks end up next to each other in the file
+  std::vector<uint32_t> triangles(triangleCount);
+  std::iota(triangles.begin(), triangles.end(), 0);
+  std::vector<std::pair<size_t, size_t>> ranges;
+  std::vector<std::pair<size_t, size_t>> pending{{0, triangleCount}};
+  while (!pending.empty()) {
+    auto [begin, end] = pending.back();
+    pending.pop_back();
+    if (end - begin <= maxChunkTriangles) {
+      if (end > begin) {
+        ranges.emplace_back(begin, end);
+      }
+      continue;
+    }
+
+    glm::vec3 minimum{std::numeric_limits<float>::max()};
+    glm::vec3 maximum{-std::numeric_limits<float>::max()};
+    for (size_t i = begin; i < end; i++) {
+      minimum = glm::min(minimum, centroids[triangles[i]]);
+      maximum = glm::max(maximum, centroids[triangles[i]]);
+    }
+    glm::vec3 extent = maximum - minimum;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+               : extent.y >= extent.z                       ? 1
+                                                            : 2;
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(triangles.begin() + begin, triangles.begin() + middle,
+                     triangles.begin() + end, [&](uint32_t a, uint32_t b) {
+                       return centroids[a][axis] < centroids[b][axis];
+                     });
+    pending.emplace_back(middle, end);
+    pending.emplace_back(begin, middle);
+  }
+
+  std::ofstream file{filepath, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    throw std::runtime_error("Failed to create chunked mesh file: " +
+                             filepath);
+  }
+  ChunkedMeshHeader header{};
+  std::memcpy(header.magic, CHUNKED_MESH_MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.maxChunkTriangles = maxChunkTriangles;
+  header.sourceSize = stamp.size;
+  header.sourceModifiedTime = stamp.modifiedTime;
+  header.sourceHash = sourceHash;
+  // rewritten once the chunk table is known
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  // chunks are streamed out one at a time, only the table is kept
+  std::vector<MeshChunk> chunks;
+  chunks.reserve(ranges.size());
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<uint32_t> chunkVertices;
+  std::vector<glm::vec3> positions;
+  std::vector<uint8_t> attributes;
+  std::vector<uint16_t> chunkIndices;
+  for (auto [begin, end] : ranges) {
+    // the optimized triangle order survives within a chunk
+    std::sort(triangles.begin() + begin, triangles.begin() + end);
+
+    chunkVertices.clear();
+    chunkIndices.clear();
+    for (size_t i = begin; i < end; i++) {
+      for (size_t corner = 0; corner < 3; corner++) {
+        uint32_t index = indices[3 * triangles[i] + corner];
+        if (remap[index] == UINT32_MAX) {
+          remap[index] = static_cast<uint32_t>(chunkVertices.size());
+          chunkVertices.push_back(index);
+        }
+        chunkIndices.push_back(static_cast<uint16_t>(remap[index]));
+      }
+    }
+
+    positions.resize(chunkVertices.size());
+    attributes.resize(chunkVertices.size() * ATTRIBUTE_SIZE);
+    for (size_t v = 0; v < chunkVertices.size(); v++) {
+      const Model::Vertex &vertex = vertices[chunkVertices[v]];
+      positions[v] = vertex.position;
+      std::memcpy(attributes.data() + v * ATTRIBUTE_SIZE, &vertex.color,
+                  ATTRIBUTE_SIZE);
+      remap[chunkVertices[v]] = UINT32_MAX;
+    }
+
+    MeshChunk chunk{};
+    BoundingSphere sphere =
+        computeBounds(&positions[0].x, positions.size(), sizeof(glm::vec3))
+            .sphere;
+    chunk.center = sphere.center;
+    chunk.radius = sphere.radius;
+    chunk.vertexCount = static_cast<uint32_t>(positions.size());
+    chunk.indexCount = static_cast<uint32_t>(chunkIndices.size());
+    chunk.positionOffset = writeBlob(file, positions.data(),
+                                     positions.size() * sizeof(glm::vec3));
+    chunk.attributeOffset =
+        writeBlob(file, attributes.data(), attributes.size());
+    chunk.indexOffset = writeBlob(file, chunkIndices.data(),
+                                  chunkIndices.size() * sizeof(uint16_t));
+    chunks.push_back(chunk);
+
+    header.maxChunkVertices = std::max(header.maxChunkVertices, chunk.vertexCount);
+    header.maxChunkIndices = std::max(header.maxChunkIndices, chunk.indexCount);
+  }
+
+  header.chunkCount = static_cast<uint32_t>(chunks.size());
+  header.chunkOffset =
+      writeBlob(file, chunks.data(), chunks.size() * sizeof(MeshChunk));
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!file) {
+    throw std::runtime_error("Failed to write chunked mesh file: " + filepath);
+  }
+}
+
+} // namespace vkEngine
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "model.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace vkEngine {
+
+// triangles per chunk the partition aims for, small enough to page a chunk
+// in within a frame's upload budget
+constexpr uint32_t DEFAULT_CHUNK_TRIANGLES = 16384;
+
+// A spatial piece of a chunked mesh. It has its own vertices and 16 bit
+// indices into them, so it can be uploaded and evicted on its own.
+struct MeshChunk {
+  // bounding sphere in model space
+  glm::vec3 center;
+  float radius;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  // file offsets of the position stream (glm::vec3), the attribute stream
+  // (the rest of Model::Vertex) and the uint16_t indices
+  uint64_t positionOffset;
+  uint64_t attributeOffset;
+  uint64_t indexOffset;
+};
+
+// On disk layout of a .vkchunks file. The chunk table and the chunk streams
+// follow at MeshCache::MESH_CACHE_ALIGNMENT aligned offsets. The streams are
+// split like Model's vertex buffers, so a chunk is copied as is.
+struct ChunkedMeshHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t chunkCount;
+  uint32_t maxChunkTriangles; // the partition target it was cooked with
+  // largest chunk, sizes the slots of a streaming pool
+  uint32_t maxChunkVertices;
+  uint32_t maxChunkIndices;
+  uint32_t reserved;
+  uint64_t chunkOffset;
+
+  // identifies the source the chunks were cooked from
+  uint64_t sourceSize;
+  int64_t sourceModifiedTime;
+  uint64_t sourceHash;
+};
+
+// A mapped .vkchunks file. Only the header and the chunk table are read up
+// front, chunk data is paged in by the OS when a chunk is uploaded, so the
+// mesh does not have to fit in memory at run time.
+class ChunkedMesh {
+public:
+  static constexpr uint32_t VERSION = 3;
+
+  // Throws std::runtime_error if the file is not a valid chunked mesh.
+  explicit ChunkedMesh(const std::string &filepath);
+
+  ChunkedMesh(const ChunkedMesh &) = delete;
+  ChunkedMesh &operator=(const ChunkedMesh &) = delete;
+
+  // Opens the chunked form of a model file (relative to ENGINE_DIR), cooking
+  // it into the mesh cache directory when it is missing or stale.
+  static std::unique_ptr<ChunkedMesh>
+  open(const std::string &filepath,
+       uint32_t maxChunkTriangles = DEFAULT_CHUNK_TRIANGLES);
+
+  // Splits the builder's mesh along the median triangle centroid of the
+  // longest axis until no piece has more than maxChunkTriangles and writes
+  // the pieces to filepath. Only the full mesh is used, not its LODs.
+  static void cook(const Model::Builder &builder, const std::string &filepath,
+                   uint32_t maxChunkTriangles, const SourceStamp &stamp,
+                   uint64_t sourceHash);
+
+  const ChunkedMeshHeader &getHeader() const { return header; }
+  uint32_t getChunkCount() const { return header.chunkCount; }
+  const MeshChunk &getChunk(uint32_t chunk) const { return chunks[chunk]; }
+
+  const void *getPositions(uint32_t chunk) const {
+    return file.data() + chunks[chunk].positionOffset;
+  }
+  const void *getAttributes(uint32_t chunk) const {
+    return file.data() + chunks[chunk].attributeOffset;
+  }
+  const void *getIndices(uint32_t chunk) const {
+    return file.data() + chunks[chunk].indexOffset;
+  }
+
+private:
+  MappedFile file;
+  ChunkedMeshHeader header{};
+  const MeshChunk *chunks = nullptr;
+};
+
+} // namespace vkEngine
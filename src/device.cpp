@@ -1,4 +1,5 @@
 #include "device.hpp"
+#include "staging_pool.hpp"
 
 // std headers
 #include <cstring>
@@ -54,10 +55,17 @@ VkEngineDevice::VkEngineDevice(Window &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  allocator = std::make_unique<VkEngineAllocator>(physicalDevice, device_);
+  stagingPool = std::make_unique<VkEngineStagingPool>(*this);
 }
 
 VkEngineDevice::~VkEngineDevice() {
+  if (transferCommandPool != commandPool) {
+    vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+  }
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  stagingPool.reset();
+  allocator.reset();
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
@@ -138,6 +146,9 @@ void VkEngineDevice::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  if (indices.transferFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.transferFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -149,8 +160,13 @@ void VkEngineDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  largePoints = supportedFeatures.largePoints == VK_TRUE;
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.largePoints = supportedFeatures.largePoints;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -177,6 +193,17 @@ void VkEngineDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+  if (indices.transferFamilyHasValue) {
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+    std::cout << "transfer queue family: " << indices.transferFamily << std::endl;
+  } else {
+    // fall back to uploading on the graphics queue
+    indices.transferFamily = indices.graphicsFamily;
+    transferQueue_ = graphicsQueue_;
+    std::cout << "transfer queue family: none, using graphics" << std::endl;
+  }
+  queueFamilies = indices;
 }
 
 void VkEngineDevice::createCommandPool() {
@@ -191,6 +218,14 @@ void VkEngineDevice::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  transferCommandPool = commandPool;
+  if (hasDedicatedTransferQueue()) {
+    poolInfo.queueFamilyIndex = queueFamilies.transferFamily;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transfer command pool!");
+    }
+  }
 }
 
 void VkEngineDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -319,6 +354,7 @@ bool VkEngineDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 
 QueueFamilyIndices VkEngineDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
+  bool transferFamilyIsDedicated = false;
 
   uint32_t queueFamilyCount = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -328,18 +364,29 @@ QueueFamilyIndices VkEngineDevice::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-      indices.graphicsFamily = i;
-      indices.graphicsFamilyHasValue = true;
-    }
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
-      indices.presentFamily = i;
-      indices.presentFamilyHasValue = true;
+    if (!indices.isComplete()) {
+      if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        indices.graphicsFamily = i;
+        indices.graphicsFamilyHasValue = true;
+      }
+      VkBool32 presentSupport = false;
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+      if (queueFamily.queueCount > 0 && presentSupport) {
+        indices.presentFamily = i;
+        indices.presentFamilyHasValue = true;
+      }
     }
-    if (indices.isComplete()) {
-      break;
+
+    // prefer a pure copy engine over an async compute family
+    bool transferOnly = queueFamily.queueCount > 0 &&
+                        (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                        !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    bool dedicated = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+    if (transferOnly &&
+        (!indices.transferFamilyHasValue || (dedicated && !transferFamilyIsDedicated))) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
+      transferFamilyIsDedicated = dedicated;
     }
 
     i++;
@@ -408,7 +455,7 @@ void VkEngineDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    VkEngineAllocation &allocation) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -422,16 +469,9 @@ void VkEngineDevice::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  allocation = allocator->allocate(memRequirements, properties, VkEngineAllocator::Resource::Buffer);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
-
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+  vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset);
 }
 
 VkCommandBuffer VkEngineDevice::beginSingleTimeCommands() {
@@ -509,7 +549,8 @@ void VkEngineDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    VkEngineAllocation &allocation,
+    VkEngineAllocator::Strategy strategy) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -517,16 +558,13 @@ void VkEngineDevice::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  // linearly tiled images sit next to buffers without granularity conflicts
+  VkEngineAllocator::Resource resource = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL
+                                             ? VkEngineAllocator::Resource::OptimalImage
+                                             : VkEngineAllocator::Resource::Buffer;
+  allocation = allocator->allocate(memRequirements, properties, resource, strategy);
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+  if (vkBindImageMemory(device_, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
@@ -1,13 +1,17 @@
 #pragma once
 
+#include "allocator.hpp"
 #include "window.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace vkEngine {
 
+class VkEngineStagingPool;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +21,11 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // a transfer capable family without graphics, if the device has one
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -45,6 +52,16 @@ public:
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
 
+  // Uploads go to a transfer only queue family when the device has one, so
+  // they overlap with rendering. Resources written there are exclusively
+  // owned and need a release/acquire ownership transfer to the graphics
+  // family. Without one, these alias the graphics queue and command pool.
+  VkQueue transferQueue() { return transferQueue_; }
+  VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+  bool hasDedicatedTransferQueue() { return transferQueue_ != graphicsQueue_; }
+  uint32_t getGraphicsQueueFamily() { return queueFamilies.graphicsFamily; }
+  uint32_t getTransferQueueFamily() { return queueFamilies.transferFamily; }
+
   SwapChainSupportDetails getSwapChainSupport() {
     return querySwapChainSupport(physicalDevice);
   }
@@ -57,10 +74,16 @@ public:
                                VkImageTiling tiling,
                                VkFormatFeatureFlags features);
 
+  // Buffers and images are bound to ranges of the allocator's blocks, and
+  // the allocation is returned to it with getAllocator().free().
+  VkEngineAllocator &getAllocator() { return *allocator; }
+  // staging buffers of upload batches, see VkEngineUploadBatch
+  VkEngineStagingPool &getStagingPool() { return *stagingPool; }
+
   // Buffer Helper Functions
   void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                     VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                    VkDeviceMemory &bufferMemory);
+                    VkEngineAllocation &allocation);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -69,7 +92,14 @@ public:
 
   void createImageWithInfo(const VkImageCreateInfo &imageInfo,
                            VkMemoryPropertyFlags properties, VkImage &image,
-                           VkDeviceMemory &imageMemory);
+                           VkEngineAllocation &allocation,
+                           VkEngineAllocator::Strategy strategy =
+                               VkEngineAllocator::Strategy::Tlsf);
+
+  // largest gl_PointSize the device rasterizes, 1 without largePoints
+  float getMaxPointSize() const {
+    return largePoints ? properties.limits.pointSizeRange[1] : 1.f;
+  }
 
   VkPhysicalDeviceProperties properties;
 
@@ -97,11 +127,19 @@ private:
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   Window &window;
   VkCommandPool commandPool;
+  VkCommandPool transferCommandPool;
+  QueueFamilyIndices queueFamilies;
+  // enabled when supported, for point sprites larger than a pixel
+  bool largePoints = false;
 
   VkDevice device_;
+  std::unique_ptr<VkEngineAllocator> allocator;
+  // holds buffers, so it is destroyed before the allocator
+  std::unique_ptr<VkEngineStagingPool> stagingPool;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
 
   const std::vector<const char *> validationLayers = {
       "VK_LAYER_KHRONOS_validation"};
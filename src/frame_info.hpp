@@ -3,6 +3,7 @@
 
 #include "camera.hpp"
 #include "game_object.hpp"
+#include "ring_buffer.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
@@ -14,6 +15,11 @@ struct FrameInfo {
   VkCommandBuffer commandBuffer;
   VkEngineCamera &camera;
   VkDescriptorSet globalDescriptorSet;
+  // dynamic offset of this frame's GlobalUbo in frameRing
+  uint32_t globalUboOffset;
   VkEngineGameObject::Map &gameObject;
+  VkExtent2D extent;
+  // transient data of this frame, recycled once it has been rendered
+  VkEngineRingBuffer &frameRing;
 };
 }  // namespace vkEngine
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+
+namespace vkEngine {
+
+// View frustum planes, pointing inwards, extracted from a projection view
+// matrix (Gribb/Hartmann). Depth is zero to one.
+struct Frustum {
+  std::array<glm::vec4, 6> planes{};
+
+  explicit Frustum(const glm::mat4 &projectionView) {
+    glm::mat4 m = glm::transpose(projectionView);
+    planes = {m[3] + m[0], m[3] - m[0], m[3] + m[1],
+              m[3] - m[1], m[2],        m[3] - m[2]};
+    for (auto &plane : planes) {
+      plane /= glm::length(glm::vec3{plane});
+    }
+  }
+
+  // false only if the sphere is entirely outside one of the planes
+  bool intersectsSphere(const glm::vec3 &center, float radius) const {
+    for (const auto &plane : planes) {
+      if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// largest axis scale of a transform, spheres grown by it stay conservative
+inline float getMaxScale(const glm::mat4 &transform) {
+  return glm::max(glm::length(glm::vec3{transform[0]}),
+                  glm::max(glm::length(glm::vec3{transform[1]}),
+                           glm::length(glm::vec3{transform[2]})));
+}
+
+} // namespace vkEngine
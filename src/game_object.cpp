@@ -2,7 +2,7 @@
 
 namespace vkEngine {
 
-glm::mat4 TransformComponent::mat4() {
+glm::mat4 TransformComponent::mat4() const {
   // slower
 
   // auto transform = glm::translate(glm::mat4(1.f), translation);
@@ -41,7 +41,7 @@ glm::mat4 TransformComponent::mat4() {
                    {translation.x, translation.y, translation.z, 1.0f}};
 }
 
-glm::mat3 TransformComponent::normalMatrix() {
+glm::mat3 TransformComponent::normalMatrix() const {
   const float c3 = glm::cos(rotation.z);
   const float s3 = glm::sin(rotation.z);
   const float c2 = glm::cos(rotation.x);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "model.hpp"
+#include "point_cloud.hpp"
+#include "streamed_model.hpp"
 
 // libs
 #include <glm/ext/matrix_transform.hpp>
@@ -18,9 +20,9 @@ struct TransformComponent {
   glm::vec3 rotation{};
 
   // implement Quaternions?
-  glm::mat4 mat4();
+  glm::mat4 mat4() const;
 
-  glm::mat3 normalMatrix();
+  glm::mat3 normalMatrix() const;
 };
 
 class VkEngineGameObject {
@@ -36,6 +38,10 @@ public:
   id_t getId() { return id; }
 
   std::shared_ptr<Model> model;
+  // drawn chunk by chunk as far as it is resident, instead of model
+  std::shared_ptr<StreamedModel> streamedModel;
+  // drawn as point sprites by PointCloudRenderSystem
+  std::shared_ptr<PointCloud> pointCloud;
   glm::vec3 color{};
   TransformComponent transform{};
 
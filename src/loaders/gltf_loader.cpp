@@ -0,0 +1,684 @@
+#include "gltf_loader.hpp"
+#include "json.hpp"
+#include "mapped_file.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vkEngine {
+
+namespace {
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_VERSION = 2;
+constexpr uint32_t CHUNK_JSON = 0x4E4F534A;
+constexpr uint32_t CHUNK_BIN = 0x004E4942;
+constexpr size_t GLB_HEADER_SIZE = 12;
+constexpr size_t CHUNK_HEADER_SIZE = 8;
+constexpr int64_t MODE_TRIANGLES = 4;
+
+enum ComponentType : uint32_t {
+  BYTE = 5120,
+  UNSIGNED_BYTE = 5121,
+  SHORT = 5122,
+  UNSIGNED_SHORT = 5123,
+  UNSIGNED_INT = 5125,
+  FLOAT = 5126,
+};
+
+[[noreturn]] void fail(const std::string &what) {
+  throw std::runtime_error("Malformed GLB file, " + what);
+}
+
+uint32_t readU32(const char *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// offsets, lengths and counts, which must be non negative integers
+uint64_t getSize(const JsonValue &value, uint64_t fallback = 0) {
+  if (value.isNull()) {
+    return fallback;
+  }
+  int64_t size = value.getInteger(-1);
+  if (size < 0) {
+    fail("expected a non negative integer");
+  }
+  return static_cast<uint64_t>(size);
+}
+
+size_t getComponentSize(uint32_t componentType) {
+  switch (componentType) {
+  case BYTE:
+  case UNSIGNED_BYTE:
+    return 1;
+  case SHORT:
+  case UNSIGNED_SHORT:
+    return 2;
+  case UNSIGNED_INT:
+  case FLOAT:
+    return 4;
+  default:
+    fail("unknown component type " + std::to_string(componentType));
+  }
+}
+
+int getComponentCount(const std::string &type) {
+  if (type == "SCALAR") {
+    return 1;
+  }
+  if (type == "VEC2") {
+    return 2;
+  }
+  if (type == "VEC3") {
+    return 3;
+  }
+  if (type == "VEC4") {
+    return 4;
+  }
+  fail("unsupported accessor type " + type);
+}
+
+// A typed view of a buffer view's elements, pointing into the mapped file.
+struct Accessor {
+  const char *data = nullptr;
+  size_t count = 0;
+  size_t stride = 0;
+  uint32_t componentType = FLOAT;
+  int componentCount = 0;
+  bool normalized = false;
+
+  bool isPresent() const { return data != nullptr; }
+  bool isTightFloat(int components) const {
+    return componentType == FLOAT && componentCount == components &&
+           stride == components * sizeof(float);
+  }
+
+  // as floats, normalized integers mapped to [0, 1] or [-1, 1]
+  void read(size_t i, float *out) const {
+    const char *element = data + i * stride;
+    switch (componentType) {
+    case FLOAT:
+      std::memcpy(out, element, componentCount * sizeof(float));
+      return;
+    case UNSIGNED_BYTE:
+      for (int c = 0; c < componentCount; c++) {
+        float value = static_cast<uint8_t>(element[c]);
+        out[c] = normalized ? value / 255.f : value;
+      }
+      return;
+    case BYTE:
+      for (int c = 0; c < componentCount; c++) {
+        float value = static_cast<int8_t>(element[c]);
+        out[c] = normalized ? std::max(value / 127.f, -1.f) : value;
+      }
+      return;
+    default:
+      for (int c = 0; c < componentCount; c++) {
+        uint16_t bits;
+        std::memcpy(&bits, element + 2 * c, sizeof(bits));
+        float value = componentType == SHORT
+                          ? static_cast<float>(static_cast<int16_t>(bits))
+                          : static_cast<float>(bits);
+        if (normalized) {
+          value = componentType == SHORT ? std::max(value / 32767.f, -1.f)
+                                         : value / 65535.f;
+        }
+        out[c] = value;
+      }
+    }
+  }
+
+  uint32_t readIndex(size_t i) const {
+    const char *element = data + i * stride;
+    if (componentType == UNSIGNED_BYTE) {
+      return static_cast<uint8_t>(*element);
+    }
+    if (componentType == UNSIGNED_SHORT) {
+      uint16_t index;
+      std::memcpy(&index, element, sizeof(index));
+      return index;
+    }
+    return readU32(element);
+  }
+};
+
+// A triangle primitive placed by its node, with its range in the combined
+// vertex and index buffers.
+struct Primitive {
+  Accessor positions;
+  Accessor normals;
+  Accessor uvs;
+  Accessor colors;
+  Accessor tangents;
+  // not present for non indexed primitives
+  Accessor indices;
+
+  glm::mat4 transform{1.f};
+  // cofactors of the upper 3x3, the inverse transpose up to a positive scale
+  glm::mat3 normalTransform{1.f};
+  bool identity = true;
+  // a negative determinant turns the winding and the tangent handedness
+  bool mirrored = false;
+
+  uint32_t firstVertex = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+
+  uint32_t getIndex(size_t i) const {
+    return indices.isPresent() ? indices.readIndex(i)
+                               : static_cast<uint32_t>(i);
+  }
+
+  glm::vec3 readPosition(size_t i) const {
+    glm::vec3 position;
+    positions.read(i, &position.x);
+    return identity ? position
+                    : glm::vec3{transform * glm::vec4{position, 1.f}};
+  }
+
+  // every attribute but the position
+  void readAttributes(size_t i, Model::Vertex &vertex) const {
+    vertex.color = glm::vec3{1.f};
+    if (colors.isPresent()) {
+      float color[4];
+      colors.read(i, color);
+      vertex.color = {color[0], color[1], color[2]};
+    }
+    vertex.normal = glm::vec3{0.f};
+    if (normals.isPresent()) {
+      normals.read(i, &vertex.normal.x);
+      if (!identity) {
+        glm::vec3 normal = normalTransform * vertex.normal;
+        float length = glm::length(normal);
+        vertex.normal = length > 0.f ? normal / length : glm::vec3{0.f};
+      }
+    }
+    vertex.uv = glm::vec2{0.f};
+    if (uvs.isPresent()) {
+      uvs.read(i, &vertex.uv.x);
+    }
+  }
+
+  // zero where the primitive has no tangents
+  glm::vec4 readTangent(size_t i) const {
+    glm::vec4 tangent{0.f};
+    if (!tangents.isPresent()) {
+      return tangent;
+    }
+    tangents.read(i, &tangent.x);
+    if (identity) {
+      return tangent;
+    }
+    glm::vec3 direction = glm::mat3{transform} * glm::vec3{tangent};
+    float length = glm::length(direction);
+    return {length > 0.f ? direction / length : glm::vec3{0.f},
+            mirrored ? -tangent.w : tangent.w};
+  }
+};
+
+bool hasTangents(const std::vector<Primitive> &primitives) {
+  return std::any_of(
+      primitives.begin(), primitives.end(),
+      [](const Primitive &primitive) { return primitive.tangents.isPresent(); });
+}
+
+glm::mat4 getNodeTransform(const JsonValue &node) {
+  const JsonValue &matrix = node["matrix"];
+  if (matrix.size() == 16) {
+    glm::mat4 transform;
+    for (int column = 0; column < 4; column++) {
+      for (int row = 0; row < 4; row++) {
+        transform[column][row] =
+            static_cast<float>(matrix[4 * column + row].getNumber());
+      }
+    }
+    return transform;
+  }
+
+  const JsonValue &t = node["translation"];
+  const JsonValue &r = node["rotation"];
+  const JsonValue &s = node["scale"];
+  glm::vec3 translation{static_cast<float>(t[0].getNumber()),
+                        static_cast<float>(t[1].getNumber()),
+                        static_cast<float>(t[2].getNumber())};
+  glm::vec3 scale{static_cast<float>(s[0].getNumber(1.0)),
+                  static_cast<float>(s[1].getNumber(1.0)),
+                  static_cast<float>(s[2].getNumber(1.0))};
+  float x = static_cast<float>(r[0].getNumber());
+  float y = static_cast<float>(r[1].getNumber());
+  float z = static_cast<float>(r[2].getNumber());
+  float w = static_cast<float>(r[3].getNumber(1.0));
+
+  // T * R * S with the unit quaternion (x, y, z, w) as R
+  glm::mat4 transform{1.f};
+  transform[0] = glm::vec4{1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z),
+                           2.f * (x * z - w * y), 0.f} *
+                 scale.x;
+  transform[1] = glm::vec4{2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z),
+                           2.f * (y * z + w * x), 0.f} *
+                 scale.y;
+  transform[2] = glm::vec4{2.f * (x * z + w * y), 2.f * (y * z - w * x),
+                           1.f - 2.f * (x * x + y * y), 0.f} *
+                 scale.z;
+  transform[3] = glm::vec4{translation, 1.f};
+  return transform;
+}
+
+// The container, its JSON and the primitives of the default scene.
+class GlbDocument {
+public:
+  explicit GlbDocument(const std::string &filepath)
+      : file{filepath, MappedFile::Access::Sequential} {
+    parseContainer();
+    collectPrimitives();
+  }
+
+  std::vector<Primitive> primitives;
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+
+private:
+  void parseContainer() {
+    const char *data = file.data();
+    size_t size = file.size();
+    if (size < GLB_HEADER_SIZE + CHUNK_HEADER_SIZE ||
+        readU32(data) != GLB_MAGIC) {
+      fail("not a binary glTF");
+    }
+    if (readU32(data + 4) != GLB_VERSION) {
+      fail("only glTF 2.0 is supported");
+    }
+    size = std::min<size_t>(size, readU32(data + 8));
+
+    // the JSON chunk comes first, an optional binary chunk right after it
+    size_t offset = GLB_HEADER_SIZE;
+    bool hasJson = false;
+    while (offset + CHUNK_HEADER_SIZE <= size) {
+      size_t length = readU32(data + offset);
+      uint32_t type = readU32(data + offset + 4);
+      offset += CHUNK_HEADER_SIZE;
+      if (length > size - offset) {
+        fail("truncated chunk");
+      }
+      if (type == CHUNK_JSON && !hasJson) {
+        json = JsonValue::parse({data + offset, length});
+        hasJson = true;
+      } else if (type == CHUNK_BIN && hasJson && !binary) {
+        binary = data + offset;
+        binarySize = length;
+      }
+      offset += length;
+    }
+    if (!hasJson) {
+      fail("no JSON chunk");
+    }
+
+    const JsonValue &buffers = json["buffers"];
+    if (buffers.size() > 1 || buffers[0].contains("uri")) {
+      fail("only the embedded binary buffer is supported");
+    }
+    if (buffers.size() == 1 && getSize(buffers[0]["byteLength"]) > binarySize) {
+      fail("binary chunk is shorter than its buffer");
+    }
+  }
+
+  void collectPrimitives() {
+    const JsonValue &scenes = json["scenes"];
+    if (scenes.size() > 0) {
+      const JsonValue &scene = scenes[getSize(json["scene"])];
+      if (!scene.isObject()) {
+        fail("missing default scene");
+      }
+      const JsonValue &roots = scene["nodes"];
+      for (size_t i = 0; i < roots.size(); i++) {
+        addNode(getSize(roots[i]), glm::mat4{1.f}, 0);
+      }
+    } else {
+      // a file without scenes is a library of meshes, show each once
+      for (size_t mesh = 0; mesh < json["meshes"].size(); mesh++) {
+        addMesh(mesh, glm::mat4{1.f});
+      }
+    }
+    if (primitives.empty()) {
+      fail("no triangle primitives");
+    }
+  }
+
+  void addNode(uint64_t index, const glm::mat4 &parent, size_t depth) {
+    const JsonValue &nodes = json["nodes"];
+    const JsonValue &node = nodes[index];
+    // a path longer than the node count has to go around a cycle
+    if (!node.isObject() || depth > nodes.size()) {
+      fail("invalid node hierarchy");
+    }
+    glm::mat4 transform = parent * getNodeTransform(node);
+    if (node.contains("mesh")) {
+      addMesh(getSize(node["mesh"]), transform);
+    }
+    const JsonValue &children = node["children"];
+    for (size_t i = 0; i < children.size(); i++) {
+      addNode(getSize(children[i]), transform, depth + 1);
+    }
+  }
+
+  void addMesh(uint64_t index, const glm::mat4 &transform) {
+    const JsonValue &mesh = json["meshes"][index];
+    if (!mesh.isObject()) {
+      fail("missing mesh");
+    }
+    const JsonValue &meshPrimitives = mesh["primitives"];
+    for (size_t p = 0; p < meshPrimitives.size(); p++) {
+      const JsonValue &source = meshPrimitives[p];
+      if (source["mode"].getInteger(MODE_TRIANGLES) != MODE_TRIANGLES) {
+        continue;
+      }
+
+      const JsonValue &attributes = source["attributes"];
+      Primitive primitive{};
+      primitive.positions = getAccessor(attributes["POSITION"]);
+      if (!primitive.positions.isPresent() ||
+          primitive.positions.componentType != FLOAT ||
+          primitive.positions.componentCount != 3) {
+        fail("primitives need float3 positions");
+      }
+      size_t count = primitive.positions.count;
+      primitive.normals = getAttribute(attributes["NORMAL"], count, 3, 3);
+      primitive.uvs = getAttribute(attributes["TEXCOORD_0"], count, 2, 2);
+      primitive.colors = getAttribute(attributes["COLOR_0"], count, 3, 4);
+      primitive.tangents = getAttribute(attributes["TANGENT"], count, 4, 4);
+      primitive.indices = getAccessor(source["indices"]);
+
+      const Accessor &indices = primitive.indices;
+      size_t cornerCount = indices.isPresent() ? indices.count : count;
+      if (indices.isPresent()) {
+        if (indices.componentCount != 1 ||
+            (indices.componentType != UNSIGNED_BYTE &&
+             indices.componentType != UNSIGNED_SHORT &&
+             indices.componentType != UNSIGNED_INT)) {
+          fail("indices have to be unsigned scalars");
+        }
+        for (size_t i = 0; i < indices.count; i++) {
+          if (indices.readIndex(i) >= count) {
+            fail("index out of range");
+          }
+        }
+      }
+      // a trailing partial triangle is not drawn anyway
+      cornerCount -= cornerCount % 3;
+      if (cornerCount == 0) {
+        continue;
+      }
+      if (count > std::numeric_limits<uint32_t>::max() - vertexCount ||
+          cornerCount > std::numeric_limits<uint32_t>::max() - indexCount) {
+        fail("too many vertices");
+      }
+
+      primitive.transform = transform;
+      primitive.identity = transform == glm::mat4{1.f};
+      glm::vec3 x{transform[0]};
+      glm::vec3 y{transform[1]};
+      glm::vec3 z{transform[2]};
+      float determinant = glm::dot(x, glm::cross(y, z));
+      primitive.mirrored = determinant < 0.f;
+      float sign = primitive.mirrored ? -1.f : 1.f;
+      primitive.normalTransform = glm::mat3{glm::cross(y, z) * sign,
+                                            glm::cross(z, x) * sign,
+                                            glm::cross(x, y) * sign};
+
+      primitive.firstVertex = vertexCount;
+      primitive.firstIndex = indexCount;
+      primitive.indexCount = static_cast<uint32_t>(cornerCount);
+      vertexCount += static_cast<uint32_t>(count);
+      indexCount += primitive.indexCount;
+      primitives.push_back(primitive);
+    }
+  }
+
+  Accessor getAccessor(const JsonValue &index) {
+    if (index.isNull()) {
+      return {};
+    }
+    const JsonValue &accessor = json["accessors"][getSize(index)];
+    if (!accessor.isObject()) {
+      fail("missing accessor");
+    }
+    if (accessor.contains("sparse")) {
+      fail("sparse accessors are not supported");
+    }
+    const JsonValue &view = json["bufferViews"][getSize(accessor["bufferView"],
+                                                        UINT64_MAX)];
+    if (!view.isObject() || getSize(view["buffer"]) != 0 || !binary) {
+      fail("accessors have to view the embedded binary buffer");
+    }
+
+    Accessor result{};
+    result.componentType = static_cast<uint32_t>(
+        getSize(accessor["componentType"]));
+    result.componentCount = getComponentCount(accessor["type"].getString());
+    result.normalized = accessor["normalized"].getBool();
+    result.count = getSize(accessor["count"]);
+    size_t elementSize =
+        getComponentSize(result.componentType) * result.componentCount;
+    result.stride = getSize(view["byteStride"], elementSize);
+    if (result.stride < elementSize) {
+      fail("buffer view stride is smaller than its elements");
+    }
+
+    uint64_t viewOffset = getSize(view["byteOffset"]);
+    uint64_t viewLength = getSize(view["byteLength"]);
+    uint64_t offset = getSize(accessor["byteOffset"]);
+    if (viewOffset > binarySize || viewLength > binarySize - viewOffset ||
+        offset > viewLength) {
+      fail("buffer view out of the binary buffer");
+    }
+    uint64_t available = viewLength - offset;
+    if (result.count > 0 &&
+        (elementSize > available ||
+         result.count - 1 > (available - elementSize) / result.stride)) {
+      fail("accessor out of its buffer view");
+    }
+    result.data = binary + viewOffset + offset;
+    return result;
+  }
+
+  Accessor getAttribute(const JsonValue &index, size_t count,
+                        int minimumComponents, int maximumComponents) {
+    Accessor accessor = getAccessor(index);
+    if (!accessor.isPresent()) {
+      return accessor;
+    }
+    if (accessor.count != count ||
+        accessor.componentCount < minimumComponents ||
+        accessor.componentCount > maximumComponents) {
+      fail("attribute does not match the positions");
+    }
+    return accessor;
+  }
+
+  MappedFile file;
+  JsonValue json;
+  const char *binary = nullptr;
+  size_t binarySize = 0;
+};
+
+template <typename Index>
+void writePrimitiveIndices(const Primitive &primitive, Index *out) {
+  for (uint32_t i = 0; i < primitive.indexCount; i += 3) {
+    uint32_t a = primitive.getIndex(i);
+    uint32_t b = primitive.getIndex(i + 1);
+    uint32_t c = primitive.getIndex(i + 2);
+    if (primitive.mirrored) {
+      std::swap(b, c);
+    }
+    out[i] = static_cast<Index>(primitive.firstVertex + a);
+    out[i + 1] = static_cast<Index>(primitive.firstVertex + b);
+    out[i + 2] = static_cast<Index>(primitive.firstVertex + c);
+  }
+}
+
+class GlbMeshSource : public Model::MeshSource {
+public:
+  explicit GlbMeshSource(const std::string &filepath) : document{filepath} {
+    indexType = Model::getIndexType(document.vertexCount);
+    for (const Primitive &primitive : document.primitives) {
+      subMeshes.push_back({primitive.firstIndex, primitive.indexCount});
+
+      // the spheres are merged, close enough for culling and far cheaper
+      // than a pass over every transformed position
+      const Accessor &positions = primitive.positions;
+      Bounds primitiveBounds = computeBounds(
+          reinterpret_cast<const float *>(positions.data), positions.count,
+          positions.stride);
+      if (!primitive.identity) {
+        primitiveBounds = primitiveBounds.transformed(primitive.transform);
+      }
+      bounds = &primitive == &document.primitives[0]
+                   ? primitiveBounds
+                   : mergeBounds(bounds, primitiveBounds);
+    }
+  }
+
+  const GlbDocument &getDocument() const { return document; }
+
+  Model::MeshData getMeshData() const override {
+    Model::MeshData data{};
+    data.vertexCount = document.vertexCount;
+    data.hasTangents = hasTangents(document.primitives);
+    data.indexCount = document.indexCount;
+    data.indexType = indexType;
+    data.subMeshes = subMeshes.data();
+    data.subMeshCount = static_cast<uint32_t>(subMeshes.size());
+    data.source = this;
+    return data;
+  }
+
+  void writePositions(glm::vec3 *out) const override {
+    for (const Primitive &primitive : document.primitives) {
+      glm::vec3 *positions = out + primitive.firstVertex;
+      size_t count = primitive.positions.count;
+      if (primitive.identity && primitive.positions.isTightFloat(3)) {
+        std::memcpy(positions, primitive.positions.data,
+                    count * sizeof(glm::vec3));
+        continue;
+      }
+      for (size_t i = 0; i < count; i++) {
+        positions[i] = primitive.readPosition(i);
+      }
+    }
+  }
+
+  void writeAttributes(void *out) const override {
+    constexpr size_t attributeOffset = sizeof(Model::Vertex::position);
+    constexpr size_t attributeSize = sizeof(Model::Vertex) - attributeOffset;
+    char *attributes = static_cast<char *>(out);
+    Model::Vertex vertex{};
+    for (const Primitive &primitive : document.primitives) {
+      char *primitiveAttributes =
+          attributes + size_t{primitive.firstVertex} * attributeSize;
+      for (size_t i = 0; i < primitive.positions.count; i++) {
+        primitive.readAttributes(i, vertex);
+        std::memcpy(primitiveAttributes + i * attributeSize,
+                    reinterpret_cast<const char *>(&vertex) + attributeOffset,
+                    attributeSize);
+      }
+    }
+  }
+
+  void writeTangents(glm::vec4 *out) const override {
+    for (const Primitive &primitive : document.primitives) {
+      glm::vec4 *tangents = out + primitive.firstVertex;
+      for (size_t i = 0; i < primitive.positions.count; i++) {
+        tangents[i] = primitive.readTangent(i);
+      }
+    }
+  }
+
+  void writeIndices(void *out) const override {
+    size_t indexSize = Model::getIndexSize(indexType);
+    for (const Primitive &primitive : document.primitives) {
+      const Accessor &indices = primitive.indices;
+      void *primitiveIndices =
+          static_cast<char *>(out) + size_t{primitive.firstIndex} * indexSize;
+      // the file's indices are the GPU's when nothing has to be rebased
+      if (indices.isPresent() && primitive.firstVertex == 0 &&
+          !primitive.mirrored && indices.stride == indexSize &&
+          getComponentSize(indices.componentType) == indexSize) {
+        std::memcpy(primitiveIndices, indices.data,
+                    primitive.indexCount * indexSize);
+      } else if (indexType == VK_INDEX_TYPE_UINT16) {
+        writePrimitiveIndices(primitive,
+                              static_cast<uint16_t *>(primitiveIndices));
+      } else {
+        writePrimitiveIndices(primitive,
+                              static_cast<uint32_t *>(primitiveIndices));
+      }
+    }
+  }
+
+  Bounds getBounds() const override { return bounds; }
+
+private:
+  GlbDocument document;
+  VkIndexType indexType;
+  std::vector<Model::SubMesh> subMeshes;
+  Bounds bounds{};
+};
+
+} // namespace
+
+void loadGlb(const std::string &filepath, Model::Builder &builder) {
+  GlbDocument document{filepath};
+  builder.vertices.resize(document.vertexCount);
+  builder.indices.resize(document.indexCount);
+  builder.subMeshes.clear();
+  builder.tangents.clear();
+  if (hasTangents(document.primitives)) {
+    builder.tangents.resize(document.vertexCount);
+  }
+  for (const Primitive &primitive : document.primitives) {
+    builder.subMeshes.push_back({primitive.firstIndex, primitive.indexCount});
+    Model::Vertex *vertices = &builder.vertices[primitive.firstVertex];
+    for (size_t i = 0; i < primitive.positions.count; i++) {
+      vertices[i].position = primitive.readPosition(i);
+      primitive.readAttributes(i, vertices[i]);
+    }
+    if (!builder.tangents.empty()) {
+      for (size_t i = 0; i < primitive.positions.count; i++) {
+        builder.tangents[primitive.firstVertex + i] = primitive.readTangent(i);
+      }
+    }
+    writePrimitiveIndices(primitive, &builder.indices[primitive.firstIndex]);
+  }
+}
+
+std::unique_ptr<Model::MeshSource>
+openGlbSource(const std::string &filepath, const Model::LoadOptions &options) {
+  // generated tangents replace the file's, so they always need the builder
+  if (options.optimizeMeshes || options.generateLods ||
+      options.generateMeshlets || options.quantizeVertices ||
+      options.generateAngleWeightedTangents ||
+      options.normalGeneration == Model::NormalGeneration::All) {
+    return nullptr;
+  }
+
+  auto source = std::make_unique<GlbMeshSource>(filepath);
+  for (const Primitive &primitive : source->getDocument().primitives) {
+    if (options.normalGeneration == Model::NormalGeneration::Missing &&
+        !primitive.normals.isPresent()) {
+      return nullptr;
+    }
+  }
+  return source;
+}
+
+} // namespace vkEngine
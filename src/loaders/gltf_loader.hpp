@@ -0,0 +1,34 @@
+#pragma once
+
+#include "model.hpp"
+
+// std
+#include <memory>
+#include <string>
+
+namespace vkEngine {
+
+// Reads the triangle primitives of a binary glTF 2.0 (.glb) file into the
+// builder, one sub-mesh per primitive in node order.
+//
+// The default scene's node transforms are baked into the vertices, a mesh
+// used by several nodes is added once per node. Only the embedded binary
+// buffer is supported, external and data URI buffers, sparse accessors and
+// primitives other than triangle lists are not. Attributes the file does not
+// have are left zero, colors default to white like the other loaders.
+void loadGlb(const std::string &filepath, Model::Builder &builder);
+
+// Opens a .glb for an upload straight out of the mapped file: accessors are
+// copied or converted into the staging buffers without building a Builder
+// first. Returns nullptr when options ask for processing that needs one
+// (optimizing, levels of detail, meshlets, quantization, generated tangents
+// or normals the file does not have), in which case loadGlb() is the way.
+//
+// optimizeMeshes is on by default, so a .glb only takes this path when the
+// caller clears it, e.g. for files an exporter already optimized. The passes
+// reorder the indices and vertices on the CPU, running them after the upload
+// would mean reading the data back and lose what the direct path saves.
+std::unique_ptr<Model::MeshSource>
+openGlbSource(const std::string &filepath, const Model::LoadOptions &options);
+
+} // namespace vkEngine
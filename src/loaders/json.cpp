@@ -0,0 +1,359 @@
+#include "json.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace vkEngine {
+
+namespace {
+
+// deeper documents are rejected instead of overflowing the stack
+constexpr int MAX_DEPTH = 256;
+
+const JsonValue &getNull() {
+  static const JsonValue null{};
+  return null;
+}
+
+void appendUtf8(std::string &out, uint32_t codePoint) {
+  if (codePoint < 0x80) {
+    out += static_cast<char>(codePoint);
+  } else if (codePoint < 0x800) {
+    out += static_cast<char>(0xC0 | (codePoint >> 6));
+    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+  } else if (codePoint < 0x10000) {
+    out += static_cast<char>(0xE0 | (codePoint >> 12));
+    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (codePoint >> 18));
+    out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (codePoint & 0x3F));
+  }
+}
+
+} // namespace
+
+class JsonValue::Parser {
+public:
+  explicit Parser(std::string_view text) : text{text} {}
+
+  JsonValue parseDocument() {
+    JsonValue value = parseValue(0);
+    skipWhitespace();
+    if (position != text.size()) {
+      fail("trailing characters");
+    }
+    return value;
+  }
+
+private:
+  [[noreturn]] void fail(const char *what) const {
+    throw std::runtime_error("Invalid JSON at byte " +
+                             std::to_string(position) + ": " + what);
+  }
+
+  void skipWhitespace() {
+    while (position < text.size() &&
+           (text[position] == ' ' || text[position] == '\t' ||
+            text[position] == '\n' || text[position] == '\r')) {
+      position++;
+    }
+  }
+
+  char peek() const { return position < text.size() ? text[position] : '\0'; }
+
+  void expect(char c) {
+    if (peek() != c) {
+      fail("unexpected character");
+    }
+    position++;
+  }
+
+  bool consumeLiteral(std::string_view literal) {
+    if (text.substr(position, literal.size()) != literal) {
+      return false;
+    }
+    position += literal.size();
+    return true;
+  }
+
+  JsonValue parseValue(int depth) {
+    if (depth > MAX_DEPTH) {
+      fail("nested too deeply");
+    }
+    skipWhitespace();
+    JsonValue value;
+    char c = peek();
+    if (c == '{') {
+      value.type = Type::Object;
+      parseObject(value, depth);
+    } else if (c == '[') {
+      value.type = Type::Array;
+      parseArray(value, depth);
+    } else if (c == '"') {
+      value.type = Type::String;
+      value.string = parseString();
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      value.type = Type::Number;
+      value.number = parseNumber();
+    } else if (consumeLiteral("true")) {
+      value.type = Type::Bool;
+      value.boolean = true;
+    } else if (consumeLiteral("false")) {
+      value.type = Type::Bool;
+    } else if (!consumeLiteral("null")) {
+      fail("expected a value");
+    }
+    return value;
+  }
+
+  void parseObject(JsonValue &value, int depth) {
+    expect('{');
+    skipWhitespace();
+    if (peek() == '}') {
+      position++;
+      return;
+    }
+    while (true) {
+      skipWhitespace();
+      if (peek() != '"') {
+        fail("expected a member name");
+      }
+      std::string key = parseString();
+      skipWhitespace();
+      expect(':');
+      value.members.emplace_back(std::move(key), parseValue(depth + 1));
+      skipWhitespace();
+      if (peek() == '}') {
+        position++;
+        return;
+      }
+      expect(',');
+    }
+  }
+
+  void parseArray(JsonValue &value, int depth) {
+    expect('[');
+    skipWhitespace();
+    if (peek() == ']') {
+      position++;
+      return;
+    }
+    while (true) {
+      value.elements.push_back(parseValue(depth + 1));
+      skipWhitespace();
+      if (peek() == ']') {
+        position++;
+        return;
+      }
+      expect(',');
+    }
+  }
+
+  uint32_t parseHex4() {
+    if (position + 4 > text.size()) {
+      fail("truncated escape");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = text[position++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      } else {
+        fail("invalid escape");
+      }
+    }
+    return value;
+  }
+
+  std::string parseString() {
+    expect('"');
+    std::string out;
+    while (true) {
+      if (position >= text.size()) {
+        fail("unterminated string");
+      }
+      char c = text[position++];
+      if (c == '"') {
+        return out;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        fail("control character in string");
+      }
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+
+      char escape = peek();
+      position++;
+      switch (escape) {
+      case '"':
+      case '\\':
+      case '/':
+        out += escape;
+        break;
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        uint32_t codePoint = parseHex4();
+        // a high surrogate has to be followed by its low half
+        if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+          if (!consumeLiteral("\\u")) {
+            fail("unpaired surrogate");
+          }
+          uint32_t low = parseHex4();
+          if (low < 0xDC00 || low >= 0xE000) {
+            fail("unpaired surrogate");
+          }
+          codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        } else if (codePoint >= 0xDC00 && codePoint < 0xE000) {
+          fail("unpaired surrogate");
+        }
+        appendUtf8(out, codePoint);
+        break;
+      }
+      default:
+        fail("invalid escape");
+      }
+    }
+  }
+
+  // locale independent, exact for integers and within an ulp or two of
+  // strtod otherwise
+  double parseNumber() {
+    bool negative = peek() == '-';
+    if (negative) {
+      position++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    auto digits = [&](bool fraction) {
+      while (position < text.size() && text[position] >= '0' &&
+             text[position] <= '9') {
+        // digits past what 64 bits hold only move the exponent
+        if (mantissa < UINT64_MAX / 10 - 9) {
+          mantissa = mantissa * 10 + (text[position] - '0');
+          exponent -= fraction ? 1 : 0;
+        } else {
+          exponent += fraction ? 0 : 1;
+        }
+        hasDigits = true;
+        position++;
+      }
+    };
+
+    digits(false);
+    if (peek() == '.') {
+      position++;
+      digits(true);
+    }
+    if (!hasDigits) {
+      fail("expected digits");
+    }
+
+    if (peek() == 'e' || peek() == 'E') {
+      position++;
+      bool negativeExponent = peek() == '-';
+      if (peek() == '-' || peek() == '+') {
+        position++;
+      }
+      if (peek() < '0' || peek() > '9') {
+        fail("expected exponent digits");
+      }
+      int value = 0;
+      while (peek() >= '0' && peek() <= '9') {
+        value = std::min(value * 10 + (text[position++] - '0'), 100000);
+      }
+      exponent += negativeExponent ? -value : value;
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (exponent != 0) {
+      // dividing by an exact power of ten rounds better than multiplying by
+      // an inexact negative one
+      value = exponent > 0 ? value * std::pow(10.0, exponent)
+                           : value / std::pow(10.0, -exponent);
+    }
+    return negative ? -value : value;
+  }
+
+  std::string_view text;
+  size_t position = 0;
+};
+
+JsonValue JsonValue::parse(std::string_view text) {
+  return Parser{text}.parseDocument();
+}
+
+bool JsonValue::getBool(bool fallback) const {
+  return type == Type::Bool ? boolean : fallback;
+}
+
+double JsonValue::getNumber(double fallback) const {
+  return type == Type::Number ? number : fallback;
+}
+
+int64_t JsonValue::getInteger(int64_t fallback) const {
+  if (type != Type::Number || number != std::floor(number) ||
+      std::fabs(number) > 9007199254740992.0) {
+    return fallback;
+  }
+  return static_cast<int64_t>(number);
+}
+
+size_t JsonValue::size() const {
+  return type == Type::Array    ? elements.size()
+         : type == Type::Object ? members.size()
+                                : 0;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+  return type == Type::Array && index < elements.size() ? elements[index]
+                                                        : getNull();
+}
+
+const JsonValue &JsonValue::operator[](std::string_view key) const {
+  for (const auto &member : members) {
+    if (member.first == key) {
+      return member.second;
+    }
+  }
+  return getNull();
+}
+
+bool JsonValue::contains(std::string_view key) const {
+  for (const auto &member : members) {
+    if (member.first == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace vkEngine
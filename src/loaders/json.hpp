@@ -0,0 +1,58 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vkEngine {
+
+// Just enough of a JSON document model for the glTF header. Values are
+// immutable once parsed, lookups of missing members or elements return a
+// null value so optional glTF properties read like present ones.
+class JsonValue {
+public:
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  // Throws std::runtime_error with the offset of the first malformed byte.
+  static JsonValue parse(std::string_view text);
+
+  Type getType() const { return type; }
+  bool isNull() const { return type == Type::Null; }
+  bool isNumber() const { return type == Type::Number; }
+  bool isString() const { return type == Type::String; }
+  bool isArray() const { return type == Type::Array; }
+  bool isObject() const { return type == Type::Object; }
+
+  // the fallback is returned for values of another type
+  bool getBool(bool fallback = false) const;
+  double getNumber(double fallback = 0.0) const;
+  // exact for integers up to 2^53, which covers every glTF count and offset
+  int64_t getInteger(int64_t fallback = 0) const;
+  const std::string &getString() const { return string; }
+
+  // elements of an array or members of an object, 0 for anything else
+  size_t size() const;
+  const JsonValue &operator[](size_t index) const;
+  const JsonValue &operator[](std::string_view key) const;
+  bool contains(std::string_view key) const;
+  // members in file order
+  const std::vector<std::pair<std::string, JsonValue>> &getMembers() const {
+    return members;
+  }
+
+private:
+  class Parser;
+
+  Type type = Type::Null;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string{};
+  std::vector<JsonValue> elements{};
+  std::vector<std::pair<std::string, JsonValue>> members{};
+};
+
+} // namespace vkEngine
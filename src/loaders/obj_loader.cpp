@@ -0,0 +1,299 @@
+#include "obj_loader.hpp"
+#include "mapped_file.hpp"
+#include "text_parsing.hpp"
+#include "utils.hpp"
+#include "vertex_welder.hpp"
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vkEngine {
+
+namespace {
+
+// smallest chunk worth handing to a thread
+constexpr size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+struct ObjCorner {
+  int32_t position;
+  int32_t texcoord;
+  int32_t normal;
+};
+
+struct ObjChunk {
+  const char *begin;
+  const char *end;
+
+  // attribute lines before this chunk, used to resolve relative indices
+  size_t positionBase = 0;
+  size_t texcoordBase = 0;
+  size_t normalBase = 0;
+
+  size_t positionCount = 0;
+  size_t texcoordCount = 0;
+  size_t normalCount = 0;
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> colors;
+  std::vector<glm::vec2> texcoords;
+  std::vector<glm::vec3> normals;
+  std::vector<ObjCorner> corners; // three per triangle
+  std::vector<size_t> quads;       // first corner of every split quad
+
+  std::vector<Model::Vertex> vertices;
+};
+
+bool parseInt(const char *&p, const char *end, int64_t &value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || *p < '0' || *p > '9') {
+    return false;
+  }
+  value = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    value = value * 10 + (*p++ - '0');
+  }
+  if (negative) {
+    value = -value;
+  }
+  return true;
+}
+
+// OBJ indices are 1 based, negative ones count back from the current line
+int32_t resolveIndex(int64_t index, size_t countSoFar) {
+  int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(countSoFar) + index;
+  if (index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(countSoFar)) {
+    throw std::runtime_error("OBJ face references an undefined attribute");
+  }
+  return static_cast<int32_t>(resolved);
+}
+
+void countAttributes(ObjChunk &chunk) {
+  for (const char *p = chunk.begin; p < chunk.end;) {
+    const char *end = lineEnd(p, chunk.end);
+    p = skipBlanks(p, end);
+    if (end - p > 1 && p[0] == 'v') {
+      if (isBlank(p[1])) {
+        chunk.positionCount++;
+      } else if (p[1] == 't' && end - p > 2 && isBlank(p[2])) {
+        chunk.texcoordCount++;
+      } else if (p[1] == 'n' && end - p > 2 && isBlank(p[2])) {
+        chunk.normalCount++;
+      }
+    }
+    p = end + 1;
+  }
+}
+
+void parseFace(const char *p, const char *end, ObjChunk &chunk) {
+  size_t positionsSoFar = chunk.positionBase + chunk.positions.size();
+  size_t texcoordsSoFar = chunk.texcoordBase + chunk.texcoords.size();
+  size_t normalsSoFar = chunk.normalBase + chunk.normals.size();
+
+  ObjCorner first{};
+  ObjCorner previous{};
+  size_t cornerCount = 0;
+
+  while (true) {
+    p = skipBlanks(p, end);
+    if (p == end) {
+      break;
+    }
+
+    ObjCorner corner{-1, -1, -1};
+    int64_t index;
+    if (!parseInt(p, end, index)) {
+      throw std::runtime_error("Malformed OBJ face");
+    }
+    corner.position = resolveIndex(index, positionsSoFar);
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        if (!parseInt(p, end, index)) {
+          throw std::runtime_error("Malformed OBJ face");
+        }
+        corner.texcoord = resolveIndex(index, texcoordsSoFar);
+      }
+      if (p < end && *p == '/') {
+        p++;
+        if (!parseInt(p, end, index)) {
+          throw std::runtime_error("Malformed OBJ face");
+        }
+        corner.normal = resolveIndex(index, normalsSoFar);
+      }
+    }
+
+    if (cornerCount == 0) {
+      first = corner;
+      chunk.quads.push_back(chunk.corners.size());
+    } else if (cornerCount >= 2) {
+      chunk.corners.push_back(first);
+      chunk.corners.push_back(previous);
+      chunk.corners.push_back(corner);
+    }
+    previous = corner;
+    cornerCount++;
+  }
+
+  if (cornerCount != 4) {
+    chunk.quads.pop_back();
+  }
+}
+
+// Quads get split along their shortest diagonal, like tinyobj does. This can
+// only be decided once every chunk has been parsed and the positions merged.
+void splitQuads(ObjChunk &chunk, const std::vector<glm::vec3> &positions) {
+  for (size_t first : chunk.quads) {
+    ObjCorner *corners = &chunk.corners[first];
+    ObjCorner quad[4] = {corners[0], corners[1], corners[2], corners[5]};
+    glm::vec3 diagonal02 = positions[quad[2].position] - positions[quad[0].position];
+    glm::vec3 diagonal13 = positions[quad[3].position] - positions[quad[1].position];
+    if (glm::dot(diagonal02, diagonal02) >= glm::dot(diagonal13, diagonal13)) {
+      corners[0] = quad[0];
+      corners[1] = quad[1];
+      corners[2] = quad[3];
+      corners[3] = quad[1];
+      corners[4] = quad[2];
+      corners[5] = quad[3];
+    }
+  }
+}
+
+void parseChunk(ObjChunk &chunk) {
+  chunk.positions.reserve(chunk.positionCount);
+  chunk.colors.reserve(chunk.positionCount);
+  chunk.texcoords.reserve(chunk.texcoordCount);
+  chunk.normals.reserve(chunk.normalCount);
+
+  for (const char *p = chunk.begin; p < chunk.end;) {
+    const char *end = lineEnd(p, chunk.end);
+    p = skipBlanks(p, end);
+
+    if (end - p > 1 && p[0] == 'v' && isBlank(p[1])) {
+      p += 1;
+      glm::vec3 position;
+      if (!parseFloat(p, end, position.x) || !parseFloat(p, end, position.y) ||
+          !parseFloat(p, end, position.z)) {
+        throw std::runtime_error("Malformed OBJ vertex");
+      }
+      // optional per vertex color extension, white otherwise like tinyobj
+      glm::vec3 color{1.f};
+      if (parseFloat(p, end, color.x) &&
+          !(parseFloat(p, end, color.y) && parseFloat(p, end, color.z))) {
+        color = glm::vec3{1.f};
+      }
+      chunk.positions.push_back(position);
+      chunk.colors.push_back(color);
+    } else if (end - p > 2 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+      p += 2;
+      glm::vec2 texcoord;
+      if (!parseFloat(p, end, texcoord.x)) {
+        throw std::runtime_error("Malformed OBJ texture coordinate");
+      }
+      if (!parseFloat(p, end, texcoord.y)) {
+        texcoord.y = 0.f;
+      }
+      chunk.texcoords.push_back(texcoord);
+    } else if (end - p > 2 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+      p += 2;
+      glm::vec3 normal;
+      if (!parseFloat(p, end, normal.x) || !parseFloat(p, end, normal.y) ||
+          !parseFloat(p, end, normal.z)) {
+        throw std::runtime_error("Malformed OBJ normal");
+      }
+      chunk.normals.push_back(normal);
+    } else if (end - p > 1 && p[0] == 'f' && isBlank(p[1])) {
+      parseFace(p + 1, end, chunk);
+    }
+
+    p = end + 1;
+  }
+}
+
+} // namespace
+
+void loadObjParallel(const std::string &filepath, Model::Builder &builder) {
+  // each chunk is read front to back, parsing straight out of the page cache
+  MappedFile data{filepath, MappedFile::Access::Sequential};
+  size_t fileSize = data.size();
+
+  // split into line aligned chunks, one per worker at most
+  size_t chunkCount = std::max<size_t>(
+      1, std::min(workerCount(), fileSize / OBJ_MIN_CHUNK_SIZE));
+  std::vector<ObjChunk> chunks(chunkCount);
+  const char *begin = data.data();
+  const char *end = data.data() + fileSize;
+  for (size_t i = 0; i < chunkCount; i++) {
+    const char *chunkEnd =
+        i + 1 == chunkCount ? end : begin + fileSize * (i + 1) / chunkCount;
+    chunkEnd = chunkEnd < end ? lineEnd(chunkEnd, end) : end;
+    chunks[i].begin = i == 0 ? begin : chunks[i - 1].end;
+    chunks[i].end = std::max(chunkEnd, chunks[i].begin);
+  }
+
+  parallelFor(chunkCount, [&](size_t i) { countAttributes(chunks[i]); });
+  for (size_t i = 1; i < chunkCount; i++) {
+    chunks[i].positionBase = chunks[i - 1].positionBase + chunks[i - 1].positionCount;
+    chunks[i].texcoordBase = chunks[i - 1].texcoordBase + chunks[i - 1].texcoordCount;
+    chunks[i].normalBase = chunks[i - 1].normalBase + chunks[i - 1].normalCount;
+  }
+
+  parallelFor(chunkCount, [&](size_t i) { parseChunk(chunks[i]); });
+
+  // merge the attribute streams, faces may point into any chunk
+  const ObjChunk &last = chunks.back();
+  std::vector<glm::vec3> positions(last.positionBase + last.positionCount);
+  std::vector<glm::vec3> colors(positions.size());
+  std::vector<glm::vec2> texcoords(last.texcoordBase + last.texcoordCount);
+  std::vector<glm::vec3> normals(last.normalBase + last.normalCount);
+  parallelFor(chunkCount, [&](size_t i) {
+    const ObjChunk &chunk = chunks[i];
+    std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+    std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + chunk.positionBase);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+  });
+
+  parallelFor(chunkCount, [&](size_t i) {
+    ObjChunk &chunk = chunks[i];
+    splitQuads(chunk, positions);
+    chunk.vertices.resize(chunk.corners.size());
+    for (size_t c = 0; c < chunk.corners.size(); c++) {
+      const ObjCorner &corner = chunk.corners[c];
+      Model::Vertex &vertex = chunk.vertices[c];
+      vertex.position = positions[corner.position];
+      vertex.color = colors[corner.position];
+      if (corner.normal >= 0) {
+        vertex.normal = normals[corner.normal];
+      }
+      if (corner.texcoord >= 0) {
+        vertex.uv = texcoords[corner.texcoord];
+      }
+    }
+  });
+
+  builder.vertices.clear();
+  builder.indices.clear();
+
+  size_t cornerCount = 0;
+  for (const auto &chunk : chunks) {
+    cornerCount += chunk.vertices.size();
+  }
+  builder.indices.reserve(cornerCount);
+
+  VertexWelder welder{builder.vertices, 0.f, positions.size()};
+  for (const auto &chunk : chunks) {
+    for (const auto &vertex : chunk.vertices) {
+      builder.indices.push_back(welder.weld(vertex));
+    }
+  }
+}
+
+} // namespace vkEngine
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "model.hpp"
+
+// std
+#include <string>
+
+namespace vkEngine {
+
+// Parses a Wavefront OBJ file on all cores.
+//
+// The file is split into line aligned chunks. A first pass counts the
+// attribute lines of every chunk so relative (negative) face indices can be
+// resolved while the chunks are parsed in parallel. Polygons are fan
+// triangulated, materials and groups are ignored just like the tinyobj path.
+void loadObjParallel(const std::string &filepath, Model::Builder &builder);
+
+} // namespace vkEngine
@@ -0,0 +1,386 @@
+#include "ply_loader.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace vkEngine {
+
+namespace {
+
+[[noreturn]] void fail(const std::string &what) {
+  throw std::runtime_error("Malformed PLY file, " + what);
+}
+
+size_t getTypeSize(PlyFile::Type type) {
+  switch (type) {
+  case PlyFile::Type::Int8:
+  case PlyFile::Type::UInt8:
+    return 1;
+  case PlyFile::Type::Int16:
+  case PlyFile::Type::UInt16:
+    return 2;
+  case PlyFile::Type::Int32:
+  case PlyFile::Type::UInt32:
+  case PlyFile::Type::Float32:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+PlyFile::Type parseType(const std::string &name) {
+  static const std::pair<const char *, PlyFile::Type> names[] = {
+      {"char", PlyFile::Type::Int8},      {"int8", PlyFile::Type::Int8},
+      {"uchar", PlyFile::Type::UInt8},    {"uint8", PlyFile::Type::UInt8},
+      {"short", PlyFile::Type::Int16},    {"int16", PlyFile::Type::Int16},
+      {"ushort", PlyFile::Type::UInt16},  {"uint16", PlyFile::Type::UInt16},
+      {"int", PlyFile::Type::Int32},      {"int32", PlyFile::Type::Int32},
+      {"uint", PlyFile::Type::UInt32},    {"uint32", PlyFile::Type::UInt32},
+      {"float", PlyFile::Type::Float32},  {"float32", PlyFile::Type::Float32},
+      {"double", PlyFile::Type::Float64}, {"float64", PlyFile::Type::Float64},
+  };
+  for (const auto &entry : names) {
+    if (name == entry.first) {
+      return entry.second;
+    }
+  }
+  fail("unknown property type " + name);
+}
+
+template <typename T> T load(const char *p, bool swap) {
+  char bytes[sizeof(T)];
+  if (swap) {
+    std::reverse_copy(p, p + sizeof(T), bytes);
+  } else {
+    std::memcpy(bytes, p, sizeof(T));
+  }
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+uint32_t toUnorm8(double value, PlyFile::Type type) {
+  switch (type) {
+  case PlyFile::Type::Float32:
+  case PlyFile::Type::Float64:
+    value *= 255.0;
+    break;
+  case PlyFile::Type::UInt16:
+    value /= 257.0;
+    break;
+  default:
+    break;
+  }
+  return static_cast<uint32_t>(std::clamp(value + .5, 0.0, 255.0));
+}
+
+} // namespace
+
+PlyFile::PlyFile(const std::string &filepath) : file{filepath} {
+  parseHeader();
+}
+
+void PlyFile::parseHeader() {
+  std::string_view text = file.view();
+  size_t headerEnd = text.find("end_header");
+  if (text.substr(0, 3) != "ply" || headerEnd == std::string_view::npos) {
+    fail("no PLY header");
+  }
+  size_t bodyStart = text.find('\n', headerEnd);
+  if (bodyStart == std::string_view::npos) {
+    fail("no data after the header");
+  }
+  body = file.data() + bodyStart + 1;
+
+  std::istringstream header{std::string{text.substr(0, headerEnd)}};
+  std::string line;
+  bool hasFormat = false;
+  while (std::getline(header, line)) {
+    std::istringstream words{line};
+    std::string keyword;
+    words >> keyword;
+    if (keyword == "format") {
+      std::string format;
+      words >> format;
+      if (format == "ascii") {
+        fail("only binary PLY is supported");
+      }
+      if (format != "binary_little_endian" && format != "binary_big_endian") {
+        fail("unknown format " + format);
+      }
+      bigEndian = format == "binary_big_endian";
+      hasFormat = true;
+    } else if (keyword == "element") {
+      Element element{};
+      if (!(words >> element.name >> element.count)) {
+        fail("invalid element");
+      }
+      elements.push_back(std::move(element));
+    } else if (keyword == "property") {
+      if (elements.empty()) {
+        fail("property outside of an element");
+      }
+      Property property{};
+      std::string type;
+      words >> type;
+      if (type == "list") {
+        std::string countType;
+        words >> countType >> type;
+        property.isList = true;
+        property.countType = parseType(countType);
+      }
+      property.type = parseType(type);
+      if (!(words >> property.name)) {
+        fail("invalid property");
+      }
+      elements.back().properties.push_back(std::move(property));
+    }
+  }
+  if (!hasFormat) {
+    fail("no format");
+  }
+
+  // everything before the vertices is walked once to find them
+  const char *p = body;
+  const Element *vertices = nullptr;
+  for (const Element &element : elements) {
+    if (element.name == "vertex") {
+      vertices = &element;
+      break;
+    }
+    p = skipElement(p, element);
+  }
+  if (!vertices) {
+    fail("no vertex element");
+  }
+
+  auto bind = [](Field &field, const Property &property, size_t offset,
+                 std::initializer_list<const char *> names) {
+    for (const char *name : names) {
+      if (property.name == name && !field.present) {
+        field = {true, property.type, offset};
+      }
+    }
+  };
+  for (const Property &property : vertices->properties) {
+    if (property.isList) {
+      fail("vertices with list properties are not supported");
+    }
+    bind(position[0], property, vertexSize, {"x"});
+    bind(position[1], property, vertexSize, {"y"});
+    bind(position[2], property, vertexSize, {"z"});
+    bind(normal[0], property, vertexSize, {"nx"});
+    bind(normal[1], property, vertexSize, {"ny"});
+    bind(normal[2], property, vertexSize, {"nz"});
+    bind(uv[0], property, vertexSize, {"u", "s", "texture_u", "texture_s"});
+    bind(uv[1], property, vertexSize, {"v", "t", "texture_v", "texture_t"});
+    bind(color[0], property, vertexSize, {"red", "r", "diffuse_red"});
+    bind(color[1], property, vertexSize, {"green", "g", "diffuse_green"});
+    bind(color[2], property, vertexSize, {"blue", "b", "diffuse_blue"});
+    bind(color[3], property, vertexSize, {"alpha", "a"});
+    vertexSize += getTypeSize(property.type);
+  }
+  if (!position[0].present || !position[1].present || !position[2].present) {
+    fail("vertices without x, y and z");
+  }
+  // partial triples are ignored
+  if (!normal[1].present || !normal[2].present) {
+    normal[0].present = false;
+  }
+  if (!uv[1].present) {
+    uv[0].present = false;
+  }
+  if (!color[1].present || !color[2].present) {
+    color[0].present = false;
+  }
+
+  size_t available = static_cast<size_t>(file.data() + file.size() - p);
+  if (vertexSize == 0 || vertices->count > available / vertexSize) {
+    fail("truncated vertices");
+  }
+  vertexData = p;
+  vertexCount = vertices->count;
+}
+
+double PlyFile::read(const char *p, Type type) const {
+  switch (type) {
+  case Type::Int8:
+    return static_cast<int8_t>(*p);
+  case Type::UInt8:
+    return static_cast<uint8_t>(*p);
+  case Type::Int16:
+    return load<int16_t>(p, bigEndian);
+  case Type::UInt16:
+    return load<uint16_t>(p, bigEndian);
+  case Type::Int32:
+    return load<int32_t>(p, bigEndian);
+  case Type::UInt32:
+    return load<uint32_t>(p, bigEndian);
+  case Type::Float32:
+    return load<float>(p, bigEndian);
+  default:
+    return load<double>(p, bigEndian);
+  }
+}
+
+const char *PlyFile::skipElement(const char *p, const Element &element) const {
+  const char *end = file.data() + file.size();
+  size_t fixedSize = 0;
+  bool hasLists = false;
+  for (const Property &property : element.properties) {
+    hasLists |= property.isList;
+    fixedSize += getTypeSize(property.type);
+  }
+  if (!hasLists) {
+    if (fixedSize > 0 &&
+        element.count > static_cast<size_t>(end - p) / fixedSize) {
+      fail("truncated " + element.name + " element");
+    }
+    return p + element.count * fixedSize;
+  }
+
+  for (size_t i = 0; i < element.count; i++) {
+    for (const Property &property : element.properties) {
+      size_t size = getTypeSize(property.isList ? property.countType
+                                                : property.type);
+      if (size > static_cast<size_t>(end - p)) {
+        fail("truncated " + element.name + " element");
+      }
+      if (!property.isList) {
+        p += size;
+        continue;
+      }
+      double count = read(p, property.countType);
+      p += size;
+      size_t itemSize = getTypeSize(property.type);
+      if (count < 0 || count > static_cast<double>(end - p) / itemSize) {
+        fail("truncated " + element.name + " element");
+      }
+      p += static_cast<size_t>(count) * itemSize;
+    }
+  }
+  return p;
+}
+
+glm::vec3 PlyFile::readPosition(size_t vertex) const {
+  return {read(vertex, position[0]), read(vertex, position[1]),
+          read(vertex, position[2])};
+}
+
+glm::vec3 PlyFile::readNormal(size_t vertex) const {
+  if (!normal[0].present) {
+    return glm::vec3{0.f};
+  }
+  return {read(vertex, normal[0]), read(vertex, normal[1]),
+          read(vertex, normal[2])};
+}
+
+glm::vec2 PlyFile::readUv(size_t vertex) const {
+  if (!uv[0].present) {
+    return glm::vec2{0.f};
+  }
+  return {read(vertex, uv[0]), read(vertex, uv[1])};
+}
+
+uint32_t PlyFile::readColor(size_t vertex) const {
+  if (!color[0].present) {
+    return 0xFFFFFFFFu;
+  }
+  uint32_t rgba = 0;
+  for (int c = 0; c < 3; c++) {
+    rgba |= toUnorm8(read(vertex, color[c]), color[c].type) << (8 * c);
+  }
+  rgba |= (color[3].present ? toUnorm8(read(vertex, color[3]), color[3].type)
+                            : 255u)
+          << 24;
+  return rgba;
+}
+
+std::vector<uint32_t> PlyFile::readFaces() const {
+  std::vector<uint32_t> indices;
+  const char *end = file.data() + file.size();
+  const char *p = body;
+  for (const Element &element : elements) {
+    if (element.name != "face") {
+      p = skipElement(p, element);
+      continue;
+    }
+
+    indices.reserve(element.count * 3);
+    std::vector<uint32_t> polygon;
+    for (size_t i = 0; i < element.count; i++) {
+      for (const Property &property : element.properties) {
+        size_t size = getTypeSize(property.isList ? property.countType
+                                                  : property.type);
+        if (size > static_cast<size_t>(end - p)) {
+          fail("truncated faces");
+        }
+        if (!property.isList) {
+          p += size;
+          continue;
+        }
+        double count = read(p, property.countType);
+        p += size;
+        size_t itemSize = getTypeSize(property.type);
+        if (count < 0 || count > static_cast<double>(end - p) / itemSize) {
+          fail("truncated faces");
+        }
+        size_t cornerCount = static_cast<size_t>(count);
+        if (property.name != "vertex_indices" &&
+            property.name != "vertex_index") {
+          p += cornerCount * itemSize;
+          continue;
+        }
+
+        polygon.clear();
+        for (size_t corner = 0; corner < cornerCount; corner++) {
+          double index = read(p, property.type);
+          p += itemSize;
+          if (index < 0 || index >= static_cast<double>(vertexCount)) {
+            fail("face references an undefined vertex");
+          }
+          polygon.push_back(static_cast<uint32_t>(index));
+        }
+        for (size_t corner = 2; corner < polygon.size(); corner++) {
+          indices.push_back(polygon[0]);
+          indices.push_back(polygon[corner - 1]);
+          indices.push_back(polygon[corner]);
+        }
+      }
+    }
+    break;
+  }
+  return indices;
+}
+
+void loadPly(const std::string &filepath, Model::Builder &builder) {
+  PlyFile ply{filepath};
+  if (ply.getVertexCount() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("PLY file has too many vertices for a mesh");
+  }
+  builder.indices = ply.readFaces();
+  if (builder.indices.empty()) {
+    throw std::runtime_error(
+        "PLY file has no faces, it can only be loaded as a point cloud");
+  }
+
+  builder.vertices.resize(ply.getVertexCount());
+  for (size_t i = 0; i < builder.vertices.size(); i++) {
+    Model::Vertex &vertex = builder.vertices[i];
+    vertex.position = ply.readPosition(i);
+    vertex.normal = ply.readNormal(i);
+    vertex.uv = ply.readUv(i);
+    uint32_t color = ply.readColor(i);
+    vertex.color = {static_cast<float>(color & 0xFF) / 255.f,
+                    static_cast<float>((color >> 8) & 0xFF) / 255.f,
+                    static_cast<float>((color >> 16) & 0xFF) / 255.f};
+  }
+}
+
+} // namespace vkEngine
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "model.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vkEngine {
+
+// A binary (little or big endian) PLY file read in place from its mapping.
+//
+// The vertex element has to be of fixed size, so vertex i is found without
+// walking the file and huge scans can be converted on all cores. Elements
+// with list properties, like faces, are walked front to back.
+class PlyFile {
+public:
+  enum class Type : uint8_t {
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64,
+  };
+
+  struct Property {
+    std::string name;
+    Type type;
+    // list properties store a count of countType, then count values
+    bool isList = false;
+    Type countType = Type::UInt8;
+  };
+
+  struct Element {
+    std::string name;
+    size_t count;
+    std::vector<Property> properties;
+  };
+
+  explicit PlyFile(const std::string &filepath);
+
+  PlyFile(const PlyFile &) = delete;
+  PlyFile &operator=(const PlyFile &) = delete;
+
+  size_t getVertexCount() const { return vertexCount; }
+  size_t getFileSize() const { return file.size(); }
+  bool hasNormals() const { return normal[0].present; }
+  bool hasColors() const { return color[0].present; }
+  bool hasUvs() const { return uv[0].present; }
+
+  glm::vec3 readPosition(size_t vertex) const;
+  glm::vec3 readNormal(size_t vertex) const;
+  glm::vec2 readUv(size_t vertex) const;
+  // RGBA unorm8, red in the lowest byte. Opaque white without colors.
+  uint32_t readColor(size_t vertex) const;
+
+  // Fan triangulated faces of the "face" element, empty without one.
+  std::vector<uint32_t> readFaces() const;
+
+private:
+  struct Field {
+    bool present = false;
+    Type type = Type::Float32;
+    size_t offset = 0;
+  };
+
+  void parseHeader();
+  double read(const char *p, Type type) const;
+  float read(size_t vertex, const Field &field) const {
+    return static_cast<float>(
+        read(vertexData + vertex * vertexSize + field.offset, field.type));
+  }
+  // start of the next element, walking count instances of element from p
+  const char *skipElement(const char *p, const Element &element) const;
+
+  MappedFile file;
+  bool bigEndian = false;
+  std::vector<Element> elements;
+  // where the binary data starts, after end_header
+  const char *body = nullptr;
+
+  const char *vertexData = nullptr;
+  size_t vertexCount = 0;
+  size_t vertexSize = 0;
+  Field position[3];
+  Field normal[3];
+  Field uv[2];
+  Field color[4];
+};
+
+// Loads the vertices and faces of a binary PLY mesh into the builder. Vertex
+// normals, uvs and colors are read when present, polygons are fan
+// triangulated. A file without faces is a point cloud, see PointCloud.
+void loadPly(const std::string &filepath, Model::Builder &builder);
+
+} // namespace vkEngine
@@ -0,0 +1,204 @@
+#include "stl_loader.hpp"
+#include "mapped_file.hpp"
+#include "text_parsing.hpp"
+#include "vertex_welder.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vkEngine {
+
+namespace {
+
+constexpr size_t STL_HEADER_SIZE = 80;
+constexpr size_t STL_RECORD_SIZE = 50; // normal, 3 corners, attribute word
+
+// Welds facet corners on their exact position (and color) as they are
+// streamed in. Normals are accumulated on the side so they do not take part
+// in the welding.
+class StlWelder {
+public:
+  explicit StlWelder(Model::Builder &builder)
+      : builder{builder}, welder{builder.vertices} {}
+
+  void addFacet(const glm::vec3 &facetNormal, std::array<glm::vec3, 3> corners,
+                const glm::vec3 *color) {
+    glm::vec3 areaNormal =
+        glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+    // keep the winding consistent with the normal stored in the file
+    if (glm::dot(areaNormal, facetNormal) < 0.f) {
+      std::swap(corners[1], corners[2]);
+      areaNormal = -areaNormal;
+    }
+
+    uint32_t a = weld(corners[0], areaNormal, color);
+    uint32_t b = weld(corners[1], areaNormal, color);
+    uint32_t c = weld(corners[2], areaNormal, color);
+    if (a == b || b == c || a == c) {
+      return; // degenerate after welding, nothing to rasterize
+    }
+    builder.indices.push_back(a);
+    builder.indices.push_back(b);
+    builder.indices.push_back(c);
+  }
+
+  void finish() {
+    for (size_t i = 0; i < builder.vertices.size(); i++) {
+      float length = glm::length(normalSums[i]);
+      if (length > 0.f) {
+        builder.vertices[i].normal = normalSums[i] / length;
+      }
+    }
+  }
+
+private:
+  uint32_t weld(const glm::vec3 &position, const glm::vec3 &areaNormal,
+                const glm::vec3 *color) {
+    Model::Vertex vertex{};
+    vertex.position = position;
+    vertex.color = color ? *color : glm::vec3{1.f};
+
+    uint32_t index = welder.weld(vertex);
+    if (index == normalSums.size()) {
+      normalSums.emplace_back(0.f);
+    }
+    // unnormalized cross product, so larger facets weigh more
+    normalSums[index] += areaNormal;
+    return index;
+  }
+
+  Model::Builder &builder;
+  VertexWelder welder;
+  std::vector<glm::vec3> normalSums{};
+};
+
+// STL is little endian, as are all platforms we build for
+float readFloat(const char *data) {
+  float value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+glm::vec3 readVec3(const char *data) {
+  return {readFloat(data), readFloat(data + 4), readFloat(data + 8)};
+}
+
+// VisCAM/SolidView convention: 5 bits per channel (BGR from the low bits),
+// bit 15 marks the color as valid.
+bool decodeColor(uint16_t attribute, glm::vec3 &color) {
+  if ((attribute & 0x8000) == 0) {
+    return false;
+  }
+  color = {
+      static_cast<float>((attribute >> 10) & 0x1f) / 31.f,
+      static_cast<float>((attribute >> 5) & 0x1f) / 31.f,
+      static_cast<float>(attribute & 0x1f) / 31.f,
+  };
+  return true;
+}
+
+// records are read in place from the mapping, the caller checked the size
+void loadBinaryStl(const char *records, uint32_t triangleCount,
+                   StlWelder &welder) {
+  for (size_t i = 0; i < triangleCount; i++) {
+    const char *record = records + i * STL_RECORD_SIZE;
+    uint16_t attribute;
+    std::memcpy(&attribute, record + 48, sizeof(attribute));
+
+    glm::vec3 color;
+    bool hasColor = decodeColor(attribute, color);
+    welder.addFacet(readVec3(record),
+                    {readVec3(record + 12), readVec3(record + 24),
+                     readVec3(record + 36)},
+                    hasColor ? &color : nullptr);
+  }
+}
+
+// ASCII STL separates its tokens by any whitespace, line breaks included
+bool isStlSpace(char c) { return isBlank(c) || c == '\n'; }
+
+std::string_view nextToken(const char *&p, const char *end) {
+  while (p < end && isStlSpace(*p)) {
+    p++;
+  }
+  const char *start = p;
+  while (p < end && !isStlSpace(*p)) {
+    p++;
+  }
+  return {start, static_cast<size_t>(p - start)};
+}
+
+void parseVec3(const char *&p, const char *end, glm::vec3 &value) {
+  for (int i = 0; i < 3; i++) {
+    std::string_view token = nextToken(p, end);
+    const char *number = token.data();
+    const char *numberEnd = token.data() + token.size();
+    if (!parseFloat(number, numberEnd, value[i]) || number != numberEnd) {
+      throw std::runtime_error("Malformed ASCII STL file");
+    }
+  }
+}
+
+void loadAsciiStl(const char *p, const char *end, StlWelder &welder) {
+  glm::vec3 normal{};
+  std::array<glm::vec3, 3> corners{};
+  size_t cornerCount = 0;
+
+  for (std::string_view token = nextToken(p, end); !token.empty();
+       token = nextToken(p, end)) {
+    if (token == "normal") {
+      parseVec3(p, end, normal);
+    } else if (token == "vertex") {
+      if (cornerCount == corners.size()) {
+        throw std::runtime_error("STL facet with more than 3 vertices");
+      }
+      parseVec3(p, end, corners[cornerCount++]);
+    } else if (token == "endfacet") {
+      if (cornerCount == corners.size()) {
+        welder.addFacet(normal, corners, nullptr);
+      }
+      cornerCount = 0;
+    }
+  }
+}
+
+} // namespace
+
+void loadStl(const std::string &filepath, Model::Builder &builder) {
+  MappedFile file{filepath, MappedFile::Access::Sequential};
+  const char *data = file.data();
+  size_t fileSize = file.size();
+
+  constexpr size_t headerSize = STL_HEADER_SIZE + sizeof(uint32_t);
+  uint32_t triangleCount = 0;
+  if (fileSize >= headerSize) {
+    std::memcpy(&triangleCount, data + STL_HEADER_SIZE, sizeof(triangleCount));
+  }
+
+  builder.vertices.clear();
+  builder.indices.clear();
+  StlWelder welder{builder};
+
+  // binary files may also start with "solid", so trust the size check first
+  if (fileSize >= headerSize &&
+      fileSize == headerSize + uint64_t{triangleCount} * STL_RECORD_SIZE) {
+    loadBinaryStl(data + headerSize, triangleCount, welder);
+  } else if (file.view().substr(0, 5) == "solid") {
+    loadAsciiStl(data, data + fileSize, welder);
+  } else {
+    throw std::runtime_error("Not a valid STL file: " + filepath);
+  }
+
+  welder.finish();
+}
+
+} // namespace vkEngine
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "model.hpp"
+
+// std
+#include <string>
+
+namespace vkEngine {
+
+// Streams a binary or ASCII STL file into the builder.
+//
+// STL stores three unshared corners per facet, so corners are welded on their
+// exact position while streaming and the builder receives indexed geometry.
+// Welded vertices get an area weighted smooth normal accumulated from the
+// facets that share them.
+void loadStl(const std::string &filepath, Model::Builder &builder);
+
+} // namespace vkEngine
@@ -0,0 +1,85 @@
+#pragma once
+
+// std
+#include <cmath>
+#include <cstring>
+
+namespace vkEngine {
+
+// Helpers for text formats parsed straight out of a mapped file. They work on
+// [p, end) ranges, which are not null terminated.
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+inline const char *lineEnd(const char *p, const char *end) {
+  const char *newline =
+      static_cast<const char *>(std::memchr(p, '\n', end - p));
+  return newline ? newline : end;
+}
+
+// Locale independent float parser, a lot faster than strtof on OBJ data.
+inline bool parseFloat(const char *&p, const char *end, float &value) {
+  p = skipBlanks(p, end);
+  const char *start = p;
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  double mantissa = 0.0;
+  bool hasDigits = false;
+  while (p < end && *p >= '0' && *p <= '9') {
+    mantissa = mantissa * 10.0 + (*p++ - '0');
+    hasDigits = true;
+  }
+
+  int exponent = 0;
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10.0 + (*p++ - '0');
+      exponent--;
+      hasDigits = true;
+    }
+  }
+
+  if (!hasDigits) {
+    p = start;
+    return false;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *exponentStart = p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negativeExponent = *p == '-';
+      p++;
+    }
+    if (p < end && *p >= '0' && *p <= '9') {
+      int explicitExponent = 0;
+      while (p < end && *p >= '0' && *p <= '9') {
+        explicitExponent = explicitExponent * 10 + (*p++ - '0');
+      }
+      exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    } else {
+      p = exponentStart;
+    }
+  }
+
+  // dividing keeps short decimal fractions exact more often than multiplying
+  double result = exponent < 0 ? mantissa / std::pow(10.0, -exponent)
+                               : mantissa * std::pow(10.0, exponent);
+  value = static_cast<float>(negative ? -result : result);
+  return true;
+}
+
+} // namespace vkEngine
@@ -1,12 +1,27 @@
 #include "app.hpp"
 #include <exception>
 
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
-int main() {
-    vkEngine::App app{};
+// frames rendered by --benchmark without a count
+static constexpr uint32_t DEFAULT_BENCHMARK_FRAMES = 1000;
+
+int main(int argc, char **argv) {
+    // --benchmark [frames] times the scene instead of running it interactively
+    uint32_t benchmarkFrames = 0;
+    if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0) {
+        benchmarkFrames = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : DEFAULT_BENCHMARK_FRAMES;
+        if (benchmarkFrames == 0) {
+            std::cerr << "usage: " << argv[0] << " [--benchmark [frames]]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    vkEngine::App app{benchmarkFrames};
 
     try {
         app.run();
@@ -16,4 +31,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
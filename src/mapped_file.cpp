@@ -0,0 +1,109 @@
+#include "mapped_file.hpp"
+
+// std
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vkEngine {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &filepath, Access access) {
+  DWORD flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN
+                                             : FILE_ATTRIBUTE_NORMAL;
+  fileHandle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                           nullptr, OPEN_EXISTING, flags, nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    fileHandle = nullptr;
+    throw std::runtime_error("Failed to open file: " + filepath);
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(fileHandle, &size)) {
+    CloseHandle(fileHandle);
+    throw std::runtime_error("Failed to stat file: " + filepath);
+  }
+  fileSize = static_cast<size_t>(size.QuadPart);
+  if (fileSize == 0) {
+    return; // empty files cannot be mapped
+  }
+
+  mappingHandle =
+      CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle != nullptr) {
+    mapped = static_cast<const char *>(
+        MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (mapped == nullptr) {
+    if (mappingHandle != nullptr) {
+      CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+    throw std::runtime_error("Failed to map file: " + filepath);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (mapped != nullptr) {
+    UnmapViewOfFile(mapped);
+  }
+  if (mappingHandle != nullptr) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle != nullptr) {
+    CloseHandle(fileHandle);
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filepath, Access access) {
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + filepath);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    throw std::runtime_error("Failed to stat file: " + filepath);
+  }
+  fileSize = static_cast<size_t>(info.st_size);
+  if (fileSize == 0) {
+    close(fd);
+    return; // empty files cannot be mapped
+  }
+
+  void *address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw std::runtime_error("Failed to map file: " + filepath);
+  }
+  mapped = static_cast<const char *>(address);
+
+  // only a hint, the mapping works the same if it is ignored
+  if (access == Access::Sequential) {
+    madvise(address, fileSize, MADV_SEQUENTIAL);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (mapped != nullptr) {
+    munmap(const_cast<char *>(mapped), fileSize);
+  }
+}
+
+#endif
+
+} // namespace vkEngine
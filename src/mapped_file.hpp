@@ -0,0 +1,43 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace vkEngine {
+
+// Read only memory mapping of a whole file. The pages are faulted in by the
+// OS on first touch, so nothing is copied until the data is actually read.
+class MappedFile {
+public:
+  // How the mapping is going to be read, passed on to the OS read ahead.
+  enum class Access {
+    Normal,
+    // front to back, e.g. by a parser. Pages ahead are read early and pages
+    // behind may be dropped first.
+    Sequential,
+  };
+
+  explicit MappedFile(const std::string &filepath,
+                      Access access = Access::Normal);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return mapped; }
+  size_t size() const { return fileSize; }
+  std::string_view view() const { return {mapped, fileSize}; }
+
+private:
+  const char *mapped = nullptr;
+  size_t fileSize = 0;
+
+#ifdef _WIN32
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+#endif
+};
+
+} // namespace vkEngine
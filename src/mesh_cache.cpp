@@ -0,0 +1,570 @@
+#include "mesh_cache.hpp"
+#include "loaders/gltf_loader.hpp"
+#include "mesh_codec.hpp"
+#include "utils.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace vkEngine {
+
+namespace {
+
+constexpr char MESH_CACHE_MAGIC[8] = {'V', 'K', 'M', 'E', 'S', 'H', 0, 0};
+
+uint64_t alignUp(uint64_t offset) {
+  return (offset + MeshCache::MESH_CACHE_ALIGNMENT - 1) &
+         ~(MeshCache::MESH_CACHE_ALIGNMENT - 1);
+}
+
+bool readHeader(const std::string &filepath, MeshCacheHeader &header) {
+  std::ifstream file{filepath, std::ios::binary};
+  return file && file.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+         std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) ==
+             0 &&
+         header.version == MeshCache::VERSION;
+}
+
+// whether [first, first + count) lies within [0, size), without overflowing
+bool inRange(uint64_t first, uint64_t count, uint64_t size) {
+  return first <= size && count <= size - first;
+}
+
+template <typename Index>
+bool indicesInRange(const void *indices, uint32_t indexCount,
+                    uint32_t vertexCount) {
+  const Index *begin = static_cast<const Index *>(indices);
+  Index maxIndex = 0;
+  for (const Index *index = begin; index != begin + indexCount; index++) {
+    maxIndex = std::max(maxIndex, *index);
+  }
+  return indexCount == 0 || maxIndex < vertexCount;
+}
+
+// The upload and the draws trust the cooked ranges, so every index, meshlet,
+// LOD and sub-mesh has to stay within the arrays it refers to.
+bool hasValidRanges(const Model::MeshData &data) {
+  bool validIndices =
+      data.indexType == VK_INDEX_TYPE_UINT16
+          ? indicesInRange<uint16_t>(data.indices, data.indexCount,
+                                     data.vertexCount)
+          : indicesInRange<uint32_t>(data.indices, data.indexCount,
+                                     data.vertexCount);
+  if (!validIndices) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < data.meshletCount; i++) {
+    const Meshlet &meshlet = data.meshlets[i];
+    if (meshlet.vertexCount > MAX_MESHLET_VERTICES ||
+        meshlet.triangleCount > MAX_MESHLET_TRIANGLES ||
+        !inRange(meshlet.vertexOffset, meshlet.vertexCount,
+                 data.meshletVertexCount) ||
+        !inRange(meshlet.triangleOffset, uint64_t{meshlet.triangleCount} * 3,
+                 data.meshletTriangleBytes)) {
+      return false;
+    }
+    const uint8_t *triangles = data.meshletTriangles + meshlet.triangleOffset;
+    for (uint32_t j = 0; j < meshlet.triangleCount * 3; j++) {
+      if (triangles[j] >= meshlet.vertexCount) {
+        return false;
+      }
+    }
+  }
+  for (uint32_t i = 0; i < data.meshletVertexCount; i++) {
+    if (data.meshletVertices[i] >= data.vertexCount) {
+      return false;
+    }
+  }
+
+  // sub-meshes are ranges of the full mesh, the first level of detail
+  uint64_t fullIndexCount = data.indexCount;
+  for (uint32_t i = 0; i < data.lodCount; i++) {
+    if (!inRange(data.lods[i].firstIndex, data.lods[i].indexCount,
+                 data.indexCount)) {
+      return false;
+    }
+  }
+  if (data.lodCount > 0) {
+    if (data.lods[0].firstIndex != 0) {
+      return false;
+    }
+    fullIndexCount = data.lods[0].indexCount;
+  }
+  for (uint32_t i = 0; i < data.subMeshCount; i++) {
+    if (!inRange(data.subMeshes[i].firstIndex, data.subMeshes[i].indexCount,
+                 fullIndexCount)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void padTo(std::ofstream &file, uint64_t offset) {
+  static const char zeros[MeshCache::MESH_CACHE_ALIGNMENT]{};
+  uint64_t position = static_cast<uint64_t>(file.tellp());
+  file.write(zeros, static_cast<std::streamsize>(offset - position));
+}
+
+} // namespace
+
+SourceStamp stampSource(const std::string &sourcePath) {
+  return {
+      static_cast<uint64_t>(std::filesystem::file_size(sourcePath)),
+      static_cast<int64_t>(std::filesystem::last_write_time(sourcePath)
+                               .time_since_epoch()
+                               .count()),
+  };
+}
+
+uint64_t hashSource(const std::string &sourcePath) {
+  MappedFile source{sourcePath, MappedFile::Access::Sequential};
+  return hashBytes(source.data(), source.size());
+}
+
+MeshCache::MeshCache(std::string directory) : directory{std::move(directory)} {}
+
+std::string MeshCache::getEntryPath(const std::string &sourcePath,
+                                    const std::string &extension) const {
+  std::error_code error;
+  std::string canonical =
+      std::filesystem::weakly_canonical(sourcePath, error).string();
+  if (error) {
+    canonical = sourcePath;
+  }
+
+  std::ostringstream name;
+  name << std::filesystem::path{sourcePath}.stem().string() << '-' << std::hex
+       << std::setw(16) << std::setfill('0')
+       << hashBytes(canonical.data(), canonical.size()) << extension;
+  return (std::filesystem::path{directory} / name.str()).string();
+}
+
+std::string
+MeshCache::getMeshEntryPath(const std::string &sourcePath,
+                            const Model::LoadOptions &options) const {
+  std::ostringstream extension;
+  extension << '-' << std::hex << std::setw(16) << std::setfill('0')
+            << getOptionsHash(options) << ".vkmesh";
+  return getEntryPath(sourcePath, extension.str());
+}
+
+uint32_t MeshCache::getFlags(const Model::LoadOptions &options) {
+  uint32_t flags = 0;
+  if (options.optimizeMeshes) {
+    flags |= OPTIMIZED;
+    if (options.overdrawThreshold > 0.f) {
+      flags |= OVERDRAW_OPTIMIZED;
+    }
+  }
+  if (options.generateMeshlets) {
+    flags |= MESHLETS;
+  }
+  if (options.normalGeneration != Model::NormalGeneration::None) {
+    flags |= options.normalGeneration == Model::NormalGeneration::Missing
+                 ? MISSING_NORMALS
+                 : ALL_NORMALS;
+    if (options.angleWeightedNormals) {
+      flags |= ANGLE_WEIGHTED_NORMALS;
+    }
+  }
+  if (options.generateAngleWeightedTangents) {
+    flags |= ANGLE_WEIGHTED_TANGENTS;
+  }
+  if (options.generateLods) {
+    flags |= LODS;
+  }
+  if (options.quantizeVertices) {
+    flags |= QUANTIZED;
+  }
+  if (options.compressCache) {
+    flags |= COMPRESSED;
+  }
+  return flags;
+}
+
+float MeshCache::getOverdrawThreshold(const Model::LoadOptions &options) {
+  return getFlags(options) & OVERDRAW_OPTIMIZED ? options.overdrawThreshold
+                                                 : 0.f;
+}
+
+uint64_t MeshCache::getOptionsHash(const Model::LoadOptions &options) {
+  struct {
+    uint32_t flags;
+    float overdrawThreshold;
+  } key{getFlags(options), getOverdrawThreshold(options)};
+  return hashBytes(&key, sizeof(key));
+}
+
+std::unique_ptr<MeshCache::Entry>
+MeshCache::load(const std::string &sourcePath,
+                const Model::LoadOptions &options) const {
+  std::string entryPath = getMeshEntryPath(sourcePath, options);
+  std::error_code error;
+  if (!std::filesystem::exists(entryPath, error)) {
+    return nullptr;
+  }
+
+  MeshCacheHeader header;
+  uint32_t flags = getFlags(options);
+  bool quantized = (flags & QUANTIZED) != 0;
+  if (!readHeader(entryPath, header) || header.flags != flags ||
+      header.overdrawThreshold != getOverdrawThreshold(options) ||
+      (header.indexType != VK_INDEX_TYPE_UINT16 &&
+       header.indexType != VK_INDEX_TYPE_UINT32) ||
+      header.vertexStride != (quantized ? sizeof(Model::PackedVertex)
+                                        : sizeof(Model::Vertex)) ||
+      (header.tangentStride != 0 &&
+       header.tangentStride !=
+           (quantized ? sizeof(uint32_t) : sizeof(glm::vec4)))) {
+    return nullptr;
+  }
+
+  SourceStamp stamp = stampSource(sourcePath);
+  if (header.sourceSize != stamp.size ||
+      header.sourceModifiedTime != stamp.modifiedTime) {
+    if (header.sourceSize != stamp.size ||
+        header.sourceHash != hashSource(sourcePath)) {
+      return nullptr;
+    }
+
+    // same contents, refresh the stamp so the next launch skips the hash
+    header.sourceModifiedTime = stamp.modifiedTime;
+    std::fstream file{entryPath,
+                      std::ios::in | std::ios::out | std::ios::binary};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  }
+
+  auto entry = std::make_unique<Entry>(entryPath);
+  // every blob has to be aligned and inside the file, otherwise the entry is
+  // truncated or corrupt and gets cooked again
+  bool compressed = (flags & COMPRESSED) != 0;
+  bool valid = true;
+  auto decodeStart = std::chrono::high_resolution_clock::now();
+  auto blob = [&](uint64_t offset, uint64_t bytes) -> const char * {
+    if (!valid || offset % MESH_CACHE_ALIGNMENT != 0 ||
+        offset < sizeof(header) ||
+        !inRange(offset, compressed ? 0 : bytes, entry->file.size())) {
+      valid = false;
+      return nullptr;
+    }
+    const char *stored = entry->file.data() + offset;
+    size_t capacity = entry->file.size() - offset;
+    entry->stats.rawBytes += bytes;
+    if (!compressed) {
+      entry->stats.storedBytes += bytes;
+      return stored;
+    }
+
+    // a malformed blob throws, which the caller treats like a stale entry
+    if (getDecodedSize(stored, capacity) != bytes) {
+      valid = false;
+      return nullptr;
+    }
+    std::vector<uint8_t> &decoded = entry->decoded.emplace_back(bytes);
+    entry->decodeThreads = std::max(
+        entry->decodeThreads, decodeBlob(stored, capacity, decoded.data()));
+    return reinterpret_cast<const char *>(decoded.data());
+  };
+
+  VkIndexType indexType = static_cast<VkIndexType>(header.indexType);
+  Model::MeshData &data = entry->data;
+  const char *vertices = blob(
+      header.vertexOffset, uint64_t{header.vertexCount} * header.vertexStride);
+  if (quantized) {
+    data.packedVertices =
+        reinterpret_cast<const Model::PackedVertex *>(vertices);
+    std::memcpy(&data.quantization.offset, header.quantizationOffset,
+                sizeof(header.quantizationOffset));
+    std::memcpy(&data.quantization.scale, header.quantizationScale,
+                sizeof(header.quantizationScale));
+  } else {
+    data.vertices = reinterpret_cast<const Model::Vertex *>(vertices);
+  }
+  data.vertexCount = header.vertexCount;
+  if (header.tangentStride != 0) {
+    const char *tangents =
+        blob(header.tangentOffset,
+             uint64_t{header.vertexCount} * header.tangentStride);
+    data.hasTangents = true;
+    if (quantized) {
+      data.packedTangents = reinterpret_cast<const uint32_t *>(tangents);
+    } else {
+      data.tangents = reinterpret_cast<const glm::vec4 *>(tangents);
+    }
+  }
+  data.indices =
+      blob(header.indexOffset,
+           uint64_t{header.indexCount} * Model::getIndexSize(indexType));
+  data.indexCount = header.indexCount;
+  data.indexType = indexType;
+
+  if (header.meshletCount > 0) {
+    data.meshlets = reinterpret_cast<const Meshlet *>(blob(
+        header.meshletOffset, uint64_t{header.meshletCount} * sizeof(Meshlet)));
+    data.meshletCount = header.meshletCount;
+    data.meshletVertices = reinterpret_cast<const uint32_t *>(
+        blob(header.meshletVertexOffset,
+             uint64_t{header.meshletVertexCount} * sizeof(uint32_t)));
+    data.meshletVertexCount = header.meshletVertexCount;
+    data.meshletTriangles = reinterpret_cast<const uint8_t *>(
+        blob(header.meshletTriangleOffset, header.meshletTriangleBytes));
+    data.meshletTriangleBytes = header.meshletTriangleBytes;
+  }
+
+  if (header.lodCount > 0) {
+    data.lods = reinterpret_cast<const Model::Lod *>(
+        blob(header.lodOffset, uint64_t{header.lodCount} * sizeof(Model::Lod)));
+    data.lodCount = header.lodCount;
+  }
+
+  if (header.subMeshCount > 0) {
+    data.subMeshes = reinterpret_cast<const Model::SubMesh *>(
+        blob(header.subMeshOffset,
+             uint64_t{header.subMeshCount} * sizeof(Model::SubMesh)));
+    data.subMeshCount = header.subMeshCount;
+  }
+
+  if (compressed) {
+    entry->stats.storedBytes = entry->file.size() - sizeof(header);
+    entry->decodeMs =
+        std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - decodeStart)
+            .count();
+  }
+  return valid && hasValidRanges(data) ? std::move(entry) : nullptr;
+}
+
+MeshCache::BlobStats MeshCache::store(const std::string &sourcePath,
+                                      const Model::Builder &builder) const {
+  SourceStamp stamp = stampSource(sourcePath);
+  VkIndexType indexType = Model::getIndexType(builder.vertices.size());
+  std::vector<uint8_t> indices = Model::packIndices(builder.indices, indexType);
+  Model::MeshData data = Model::getMeshData(builder, indices.data(), indexType);
+
+  MeshCacheHeader header{};
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.vertexStride = data.packedVertices ? sizeof(Model::PackedVertex)
+                                            : sizeof(Model::Vertex);
+  if (data.hasTangents) {
+    header.tangentStride =
+        data.packedVertices ? sizeof(uint32_t) : sizeof(glm::vec4);
+  }
+  header.indexType = static_cast<uint32_t>(indexType);
+  header.flags = getFlags(builder.options);
+  header.overdrawThreshold = getOverdrawThreshold(builder.options);
+  header.vertexCount = data.vertexCount;
+  header.indexCount = data.indexCount;
+  header.meshletCount = data.meshletCount;
+  header.meshletVertexCount = data.meshletVertexCount;
+  header.meshletTriangleBytes = data.meshletTriangleBytes;
+  header.lodCount = data.lodCount;
+  header.subMeshCount = data.subMeshCount;
+  std::memcpy(header.quantizationOffset, &data.quantization.offset,
+              sizeof(header.quantizationOffset));
+  std::memcpy(header.quantizationScale, &data.quantization.scale,
+              sizeof(header.quantizationScale));
+  header.sourceSize = stamp.size;
+  header.sourceModifiedTime = stamp.modifiedTime;
+  header.sourceHash = hashSource(sourcePath);
+
+  struct Blob {
+    uint64_t *offset;
+    const void *data;
+    uint64_t bytes;
+    CodecFilter filter;
+    uint32_t stride;
+  };
+  CodecFilter indexFilter = indexType == VK_INDEX_TYPE_UINT16
+                                ? CodecFilter::Indices16
+                                : CodecFilter::Indices32;
+  std::vector<Blob> blobs{
+      {&header.vertexOffset,
+       data.packedVertices ? static_cast<const void *>(data.packedVertices)
+                           : static_cast<const void *>(data.vertices),
+       uint64_t{data.vertexCount} * header.vertexStride, CodecFilter::Elements,
+       header.vertexStride},
+      {&header.tangentOffset,
+       data.packedVertices ? static_cast<const void *>(data.packedTangents)
+                           : static_cast<const void *>(data.tangents),
+       uint64_t{data.vertexCount} * header.tangentStride,
+       header.tangentStride ? CodecFilter::Elements : CodecFilter::None,
+       header.tangentStride},
+      {&header.indexOffset, data.indices, indices.size(), indexFilter, 0},
+      {&header.meshletOffset, data.meshlets,
+       uint64_t{data.meshletCount} * sizeof(Meshlet), CodecFilter::Elements,
+       sizeof(Meshlet)},
+      {&header.meshletVertexOffset, data.meshletVertices,
+       uint64_t{data.meshletVertexCount} * sizeof(uint32_t),
+       CodecFilter::Indices32, 0},
+      {&header.meshletTriangleOffset, data.meshletTriangles,
+       data.meshletTriangleBytes, CodecFilter::None, 0},
+      {&header.lodOffset, data.lods,
+       uint64_t{data.lodCount} * sizeof(Model::Lod), CodecFilter::None, 0},
+      {&header.subMeshOffset, data.subMeshes,
+       uint64_t{data.subMeshCount} * sizeof(Model::SubMesh), CodecFilter::None,
+       0},
+  };
+
+  BlobStats stats{};
+  // owns the compressed blobs until they are written
+  std::vector<std::vector<uint8_t>> encoded;
+  encoded.reserve(blobs.size());
+  for (auto &blob : blobs) {
+    stats.rawBytes += blob.bytes;
+    if (header.flags & COMPRESSED) {
+      encoded.push_back(encodeBlob(blob.data, blob.bytes, blob.filter,
+                                   blob.stride));
+      blob.data = encoded.back().data();
+      blob.bytes = encoded.back().size();
+    }
+  }
+
+  uint64_t offset = sizeof(header);
+  for (auto &blob : blobs) {
+    offset = alignUp(offset);
+    *blob.offset = offset;
+    offset += blob.bytes;
+  }
+  stats.storedBytes = offset - sizeof(header);
+
+  std::filesystem::create_directories(directory);
+  std::string entryPath = getMeshEntryPath(sourcePath, builder.options);
+  // written next to the entry and renamed, so a reader never sees half a file
+  std::ostringstream tempPath;
+  tempPath << entryPath << '.' << std::this_thread::get_id() << ".tmp";
+  {
+    std::ofstream file{tempPath.str(), std::ios::binary | std::ios::trunc};
+    if (!file) {
+      throw std::runtime_error("Failed to create mesh cache file: " +
+                               tempPath.str());
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &blob : blobs) {
+      padTo(file, *blob.offset);
+      file.write(static_cast<const char *>(blob.data),
+                 static_cast<std::streamsize>(blob.bytes));
+    }
+    if (!file) {
+      throw std::runtime_error("Failed to write mesh cache file: " +
+                               tempPath.str());
+    }
+  }
+  std::filesystem::rename(tempPath.str(), entryPath);
+  return stats;
+}
+
+std::unique_ptr<PreparedMesh> prepareMesh(const std::string &filepath,
+                                          const Model::LoadOptions &options) {
+  using Clock = std::chrono::high_resolution_clock;
+  auto elapsedMs = [](Clock::time_point since) {
+    return std::chrono::duration<float, std::chrono::milliseconds::period>(
+               Clock::now() - since)
+        .count();
+  };
+
+  std::string sourcePath = ENGINE_DIR + filepath;
+  MeshCache cache{ENGINE_DIR "cache"};
+  auto mesh = std::make_unique<PreparedMesh>();
+  mesh->builder.options = options;
+  // lines are assembled first so concurrent loads do not interleave
+  std::ostringstream log;
+
+  auto start = Clock::now();
+  try {
+    mesh->entry = cache.load(sourcePath, options);
+  } catch (const std::exception &e) {
+    log << filepath << ": ignoring mesh cache, " << e.what() << '\n';
+  }
+  if (mesh->entry) {
+    const MeshCache::Entry &entry = *mesh->entry;
+    mesh->data = entry.data;
+    log << filepath << ": warm start, " << mesh->data.vertexCount
+        << " vertices mapped from the mesh cache in " << elapsedMs(start)
+        << " ms";
+    if (entry.decodeThreads > 0 && entry.decodeMs > 0.f) {
+      float gigabytesPerSecond = static_cast<float>(entry.stats.rawBytes) /
+                                 (entry.decodeMs * 1e6f);
+      log << ", decoded " << static_cast<float>(entry.stats.rawBytes) / 1e6f
+          << " MB at " << gigabytesPerSecond << " GB/s ("
+          << gigabytesPerSecond / static_cast<float>(entry.decodeThreads)
+          << " GB/s per core)";
+    }
+    log << '\n';
+    std::cout << log.str() << std::flush;
+    return mesh;
+  }
+
+  if (hasExtension(filepath, ".glb")) {
+    mesh->source = openGlbSource(sourcePath, options);
+  }
+  if (mesh->source) {
+    mesh->data = mesh->source->getMeshData();
+    log << filepath << ": " << mesh->data.vertexCount << " vertices in "
+        << mesh->data.subMeshCount
+        << " sub-meshes mapped for a direct upload in " << elapsedMs(start)
+        << " ms\n";
+    std::cout << log.str() << std::flush;
+    return mesh;
+  }
+
+  Model::Builder &builder = mesh->builder;
+  builder.loadModel(filepath);
+  float loadMs = elapsedMs(start);
+
+  // every index of the full mesh is a corner the file stored, so this is the
+  // welding gain
+  size_t cornerCount = builder.lods.empty() ? builder.indices.size()
+                                            : builder.lods[0].indexCount;
+  float reduction = builder.vertices.empty()
+                        ? 0.f
+                        : static_cast<float>(cornerCount) /
+                              static_cast<float>(builder.vertices.size());
+  log << filepath << ": cold start, " << builder.vertices.size()
+      << " vertices from " << cornerCount << " corners ("
+      << reduction << "x reduction), loaded in " << loadMs << " ms";
+  std::error_code error;
+  auto fileSize = std::filesystem::file_size(sourcePath, error);
+  if (!error && loadMs > 0.f) {
+    log << " (" << static_cast<float>(fileSize) / (loadMs * 1000.f)
+        << " MB/s)";
+  }
+
+  auto cookStart = Clock::now();
+  try {
+    MeshCache::BlobStats stats = cache.store(sourcePath, builder);
+    log << ", cooked in " << elapsedMs(cookStart) << " ms";
+    if (options.compressCache && stats.storedBytes > 0) {
+      log << " (" << static_cast<float>(stats.rawBytes) / 1e6f << " MB, "
+          << static_cast<float>(stats.rawBytes) /
+                 static_cast<float>(stats.storedBytes)
+          << "x compression)";
+    }
+    log << '\n';
+  } catch (const std::exception &e) {
+    log << ", not cooked: " << e.what() << '\n';
+  }
+  std::cout << log.str() << std::flush;
+
+  VkIndexType indexType = Model::getIndexType(builder.vertices.size());
+  mesh->indices = Model::packIndices(builder.indices, indexType);
+  mesh->data = Model::getMeshData(builder, mesh->indices.data(), indexType);
+  return mesh;
+}
+
+} // namespace vkEngine
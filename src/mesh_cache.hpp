@@ -0,0 +1,159 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "model.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vkEngine {
+
+// On disk layout of a cooked .vkmesh file. The vertex, tangent, index,
+// meshlet, LOD and sub-mesh blobs follow the header at MESH_CACHE_ALIGNMENT aligned offsets and are
+// stored exactly as the GPU consumes them, so a mapped file can be copied
+// straight into a staging buffer. With MeshCache::COMPRESSED every blob is an
+// encodeBlob() blob instead.
+struct MeshCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t vertexStride; // Vertex or PackedVertex
+  uint32_t indexType; // VkIndexType
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t flags; // MeshCache::Flags the mesh was cooked with
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+
+  uint32_t meshletCount;
+  uint32_t meshletVertexCount;
+  uint32_t meshletTriangleBytes;
+  uint32_t lodCount;
+  uint64_t meshletOffset;
+  uint64_t meshletVertexOffset;
+  uint64_t meshletTriangleOffset;
+  uint64_t lodOffset;
+
+  uint32_t subMeshCount;
+  // Model::LoadOptions::overdrawThreshold with OVERDRAW_OPTIMIZED, 0 without
+  float overdrawThreshold;
+  uint64_t subMeshOffset;
+
+  // glm::vec4 or packed tangents, 0 for a mesh without them
+  uint32_t tangentStride;
+  uint32_t padding;
+  uint64_t tangentOffset;
+
+  // Model::Quantization of packed vertices
+  float quantizationOffset[3];
+  float quantizationScale[3];
+
+  // identifies the source the mesh was cooked from
+  uint64_t sourceSize;
+  int64_t sourceModifiedTime;
+  uint64_t sourceHash;
+};
+
+// Identifies the version of a source file a cooked file was made from.
+struct SourceStamp {
+  uint64_t size;
+  int64_t modifiedTime;
+};
+SourceStamp stampSource(const std::string &sourcePath);
+uint64_t hashSource(const std::string &sourcePath);
+
+// Cooked meshes keyed by source path and the load options they were cooked
+// with, so loads of one source with different options keep entries of their
+// own. An entry is used when the source size and modification time still
+// match. When they do not, the source contents are hashed, so a touched but
+// unchanged file does not need to be re-cooked.
+//
+// Entries are validated before they are handed out, a corrupt or truncated
+// one is treated like a missing one and cooked again.
+class MeshCache {
+public:
+  static constexpr uint32_t VERSION = 8;
+  static constexpr uint64_t MESH_CACHE_ALIGNMENT = 64;
+
+  // load options that change the cooked data, an entry only matches a load
+  // with the same flags and overdraw threshold
+  enum Flags : uint32_t {
+    OPTIMIZED = 1u << 0,
+    OVERDRAW_OPTIMIZED = 1u << 1,
+    MESHLETS = 1u << 2,
+    LODS = 1u << 3,
+    QUANTIZED = 1u << 4,
+    COMPRESSED = 1u << 5,
+    MISSING_NORMALS = 1u << 6,
+    ALL_NORMALS = 1u << 7,
+    ANGLE_WEIGHTED_NORMALS = 1u << 8,
+    ANGLE_WEIGHTED_TANGENTS = 1u << 9,
+  };
+  static uint32_t getFlags(const Model::LoadOptions &options);
+  // the threshold the overdraw pass runs with, 0 if it does not run
+  static float getOverdrawThreshold(const Model::LoadOptions &options);
+  // identifies the cooked data of a load, part of the entry's file name
+  static uint64_t getOptionsHash(const Model::LoadOptions &options);
+
+  // blob bytes before and after compression
+  struct BlobStats {
+    uint64_t rawBytes = 0;
+    uint64_t storedBytes = 0;
+  };
+
+  // A mapped cache entry, data points into the mapping or, for a compressed
+  // entry, into decoded.
+  struct Entry {
+    explicit Entry(const std::string &filepath)
+        : file{filepath, MappedFile::Access::Sequential} {}
+
+    MappedFile file;
+    std::vector<std::vector<uint8_t>> decoded{};
+    Model::MeshData data{};
+    BlobStats stats{};
+    float decodeMs = 0.f;
+    size_t decodeThreads = 0;
+  };
+
+  explicit MeshCache(std::string directory);
+
+  // Returns nullptr if there is no valid entry for the source file.
+  std::unique_ptr<Entry> load(const std::string &sourcePath,
+                              const Model::LoadOptions &options) const;
+  BlobStats store(const std::string &sourcePath,
+                  const Model::Builder &builder) const;
+
+  // other cooked forms of a source, e.g. ChunkedMesh, live next to the
+  // entries under their own extension
+  std::string getEntryPath(const std::string &sourcePath,
+                           const std::string &extension) const;
+
+private:
+  std::string getMeshEntryPath(const std::string &sourcePath,
+                               const Model::LoadOptions &options) const;
+
+  std::string directory;
+};
+
+// CPU side result of loading a model file, ready to be uploaded. data points
+// into a mapped cache entry, into the parsed builder or at a source that
+// writes the mesh into staging memory itself.
+struct PreparedMesh {
+  std::unique_ptr<MeshCache::Entry> entry;
+  std::unique_ptr<Model::MeshSource> source;
+  Model::Builder builder{};
+  std::vector<uint8_t> indices{};
+  Model::MeshData data{};
+};
+
+// Loads a model file (relative to ENGINE_DIR) through the mesh cache, parsing
+// and cooking it on a miss. A .glb that needs no processing is not cooked,
+// it is uploaded straight out of the file (see openGlbSource()). Safe to call
+// from any thread.
+std::unique_ptr<PreparedMesh>
+prepareMesh(const std::string &filepath,
+            const Model::LoadOptions &options = {});
+
+} // namespace vkEngine
@@ -0,0 +1,497 @@
+#include "mesh_codec.hpp"
+#include "utils.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vkEngine {
+
+namespace {
+
+// raw bytes per block, rounded down to whole elements. Large enough to keep
+// the frequency tables negligible, small enough to spread a mesh over cores.
+constexpr size_t CODEC_BLOCK_SIZE = 256 * 1024;
+
+constexpr uint32_t RANS_SCALE_BITS = 12;
+constexpr uint32_t RANS_SCALE = 1u << RANS_SCALE_BITS;
+// the coder state is kept in [RANS_LOW, RANS_LOW << 8)
+constexpr uint32_t RANS_LOW = 1u << 23;
+// interleaved coder states, the decoder below is unrolled for four
+constexpr size_t RANS_STATES = 4;
+
+enum BlockMode : uint8_t {
+  STORED = 0, // filtered bytes as they are
+  RANS = 1,   // frequency table and rANS stream
+};
+
+// Start of an encoded blob, followed by the end offset of every block
+// within the payload and then the payload.
+struct BlobHeader {
+  uint32_t filter;
+  uint32_t stride;
+  uint64_t decodedSize;
+  uint32_t blockSize;
+  uint32_t blockCount;
+};
+
+[[noreturn]] void malformed() {
+  throw std::runtime_error("Malformed mesh codec blob");
+}
+
+void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t readVarint(const uint8_t *&p, const uint8_t *end) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (p == end) {
+      malformed();
+    }
+    uint8_t byte = *p++;
+    value |= uint64_t{byte & 0x7fu} << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  malformed();
+}
+
+// small magnitudes of either sign to small unsigned values
+uint32_t zigzag(uint32_t delta) {
+  return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+}
+
+uint32_t unzigzag(uint32_t value) { return (value >> 1) ^ (0u - (value & 1)); }
+
+size_t getElementSize(CodecFilter filter, uint32_t stride) {
+  switch (filter) {
+  case CodecFilter::Indices16:
+    return sizeof(uint16_t);
+  case CodecFilter::Indices32:
+    return sizeof(uint32_t);
+  case CodecFilter::Elements:
+    return stride;
+  default:
+    return 1;
+  }
+}
+
+void filterBlock(const uint8_t *data, size_t size, CodecFilter filter,
+                 uint32_t stride, std::vector<uint8_t> &out) {
+  out.clear();
+  switch (filter) {
+  case CodecFilter::Indices16:
+  case CodecFilter::Indices32: {
+    size_t indexSize = getElementSize(filter, stride);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < size; i += indexSize) {
+      uint32_t index = 0;
+      std::memcpy(&index, data + i, indexSize);
+      writeVarint(out, zigzag(index - previous));
+      previous = index;
+    }
+    break;
+  }
+  case CodecFilter::Elements: {
+    // lane l of element i goes to planes 4l to 4l + 3, one byte each
+    size_t count = size / stride;
+    out.resize(size);
+    for (size_t lane = 0; lane < stride / 4; lane++) {
+      uint8_t *planes = out.data() + lane * 4 * count;
+      uint32_t previous = 0;
+      for (size_t i = 0; i < count; i++) {
+        uint32_t word;
+        std::memcpy(&word, data + i * stride + lane * 4, sizeof(word));
+        uint32_t delta = zigzag(word - previous);
+        previous = word;
+        for (size_t b = 0; b < 4; b++) {
+          planes[b * count + i] = static_cast<uint8_t>(delta >> (8 * b));
+        }
+      }
+    }
+    break;
+  }
+  default:
+    out.assign(data, data + size);
+  }
+}
+
+void unfilterBlock(const uint8_t *filtered, size_t filteredSize,
+                   CodecFilter filter, uint32_t stride, uint8_t *out,
+                   size_t size) {
+  switch (filter) {
+  case CodecFilter::Indices16:
+  case CodecFilter::Indices32: {
+    size_t indexSize = getElementSize(filter, stride);
+    const uint8_t *p = filtered;
+    const uint8_t *end = filtered + filteredSize;
+    uint32_t previous = 0;
+    for (size_t i = 0; i < size; i += indexSize) {
+      uint64_t value = readVarint(p, end);
+      if (value > UINT32_MAX) {
+        malformed();
+      }
+      uint32_t index = previous + unzigzag(static_cast<uint32_t>(value));
+      std::memcpy(out + i, &index, indexSize);
+      previous = index;
+    }
+    if (p != end) {
+      malformed();
+    }
+    break;
+  }
+  case CodecFilter::Elements: {
+    if (filteredSize != size) {
+      malformed();
+    }
+    size_t count = size / stride;
+    for (size_t lane = 0; lane < stride / 4; lane++) {
+      const uint8_t *planes = filtered + lane * 4 * count;
+      uint32_t previous = 0;
+      for (size_t i = 0; i < count; i++) {
+        uint32_t delta = planes[i] | uint32_t{planes[count + i]} << 8 |
+                         uint32_t{planes[2 * count + i]} << 16 |
+                         uint32_t{planes[3 * count + i]} << 24;
+        previous += unzigzag(delta);
+        std::memcpy(out + i * stride + lane * 4, &previous, sizeof(previous));
+      }
+    }
+    break;
+  }
+  default:
+    if (filteredSize != size) {
+      malformed();
+    }
+    std::memcpy(out, filtered, size);
+  }
+}
+
+// Scales byte counts to frequencies summing to RANS_SCALE, keeping every
+// present symbol at 1 or more.
+void normalizeFrequencies(const size_t (&counts)[256], size_t total,
+                          uint32_t (&frequencies)[256]) {
+  uint32_t sum = 0;
+  for (size_t s = 0; s < 256; s++) {
+    frequencies[s] =
+        counts[s] == 0
+            ? 0
+            : std::max<uint32_t>(
+                  1, static_cast<uint32_t>(counts[s] * RANS_SCALE / total));
+    sum += frequencies[s];
+  }
+
+  // the rounding is settled on the most frequent symbols, where it costs the
+  // least
+  while (sum != RANS_SCALE) {
+    uint32_t *largest = std::max_element(frequencies, frequencies + 256);
+    if (sum < RANS_SCALE) {
+      *largest += RANS_SCALE - sum;
+      sum = RANS_SCALE;
+    } else {
+      uint32_t taken = std::min(sum - RANS_SCALE, *largest - 1);
+      *largest -= taken;
+      sum -= taken;
+    }
+  }
+}
+
+// Appends the frequency table and the rANS stream of in to out.
+void encodeRans(const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+  size_t counts[256]{};
+  for (uint8_t symbol : in) {
+    counts[symbol]++;
+  }
+  uint32_t frequencies[256];
+  normalizeFrequencies(counts, in.size(), frequencies);
+  uint32_t starts[256];
+  uint32_t start = 0;
+  for (size_t s = 0; s < 256; s++) {
+    writeVarint(out, frequencies[s]);
+    starts[s] = start;
+    start += frequencies[s];
+  }
+
+  // symbols are encoded last to first into a stream written backwards, so
+  // the decoder reads both forwards. Symbol i goes through state i % 4, the
+  // interleaved states let the decoder overlap four dependency chains. A
+  // symbol emits at most two bytes.
+  std::vector<uint8_t> stream(2 * in.size() + RANS_STATES * sizeof(uint32_t));
+  uint8_t *p = stream.data() + stream.size();
+  uint32_t states[RANS_STATES];
+  std::fill(states, states + RANS_STATES, RANS_LOW);
+  for (size_t i = in.size(); i-- > 0;) {
+    uint32_t &x = states[i % RANS_STATES];
+    uint32_t frequency = frequencies[in[i]];
+    uint32_t limit = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * frequency;
+    while (x >= limit) {
+      *--p = static_cast<uint8_t>(x);
+      x >>= 8;
+    }
+    x = ((x / frequency) << RANS_SCALE_BITS) + x % frequency + starts[in[i]];
+  }
+  for (size_t s = RANS_STATES; s-- > 0;) {
+    p -= sizeof(uint32_t);
+    for (size_t b = 0; b < sizeof(uint32_t); b++) {
+      p[b] = static_cast<uint8_t>(states[s] >> (8 * b));
+    }
+  }
+  out.insert(out.end(), p, stream.data() + stream.size());
+}
+
+void decodeRans(const uint8_t *p, const uint8_t *end, uint8_t *out,
+                size_t count) {
+  // one entry per slot: symbol in bits 0-7, frequency - 1 in bits 8-19 and
+  // the slot's offset within the symbol's range in bits 20-31
+  std::vector<uint32_t> slots(RANS_SCALE);
+  uint32_t start = 0;
+  for (uint32_t s = 0; s < 256; s++) {
+    uint64_t frequency = readVarint(p, end);
+    if (frequency > RANS_SCALE - start) {
+      malformed();
+    }
+    for (uint32_t i = 0; i < frequency; i++) {
+      slots[start + i] =
+          s | static_cast<uint32_t>(frequency - 1) << 8 | i << 20;
+    }
+    start += static_cast<uint32_t>(frequency);
+  }
+  if (start != RANS_SCALE ||
+      static_cast<size_t>(end - p) < RANS_STATES * sizeof(uint32_t)) {
+    malformed();
+  }
+
+  uint32_t states[RANS_STATES];
+  for (uint32_t &x : states) {
+    x = p[0] | uint32_t{p[1]} << 8 | uint32_t{p[2]} << 16 |
+        uint32_t{p[3]} << 24;
+    p += sizeof(uint32_t);
+  }
+
+  // the states and the table stay in locals, the byte stores may alias
+  // anything reached through memory
+  const uint32_t *table = slots.data();
+  auto decodeSymbol = [table, out](uint32_t &x, size_t i) {
+    uint32_t slot = table[x & (RANS_SCALE - 1)];
+    out[i] = static_cast<uint8_t>(slot);
+    x = (((slot >> 8) & 0xfff) + 1) * (x >> RANS_SCALE_BITS) + (slot >> 20);
+  };
+
+  // while a full round of renormalization fits the stream the byte reads
+  // need no bounds checks
+  auto renormalize = [](uint32_t &x, const uint8_t *&p) {
+    while (x < RANS_LOW) {
+      x = (x << 8) | *p++;
+    }
+  };
+  uint32_t x0 = states[0], x1 = states[1], x2 = states[2], x3 = states[3];
+  size_t i = 0;
+  for (; i + RANS_STATES <= count &&
+         static_cast<size_t>(end - p) >= 2 * RANS_STATES;
+       i += RANS_STATES) {
+    decodeSymbol(x0, i);
+    decodeSymbol(x1, i + 1);
+    decodeSymbol(x2, i + 2);
+    decodeSymbol(x3, i + 3);
+    renormalize(x0, p);
+    renormalize(x1, p);
+    renormalize(x2, p);
+    renormalize(x3, p);
+  }
+  states[0] = x0;
+  states[1] = x1;
+  states[2] = x2;
+  states[3] = x3;
+
+  for (; i < count; i++) {
+    uint32_t &x = states[i % RANS_STATES];
+    decodeSymbol(x, i);
+    while (x < RANS_LOW) {
+      if (p == end) {
+        malformed();
+      }
+      x = (x << 8) | *p++;
+    }
+  }
+
+  // the encoder started from RANS_LOW, anything else is corruption
+  for (uint32_t x : states) {
+    if (x != RANS_LOW) {
+      malformed();
+    }
+  }
+  if (p != end) {
+    malformed();
+  }
+}
+
+std::vector<uint8_t> encodeBlock(const uint8_t *data, size_t size,
+                                 CodecFilter filter, uint32_t stride) {
+  std::vector<uint8_t> filtered;
+  filterBlock(data, size, filter, stride, filtered);
+
+  std::vector<uint8_t> block;
+  block.push_back(RANS);
+  writeVarint(block, filtered.size());
+  size_t headerSize = block.size();
+  if (!filtered.empty()) {
+    encodeRans(filtered, block);
+  }
+  if (filtered.empty() || block.size() >= headerSize + filtered.size()) {
+    block.resize(headerSize);
+    block[0] = STORED;
+    block.insert(block.end(), filtered.begin(), filtered.end());
+  }
+  return block;
+}
+
+void decodeBlock(const uint8_t *block, size_t blockSize, CodecFilter filter,
+                 uint32_t stride, uint8_t *out, size_t size) {
+  const uint8_t *p = block;
+  const uint8_t *end = block + blockSize;
+  if (p == end) {
+    malformed();
+  }
+  uint8_t mode = *p++;
+  uint64_t filteredSize = readVarint(p, end);
+  // no filter grows data by more than a varint per index
+  if (filteredSize > 5 * size) {
+    malformed();
+  }
+
+  if (mode == STORED) {
+    if (static_cast<uint64_t>(end - p) != filteredSize) {
+      malformed();
+    }
+    unfilterBlock(p, filteredSize, filter, stride, out, size);
+  } else if (mode == RANS) {
+    std::vector<uint8_t> filtered(filteredSize);
+    decodeRans(p, end, filtered.data(), filtered.size());
+    unfilterBlock(filtered.data(), filtered.size(), filter, stride, out, size);
+  } else {
+    malformed();
+  }
+}
+
+struct ParsedBlob {
+  BlobHeader header;
+  CodecFilter filter;
+  std::vector<uint64_t> blockEnds;
+  const uint8_t *payload;
+};
+
+ParsedBlob parseBlob(const void *blob, size_t capacity) {
+  ParsedBlob parsed{};
+  if (capacity < sizeof(BlobHeader)) {
+    malformed();
+  }
+  std::memcpy(&parsed.header, blob, sizeof(BlobHeader));
+  const BlobHeader &header = parsed.header;
+  parsed.filter = static_cast<CodecFilter>(header.filter);
+
+  size_t elementSize = getElementSize(parsed.filter, header.stride);
+  if (header.filter > static_cast<uint32_t>(CodecFilter::Elements) ||
+      (parsed.filter == CodecFilter::Elements &&
+       (elementSize == 0 || elementSize % 4 != 0)) ||
+      header.blockSize == 0 || header.blockSize % elementSize != 0 ||
+      header.decodedSize % elementSize != 0 ||
+      header.blockCount != (header.decodedSize + header.blockSize - 1) /
+                               header.blockSize) {
+    malformed();
+  }
+
+  size_t tableSize = uint64_t{header.blockCount} * sizeof(uint64_t);
+  if (capacity - sizeof(BlobHeader) < tableSize) {
+    malformed();
+  }
+  const uint8_t *table = static_cast<const uint8_t *>(blob) + sizeof(BlobHeader);
+  parsed.blockEnds.resize(header.blockCount);
+  std::memcpy(parsed.blockEnds.data(), table, tableSize);
+  parsed.payload = table + tableSize;
+
+  uint64_t payloadCapacity = capacity - sizeof(BlobHeader) - tableSize;
+  uint64_t previous = 0;
+  for (uint64_t blockEnd : parsed.blockEnds) {
+    if (blockEnd < previous || blockEnd > payloadCapacity) {
+      malformed();
+    }
+    previous = blockEnd;
+  }
+  return parsed;
+}
+
+} // namespace
+
+std::vector<uint8_t> encodeBlob(const void *data, size_t size,
+                                CodecFilter filter, uint32_t stride) {
+  size_t elementSize = getElementSize(filter, stride);
+  if (filter == CodecFilter::Elements && (stride == 0 || stride % 4 != 0)) {
+    throw std::runtime_error("Element stride must be a multiple of 4");
+  }
+  assert(size % elementSize == 0 && "Blob must hold whole elements");
+
+  BlobHeader header{};
+  header.filter = static_cast<uint32_t>(filter);
+  header.stride = stride;
+  header.decodedSize = size;
+  header.blockSize = static_cast<uint32_t>(
+      std::max(elementSize, CODEC_BLOCK_SIZE / elementSize * elementSize));
+  header.blockCount = static_cast<uint32_t>(
+      (size + header.blockSize - 1) / header.blockSize);
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  std::vector<std::vector<uint8_t>> blocks(header.blockCount);
+  parallelFor(blocks.size(), [&](size_t i) {
+    size_t offset = i * header.blockSize;
+    blocks[i] = encodeBlock(bytes + offset,
+                            std::min<size_t>(header.blockSize, size - offset),
+                            filter, stride);
+  });
+
+  std::vector<uint64_t> blockEnds;
+  uint64_t blockEnd = 0;
+  for (const auto &block : blocks) {
+    blockEnd += block.size();
+    blockEnds.push_back(blockEnd);
+  }
+
+  std::vector<uint8_t> blob(sizeof(header) +
+                            blockEnds.size() * sizeof(uint64_t));
+  std::memcpy(blob.data(), &header, sizeof(header));
+  std::memcpy(blob.data() + sizeof(header), blockEnds.data(),
+              blockEnds.size() * sizeof(uint64_t));
+  blob.reserve(blob.size() + blockEnd);
+  for (const auto &block : blocks) {
+    blob.insert(blob.end(), block.begin(), block.end());
+  }
+  return blob;
+}
+
+size_t getDecodedSize(const void *blob, size_t capacity) {
+  return static_cast<size_t>(parseBlob(blob, capacity).header.decodedSize);
+}
+
+size_t decodeBlob(const void *blob, size_t capacity, void *destination) {
+  ParsedBlob parsed = parseBlob(blob, capacity);
+  const BlobHeader &header = parsed.header;
+  uint8_t *out = static_cast<uint8_t *>(destination);
+
+  parallelFor(header.blockCount, [&](size_t i) {
+    uint64_t begin = i == 0 ? 0 : parsed.blockEnds[i - 1];
+    uint64_t offset = uint64_t{i} * header.blockSize;
+    decodeBlock(parsed.payload + begin, parsed.blockEnds[i] - begin,
+                parsed.filter, header.stride, out + offset,
+                std::min<uint64_t>(header.blockSize,
+                                   header.decodedSize - offset));
+  });
+  return std::max<size_t>(1, std::min<size_t>(header.blockCount, workerCount()));
+}
+
+} // namespace vkEngine
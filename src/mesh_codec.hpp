@@ -0,0 +1,38 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkEngine {
+
+// How a blob is transformed before entropy coding, to turn the structure of
+// mesh data into runs of small, repetitive bytes.
+enum class CodecFilter : uint32_t {
+  None,
+  // differences to the previous index, zigzag and varint encoded
+  Indices16,
+  Indices32,
+  // differences of every 32 bit lane to the same lane of the previous
+  // element, zigzag encoded and split into byte planes. Needs the element
+  // stride, a multiple of 4.
+  Elements,
+};
+
+// Compresses a blob into independently decodable blocks, each filtered and
+// then entropy coded with an order 0 rANS coder. Blocks that do not shrink
+// are stored filtered only.
+std::vector<uint8_t> encodeBlob(const void *data, size_t size,
+                                CodecFilter filter, uint32_t stride = 0);
+
+// Size of the data an encoded blob decodes to. capacity bounds the blob, it
+// may be followed by other data. Throws std::runtime_error if malformed.
+size_t getDecodedSize(const void *blob, size_t capacity);
+
+// Decodes a blob into destination, which must hold getDecodedSize() bytes.
+// The blocks are decoded in parallel, returns the number of threads used.
+// Throws std::runtime_error if the blob is malformed.
+size_t decodeBlob(const void *blob, size_t capacity, void *destination);
+
+} // namespace vkEngine
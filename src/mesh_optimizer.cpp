@@ -0,0 +1,467 @@
+#include "mesh_optimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace vkEngine {
+
+namespace {
+
+constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                    size_t vertexCount, uint32_t cacheSize) {
+  VertexCacheStats stats{};
+  if (indices.empty()) {
+    return stats;
+  }
+
+  // a vertex is in the FIFO if it was pushed less than cacheSize misses ago
+  std::vector<size_t> pushedAt(vertexCount, 0);
+  std::vector<bool> referenced(vertexCount, false);
+  size_t misses = 0;
+  size_t uniqueCount = 0;
+  for (uint32_t index : indices) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      uniqueCount++;
+    } else if (misses - pushedAt[index] < cacheSize) {
+      continue;
+    }
+    pushedAt[index] = misses++;
+  }
+
+  stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+  stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueCount);
+  return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                         uint32_t cacheSize,
+                         std::vector<uint32_t> *clusterStarts) {
+  assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+  size_t triangleCount = indices.size() / 3;
+  if (clusterStarts) {
+    clusterStarts->clear();
+  }
+  if (triangleCount == 0) {
+    return;
+  }
+
+  TriangleAdjacency adjacency{indices, vertexCount};
+  std::vector<uint32_t> liveTriangles(vertexCount);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+    liveTriangles[v] = adjacency.count(v);
+  }
+  std::vector<uint32_t> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnds;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  uint32_t time = cacheSize + 1;
+  uint32_t cursor = 0;
+
+  auto skipDeadEnd = [&]() {
+    while (!deadEnds.empty()) {
+      uint32_t vertex = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles[vertex] > 0) {
+        return vertex;
+      }
+    }
+    for (; cursor < vertexCount; cursor++) {
+      if (liveTriangles[cursor] > 0) {
+        return cursor;
+      }
+    }
+    return NO_VERTEX;
+  };
+
+  uint32_t fanning = skipDeadEnd();
+  if (clusterStarts) {
+    clusterStarts->push_back(0);
+  }
+  while (fanning != NO_VERTEX) {
+    candidates.clear();
+    for (uint32_t i = adjacency.offsets[fanning];
+         i < adjacency.offsets[fanning + 1]; i++) {
+      uint32_t triangle = adjacency.triangles[i];
+      if (emitted[triangle]) {
+        continue;
+      }
+      emitted[triangle] = true;
+      for (uint32_t corner = 0; corner < 3; corner++) {
+        uint32_t vertex = indices[3 * triangle + corner];
+        output.push_back(vertex);
+        deadEnds.push_back(vertex);
+        candidates.push_back(vertex);
+        liveTriangles[vertex]--;
+        if (time - cacheTime[vertex] > cacheSize) {
+          cacheTime[vertex] = time++;
+        }
+      }
+    }
+
+    // prefer the candidate that stays in the cache while its remaining
+    // triangles are emitted, and among those the oldest one
+    uint32_t next = NO_VERTEX;
+    int best = -1;
+    for (uint32_t vertex : candidates) {
+      if (liveTriangles[vertex] == 0) {
+        continue;
+      }
+      int priority = 0;
+      if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+        priority = static_cast<int>(time - cacheTime[vertex]);
+      }
+      if (priority > best) {
+        best = priority;
+        next = vertex;
+      }
+    }
+    if (next == NO_VERTEX) {
+      next = skipDeadEnd();
+      if (clusterStarts && next != NO_VERTEX) {
+        clusterStarts->push_back(static_cast<uint32_t>(output.size() / 3));
+      }
+    }
+    fanning = next;
+  }
+
+  indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<Model::Vertex> &vertices,
+                      float threshold, uint32_t cacheSize) {
+  std::vector<uint32_t> hardStarts;
+  optimizeVertexCache(indices, vertices.size(), cacheSize, &hardStarts);
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+  hardStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  // split every run where its ACMR so far is within the threshold of the
+  // whole run's, so clusters end at points that cost little cache reuse
+  std::vector<uint32_t> clusterStarts;
+  std::vector<uint32_t> cacheTime(vertices.size(), 0);
+  uint32_t time = cacheSize + 1;
+  auto simulate = [&](uint32_t triangle) {
+    uint32_t misses = 0;
+    for (uint32_t corner = 0; corner < 3; corner++) {
+      uint32_t vertex = indices[3 * triangle + corner];
+      if (time - cacheTime[vertex] > cacheSize) {
+        cacheTime[vertex] = time++;
+        misses++;
+      }
+    }
+    return misses;
+  };
+  for (size_t c = 0; c + 1 < hardStarts.size(); c++) {
+    uint32_t begin = hardStarts[c];
+    uint32_t end = hardStarts[c + 1];
+
+    time += cacheSize + 1; // flush
+    uint32_t runMisses = 0;
+    for (uint32_t t = begin; t < end; t++) {
+      runMisses += simulate(t);
+    }
+    float runAcmr = static_cast<float>(runMisses) / static_cast<float>(end - begin);
+
+    time += cacheSize + 1;
+    clusterStarts.push_back(begin);
+    uint32_t clusterBegin = begin;
+    uint32_t clusterMisses = 0;
+    for (uint32_t t = begin; t < end; t++) {
+      clusterMisses += simulate(t);
+      float clusterAcmr = static_cast<float>(clusterMisses) /
+                          static_cast<float>(t + 1 - clusterBegin);
+      if (t + 1 < end && clusterAcmr <= threshold * runAcmr) {
+        clusterStarts.push_back(t + 1);
+        clusterBegin = t + 1;
+        clusterMisses = 0;
+        time += cacheSize + 1;
+      }
+    }
+  }
+  clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  // area weighted centroid of the mesh and of every cluster
+  size_t clusterCount = clusterStarts.size() - 1;
+  std::vector<glm::vec3> centroids(clusterCount, glm::vec3{0.f});
+  std::vector<glm::vec3> normals(clusterCount, glm::vec3{0.f});
+  glm::vec3 meshCentroid{0.f};
+  float meshArea = 0.f;
+  for (size_t c = 0; c < clusterCount; c++) {
+    float clusterArea = 0.f;
+    for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+      const glm::vec3 &a = vertices[indices[3 * t + 0]].position;
+      const glm::vec3 &b = vertices[indices[3 * t + 1]].position;
+      const glm::vec3 &d = vertices[indices[3 * t + 2]].position;
+      glm::vec3 areaNormal = glm::cross(b - a, d - a);
+      float area = glm::length(areaNormal);
+      centroids[c] += (a + b + d) * (area / 3.f);
+      normals[c] += areaNormal;
+      clusterArea += area;
+    }
+    meshCentroid += centroids[c];
+    meshArea += clusterArea;
+    if (clusterArea > 0.f) {
+      centroids[c] /= clusterArea;
+    }
+    float length = glm::length(normals[c]);
+    if (length > 0.f) {
+      normals[c] /= length;
+    }
+  }
+  if (meshArea > 0.f) {
+    meshCentroid /= meshArea;
+  }
+
+  // clusters far out along their own normal are seen from most directions
+  // they are visible from, so they occlude the most and are drawn first
+  std::vector<float> occlusion(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++) {
+    occlusion[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+  }
+  std::vector<uint32_t> order(clusterCount);
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return occlusion[a] > occlusion[b];
+  });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(indices.size());
+  for (uint32_t c : order) {
+    sorted.insert(sorted.end(), indices.begin() + 3 * clusterStarts[c],
+                  indices.begin() + 3 * clusterStarts[c + 1]);
+  }
+  indices.swap(sorted);
+}
+
+OverdrawStats analyzeOverdraw(const std::vector<Model::Vertex> &vertices,
+                              const std::vector<uint32_t> &indices,
+                              uint32_t resolution) {
+  OverdrawStats stats{};
+  if (indices.empty()) {
+    return stats;
+  }
+
+  glm::vec3 minimum{std::numeric_limits<float>::max()};
+  glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+  for (uint32_t index : indices) {
+    minimum = glm::min(minimum, vertices[index].position);
+    maximum = glm::max(maximum, vertices[index].position);
+  }
+  float extent = std::max({maximum.x - minimum.x, maximum.y - minimum.y,
+                           maximum.z - minimum.z, 1e-20f});
+  // keep a pixel of border so edges on the bounds are not clipped
+  float scale = static_cast<float>(resolution - 2) / extent;
+
+  std::vector<float> depth(size_t{resolution} * resolution);
+  for (int axis = 0; axis < 3; axis++) {
+    for (float direction : {1.f, -1.f}) {
+      std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+      int u = (axis + 1) % 3;
+      int v = (axis + 2) % 3;
+
+      for (size_t i = 0; i < indices.size(); i += 3) {
+        float x[3], y[3], z[3];
+        for (int k = 0; k < 3; k++) {
+          glm::vec3 p = (vertices[indices[i + k]].position - minimum) * scale;
+          x[k] = p[u] + 1.f;
+          y[k] = p[v] + 1.f;
+          z[k] = p[axis] * direction;
+        }
+
+        // the renderer does not cull, so both windings are rasterized
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area == 0.f) {
+          continue;
+        }
+        float inverseArea = 1.f / area;
+
+        int minX = std::max(0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))));
+        int maxX = std::min(static_cast<int>(resolution) - 1,
+                            static_cast<int>(std::ceil(std::max({x[0], x[1], x[2]}))));
+        int minY = std::max(0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+        int maxY = std::min(static_cast<int>(resolution) - 1,
+                            static_cast<int>(std::ceil(std::max({y[0], y[1], y[2]}))));
+        for (int py = minY; py <= maxY; py++) {
+          for (int px = minX; px <= maxX; px++) {
+            float sx = static_cast<float>(px) + .5f;
+            float sy = static_cast<float>(py) + .5f;
+            float w0 = ((x[1] - sx) * (y[2] - sy) - (x[2] - sx) * (y[1] - sy)) * inverseArea;
+            float w1 = ((x[2] - sx) * (y[0] - sy) - (x[0] - sx) * (y[2] - sy)) * inverseArea;
+            float w2 = 1.f - w0 - w1;
+            if (w0 < 0.f || w1 < 0.f || w2 < 0.f) {
+              continue;
+            }
+            float fragmentDepth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+            float &stored = depth[size_t(py) * resolution + size_t(px)];
+            if (fragmentDepth < stored) {
+              if (stored == std::numeric_limits<float>::max()) {
+                stats.pixelsCovered++;
+              }
+              stored = fragmentDepth;
+              stats.pixelsShaded++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  stats.overdraw = stats.pixelsCovered == 0
+                       ? 0.f
+                       : static_cast<float>(stats.pixelsShaded) /
+                             static_cast<float>(stats.pixelsCovered);
+  return stats;
+}
+
+namespace {
+
+void computeMeshletBounds(Meshlet &meshlet, const MeshletData &data,
+                          const std::vector<Model::Vertex> &vertices) {
+  auto position = [&](uint32_t local) -> const glm::vec3 & {
+    return vertices[data.vertices[meshlet.vertexOffset + local]].position;
+  };
+
+  // Ritter's sphere: start from an approximately farthest pair, then grow
+  // the sphere over every point still outside it
+  uint32_t a = 0;
+  uint32_t b = 0;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    if (glm::dot(position(i) - position(0), position(i) - position(0)) >
+        glm::dot(position(a) - position(0), position(a) - position(0))) {
+      a = i;
+    }
+  }
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    if (glm::dot(position(i) - position(a), position(i) - position(a)) >
+        glm::dot(position(b) - position(a), position(b) - position(a))) {
+      b = i;
+    }
+  }
+  glm::vec3 center = (position(a) + position(b)) * .5f;
+  float radius = glm::length(position(b) - position(a)) * .5f;
+  for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+    float distance = glm::length(position(i) - center);
+    if (distance > radius) {
+      float grown = (radius + distance) * .5f;
+      center += (position(i) - center) * ((grown - radius) / distance);
+      radius = grown;
+    }
+  }
+  meshlet.center = center;
+  meshlet.radius = radius;
+
+  // normal cone over the face normals, wider than 84 degrees is not worth
+  // testing
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.triangleCount);
+  glm::vec3 axis{0.f};
+  for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+    const uint8_t *triangle = &data.triangles[meshlet.triangleOffset + 3 * t];
+    glm::vec3 normal = glm::cross(position(triangle[1]) - position(triangle[0]),
+                                  position(triangle[2]) - position(triangle[0]));
+    float length = glm::length(normal);
+    if (length > 0.f) {
+      normals.push_back(normal / length);
+      axis += normal / length;
+    }
+  }
+  meshlet.coneAxis = glm::vec3{0.f};
+  meshlet.coneCutoff = 1.f;
+  float axisLength = glm::length(axis);
+  if (axisLength == 0.f) {
+    return;
+  }
+  axis /= axisLength;
+  float minimumDot = 1.f;
+  for (const auto &normal : normals) {
+    minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+  }
+  meshlet.coneAxis = axis;
+  if (minimumDot > .1f) {
+    meshlet.coneCutoff = std::sqrt(1.f - minimumDot * minimumDot);
+  }
+}
+
+} // namespace
+
+MeshletData buildMeshlets(const std::vector<Model::Vertex> &vertices,
+                          const std::vector<uint32_t> &indices) {
+  constexpr uint8_t NOT_LOCAL = 0xff;
+  MeshletData data{};
+  std::vector<uint8_t> localIndex(vertices.size(), NOT_LOCAL);
+  Meshlet current{};
+
+  auto flush = [&]() {
+    if (current.triangleCount == 0) {
+      return;
+    }
+    computeMeshletBounds(current, data, vertices);
+    for (uint32_t i = 0; i < current.vertexCount; i++) {
+      localIndex[data.vertices[current.vertexOffset + i]] = NOT_LOCAL;
+    }
+    data.meshlets.push_back(current);
+
+    // keep every meshlet's triangles 4 byte aligned for word loads
+    data.triangles.resize((data.triangles.size() + 3) & ~size_t{3}, 0);
+    current = {};
+    current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+    current.triangleOffset = static_cast<uint32_t>(data.triangles.size());
+  };
+
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    uint32_t newVertices = 0;
+    for (size_t k = 0; k < 3; k++) {
+      newVertices += localIndex[indices[i + k]] == NOT_LOCAL ? 1 : 0;
+    }
+    if (current.vertexCount + newVertices > MAX_MESHLET_VERTICES ||
+        current.triangleCount + 1 > MAX_MESHLET_TRIANGLES) {
+      flush();
+    }
+
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t index = indices[i + k];
+      if (localIndex[index] == NOT_LOCAL) {
+        localIndex[index] = static_cast<uint8_t>(current.vertexCount++);
+        data.vertices.push_back(index);
+      }
+      data.triangles.push_back(localIndex[index]);
+    }
+    current.triangleCount++;
+  }
+  flush();
+  return data;
+}
+
+std::vector<uint32_t> optimizeVertexFetch(std::vector<Model::Vertex> &vertices,
+                                          std::vector<uint32_t> &indices) {
+  std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+  std::vector<Model::Vertex> reordered;
+  reordered.reserve(vertices.size());
+
+  for (uint32_t &index : indices) {
+    if (remap[index] == NO_VERTEX) {
+      remap[index] = static_cast<uint32_t>(reordered.size());
+      reordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(reordered);
+  return remap;
+}
+
+} // namespace vkEngine
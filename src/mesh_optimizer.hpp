@@ -0,0 +1,98 @@
+#pragma once
+
+#include "meshlet.hpp"
+#include "model.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkEngine {
+
+// Simulated post-transform vertex cache behaviour of an index buffer.
+struct VertexCacheStats {
+  // average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+  float acmr = 0.f;
+  // average transform to vertex ratio, transformed vertices per vertex (>= 1)
+  float atvr = 0.f;
+};
+
+// Software rasterized depth complexity, averaged over six axis aligned
+// orthographic views with early depth testing in index order.
+struct OverdrawStats {
+  size_t pixelsCovered = 0;
+  size_t pixelsShaded = 0;
+  // shaded fragments per covered pixel, 1 means no overdraw
+  float overdraw = 0.f;
+};
+
+// Vertex to triangle adjacency in compressed rows.
+struct TriangleAdjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+
+  TriangleAdjacency(const std::vector<uint32_t> &indices, size_t vertexCount)
+      : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+    for (uint32_t index : indices) {
+      offsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+      triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  uint32_t count(uint32_t vertex) const {
+    return offsets[vertex + 1] - offsets[vertex];
+  }
+};
+
+// FIFO cache size the optimizer targets and the analysis simulates, about
+// what current GPUs reuse for full size vertices.
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices,
+                                    size_t vertexCount,
+                                    uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders triangles for post-transform cache reuse with Tipsify (Sander,
+// Nehab, Barczak 2007), which runs in linear time. If clusterStarts is given
+// it receives the first triangle of every run that started after the cache
+// was flushed, the natural boundaries for overdraw ordering.
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                         uint32_t cacheSize = VERTEX_CACHE_SIZE,
+                         std::vector<uint32_t> *clusterStarts = nullptr);
+
+// Reorders triangles so that clusters likely to occlude the rest of the mesh
+// from any direction are drawn first. The vertex cache order is computed
+// first and its runs are split further wherever that keeps the cluster's
+// ACMR within threshold times the original one, so a higher threshold
+// trades cache efficiency for smaller clusters and less overdraw.
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<Model::Vertex> &vertices,
+                      float threshold = 1.05f,
+                      uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+OverdrawStats analyzeOverdraw(const std::vector<Model::Vertex> &vertices,
+                              const std::vector<uint32_t> &indices,
+                              uint32_t resolution = 256);
+
+// Reorders vertices into the order the indices first reference them, so
+// vertex fetch walks memory forward. Unreferenced vertices are dropped.
+// Returns the new position of every old vertex, UINT32_MAX for dropped ones,
+// to reorder other per vertex streams along.
+std::vector<uint32_t> optimizeVertexFetch(std::vector<Model::Vertex> &vertices,
+                                          std::vector<uint32_t> &indices);
+
+// Splits an index buffer into meshlets of at most MAX_MESHLET_VERTICES
+// vertices and MAX_MESHLET_TRIANGLES triangles, in index order, so it should
+// run after the cache optimization. Computes each meshlet's bounding sphere
+// and normal cone.
+MeshletData buildMeshlets(const std::vector<Model::Vertex> &vertices,
+                          const std::vector<uint32_t> &indices);
+
+} // namespace vkEngine
@@ -0,0 +1,505 @@
+#include "mesh_simplifier.hpp"
+#include "mesh_optimizer.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+namespace vkEngine {
+
+namespace {
+
+constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+// Attribute differences are weighed against distances in a mesh scaled to
+// a unit box. A flipped normal costs about as much as moving a tenth of
+// the box.
+constexpr float NORMAL_WEIGHT = 0.05f;
+constexpr float UV_WEIGHT = 0.1f;
+constexpr float COLOR_WEIGHT = 0.05f;
+constexpr size_t ATTRIBUTE_COUNT = 8;
+
+// border edges are held in place by planes through them
+constexpr float BORDER_WEIGHT = 10.f;
+// a collapse may turn a triangle's normal by about 75 degrees at most
+constexpr float MIN_FLIP_COSINE = 0.25f;
+// share of triangles a level that misses its ratio has to remove to be kept
+constexpr float MIN_LEVEL_REDUCTION = 0.1f;
+
+// Sum of area weighted squared distances to a set of planes, as a symmetric
+// 4x4 matrix. w is the area it was accumulated over.
+struct Quadric {
+  float a00 = 0.f, a11 = 0.f, a22 = 0.f, a10 = 0.f, a20 = 0.f, a21 = 0.f;
+  float b0 = 0.f, b1 = 0.f, b2 = 0.f, c = 0.f;
+  float w = 0.f;
+
+  void addPlane(const glm::vec3 &n, float d, float weight) {
+    a00 += weight * n.x * n.x;
+    a11 += weight * n.y * n.y;
+    a22 += weight * n.z * n.z;
+    a10 += weight * n.y * n.x;
+    a20 += weight * n.z * n.x;
+    a21 += weight * n.z * n.y;
+    b0 += weight * n.x * d;
+    b1 += weight * n.y * d;
+    b2 += weight * n.z * d;
+    c += weight * d * d;
+    w += weight;
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    a00 += other.a00;
+    a11 += other.a11;
+    a22 += other.a22;
+    a10 += other.a10;
+    a20 += other.a20;
+    a21 += other.a21;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    w += other.w;
+    return *this;
+  }
+
+  // mean squared distance of p to the planes
+  float error(const glm::vec3 &p) const {
+    float r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+              2.f * (a10 * p.x * p.y + a20 * p.x * p.z + a21 * p.y * p.z) +
+              2.f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+    return w > 0.f ? std::fabs(r) / w : 0.f;
+  }
+};
+
+// Sum of area weighted squared distances to the attribute vectors of every
+// vertex merged into this one.
+struct AttributeQuadric {
+  float sum[ATTRIBUTE_COUNT]{};
+  float squaredLength = 0.f;
+  float w = 0.f;
+
+  AttributeQuadric &operator+=(const AttributeQuadric &other) {
+    for (size_t i = 0; i < ATTRIBUTE_COUNT; i++) {
+      sum[i] += other.sum[i];
+    }
+    squaredLength += other.squaredLength;
+    w += other.w;
+    return *this;
+  }
+
+  float error(const float *attributes) const {
+    float r = squaredLength;
+    for (size_t i = 0; i < ATTRIBUTE_COUNT; i++) {
+      r += attributes[i] * (w * attributes[i] - 2.f * sum[i]);
+    }
+    return w > 0.f ? std::fabs(r) / w : 0.f;
+  }
+};
+
+enum class VertexKind : uint8_t {
+  Manifold, // interior, collapses onto any neighbour
+  Border,   // collapses along its border edges only
+  Locked,   // seam or non-manifold, never moves
+};
+
+struct Collapse {
+  uint32_t from; // position
+  uint32_t to;   // vertex
+  float cost;
+  float distance;
+};
+
+// Collapses edges of an indexed mesh in passes. Vertices with the same
+// position are tracked as one position, the vertex indices sharing it are
+// its wedges.
+class Simplifier {
+public:
+  Simplifier(const std::vector<Model::Vertex> &vertices,
+             const std::vector<uint32_t> &sourceIndices)
+      : vertexCount{vertices.size()}, indices{sourceIndices} {
+    glm::vec3 minimum{std::numeric_limits<float>::max()};
+    glm::vec3 maximum{std::numeric_limits<float>::lowest()};
+    for (uint32_t index : indices) {
+      minimum = glm::min(minimum, vertices[index].position);
+      maximum = glm::max(maximum, vertices[index].position);
+    }
+    glm::vec3 extent = maximum - minimum;
+    scale = std::max(extent.x, std::max(extent.y, extent.z));
+    float inverseScale = scale > 0.f ? 1.f / scale : 0.f;
+
+    positions.resize(vertexCount);
+    attributes.resize(vertexCount * ATTRIBUTE_COUNT);
+    for (size_t i = 0; i < vertexCount; i++) {
+      const Model::Vertex &vertex = vertices[i];
+      positions[i] = (vertex.position - minimum) * inverseScale;
+      float *a = &attributes[i * ATTRIBUTE_COUNT];
+      a[0] = vertex.normal.x * NORMAL_WEIGHT;
+      a[1] = vertex.normal.y * NORMAL_WEIGHT;
+      a[2] = vertex.normal.z * NORMAL_WEIGHT;
+      a[3] = vertex.uv.x * UV_WEIGHT;
+      a[4] = vertex.uv.y * UV_WEIGHT;
+      a[5] = vertex.color.x * COLOR_WEIGHT;
+      a[6] = vertex.color.y * COLOR_WEIGHT;
+      a[7] = vertex.color.z * COLOR_WEIGHT;
+    }
+
+    buildPositionRemap(vertices);
+    removeDegenerateTriangles();
+    TriangleAdjacency adjacency{remappedIndices(), vertexCount};
+    buildQuadrics();
+    classifyVertices(adjacency);
+  }
+
+  // Returns false once no edge can be collapsed any more.
+  bool simplify(size_t targetIndexCount) {
+    while (indices.size() > targetIndexCount) {
+      TriangleAdjacency adjacency{remappedIndices(), vertexCount};
+      std::vector<Collapse> collapses = pickCollapses(adjacency);
+      if (collapses.empty()) {
+        return false;
+      }
+      std::sort(collapses.begin(), collapses.end(),
+                [](const Collapse &a, const Collapse &b) {
+                  return a.cost < b.cost;
+                });
+
+      size_t triangleGoal = (indices.size() - targetIndexCount + 2) / 3;
+      if (performCollapses(adjacency, collapses, triangleGoal) == 0) {
+        return false;
+      }
+      applyCollapses();
+    }
+    return true;
+  }
+
+  const std::vector<uint32_t> &getIndices() const { return indices; }
+  float getError() const { return maxDistance * scale; }
+
+private:
+  // maps every vertex to the first vertex with a bitwise equal position
+  void buildPositionRemap(const std::vector<Model::Vertex> &vertices) {
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto key = [&](uint32_t v) {
+      const glm::vec3 &p = vertices[v].position;
+      return std::make_tuple(p.x, p.y, p.z);
+    };
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return key(a) < key(b) || (key(a) == key(b) && a < b);
+    });
+
+    remap.resize(vertexCount);
+    wedgeCounts.assign(vertexCount, 0);
+    for (size_t i = 0; i < order.size();) {
+      size_t end = i + 1;
+      while (end < order.size() && key(order[end]) == key(order[i])) {
+        end++;
+      }
+      for (size_t j = i; j < end; j++) {
+        remap[order[j]] = order[i];
+      }
+      wedgeCounts[order[i]] = static_cast<uint32_t>(end - i);
+      i = end;
+    }
+  }
+
+  std::vector<uint32_t> remappedIndices() const {
+    std::vector<uint32_t> remapped(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+      remapped[i] = remap[indices[i]];
+    }
+    return remapped;
+  }
+
+  void removeDegenerateTriangles() {
+    size_t write = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      uint32_t a = remap[indices[i + 0]];
+      uint32_t b = remap[indices[i + 1]];
+      uint32_t c = remap[indices[i + 2]];
+      if (a == b || b == c || a == c) {
+        continue;
+      }
+      std::copy_n(indices.begin() + i, 3, indices.begin() + write);
+      write += 3;
+    }
+    indices.resize(write);
+  }
+
+  glm::vec3 triangleNormal(uint32_t a, uint32_t b, uint32_t c) const {
+    return glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+  }
+
+  void buildQuadrics() {
+    quadrics.assign(vertexCount, Quadric{});
+    attributeQuadrics.assign(vertexCount, AttributeQuadric{});
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      glm::vec3 normal = triangleNormal(indices[i], indices[i + 1],
+                                        indices[i + 2]);
+      float length = glm::length(normal);
+      if (length == 0.f) {
+        continue;
+      }
+      normal /= length;
+      float area = length * .5f;
+      float distance = -glm::dot(normal, positions[indices[i]]);
+
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t vertex = indices[i + k];
+        quadrics[remap[vertex]].addPlane(normal, distance, area);
+
+        const float *a = &attributes[vertex * ATTRIBUTE_COUNT];
+        AttributeQuadric &attribute = attributeQuadrics[vertex];
+        float weight = area / 3.f;
+        for (size_t j = 0; j < ATTRIBUTE_COUNT; j++) {
+          attribute.sum[j] += weight * a[j];
+          attribute.squaredLength += weight * a[j] * a[j];
+        }
+        attribute.w += weight;
+      }
+    }
+  }
+
+  // number of triangles sharing the edge between two positions
+  uint32_t countEdgeTriangles(const TriangleAdjacency &adjacency, uint32_t a,
+                              uint32_t b) const {
+    uint32_t count = 0;
+    for (uint32_t i = adjacency.offsets[a]; i < adjacency.offsets[a + 1];
+         i++) {
+      const uint32_t *triangle = &indices[adjacency.triangles[i] * 3];
+      for (size_t k = 0; k < 3; k++) {
+        count += remap[triangle[k]] == b;
+      }
+    }
+    return count;
+  }
+
+  // Border edges also get a plane through the edge, perpendicular to its
+  // triangle, which keeps the outline in place.
+  void classifyVertices(const TriangleAdjacency &adjacency) {
+    kinds.assign(vertexCount, VertexKind::Locked);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      if (remap[v] != v || wedgeCounts[v] != 1 || adjacency.count(v) == 0) {
+        continue;
+      }
+
+      uint32_t borderEdges = 0;
+      bool manifold = true;
+      for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1];
+           i++) {
+        const uint32_t *triangle = &indices[adjacency.triangles[i] * 3];
+        for (size_t k = 0; k < 3; k++) {
+          uint32_t other = remap[triangle[k]];
+          if (other == v) {
+            continue;
+          }
+          uint32_t count = countEdgeTriangles(adjacency, v, other);
+          manifold = manifold && count <= 2;
+          if (count != 1) {
+            continue;
+          }
+
+          borderEdges++;
+          glm::vec3 normal =
+              triangleNormal(triangle[0], triangle[1], triangle[2]);
+          glm::vec3 edge = positions[other] - positions[v];
+          glm::vec3 planeNormal = glm::cross(normal, edge);
+          float length = glm::length(planeNormal);
+          if (length > 0.f) {
+            planeNormal /= length;
+            quadrics[v].addPlane(planeNormal,
+                                 -glm::dot(planeNormal, positions[v]),
+                                 glm::dot(edge, edge) * BORDER_WEIGHT);
+          }
+        }
+      }
+
+      if (manifold && borderEdges == 0) {
+        kinds[v] = VertexKind::Manifold;
+      } else if (manifold && borderEdges == 2) {
+        kinds[v] = VertexKind::Border;
+      }
+    }
+  }
+
+  bool canCollapse(const TriangleAdjacency &adjacency, uint32_t from,
+                   uint32_t to) const {
+    switch (kinds[from]) {
+    case VertexKind::Manifold:
+      return true;
+    case VertexKind::Border:
+      return kinds[to] != VertexKind::Manifold &&
+             countEdgeTriangles(adjacency, from, to) == 1;
+    default:
+      return false;
+    }
+  }
+
+  void evaluate(const TriangleAdjacency &adjacency, uint32_t from,
+                uint32_t to, Collapse &best) const {
+    uint32_t fromPosition = remap[from];
+    uint32_t toPosition = remap[to];
+    if (!canCollapse(adjacency, fromPosition, toPosition)) {
+      return;
+    }
+
+    // a collapsing position has a single wedge, so from carries its
+    // attributes
+    float distance = quadrics[fromPosition].error(positions[toPosition]);
+    float cost = distance + attributeQuadrics[from].error(
+                                &attributes[to * ATTRIBUTE_COUNT]);
+    if (cost < best.cost) {
+      best = {fromPosition, to, cost, distance};
+    }
+  }
+
+  // The cheaper direction of every edge that may collapse.
+  std::vector<Collapse> pickCollapses(const TriangleAdjacency &adjacency) {
+    std::vector<Collapse> collapses;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t a = indices[i + k];
+        uint32_t b = indices[i + (k + 1) % 3];
+        // interior edges are seen from both triangles, keep one of them
+        if (remap[a] > remap[b] &&
+            countEdgeTriangles(adjacency, remap[a], remap[b]) != 1) {
+          continue;
+        }
+
+        Collapse best{NO_VERTEX, NO_VERTEX,
+                      std::numeric_limits<float>::max(), 0.f};
+        evaluate(adjacency, a, b, best);
+        evaluate(adjacency, b, a, best);
+        if (best.from != NO_VERTEX) {
+          collapses.push_back(best);
+        }
+      }
+    }
+    return collapses;
+  }
+
+  // moving from onto to must not fold any of the remaining triangles over
+  bool flipsTriangles(const TriangleAdjacency &adjacency, uint32_t from,
+                      uint32_t to) const {
+    for (uint32_t i = adjacency.offsets[from]; i < adjacency.offsets[from + 1];
+         i++) {
+      const uint32_t *triangle = &indices[adjacency.triangles[i] * 3];
+      uint32_t corners[3];
+      bool removed = false;
+      for (size_t k = 0; k < 3; k++) {
+        corners[k] = remap[triangle[k]];
+        removed = removed || corners[k] == to;
+      }
+      if (removed) {
+        continue;
+      }
+
+      glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+      for (uint32_t &corner : corners) {
+        corner = corner == from ? to : corner;
+      }
+      glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+      if (glm::dot(before, after) <=
+          MIN_FLIP_COSINE * glm::length(before) * glm::length(after)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Performs collapses in order of cost until triangleGoal triangles are
+  // gone. Both ends of a collapse are locked for the rest of the pass, so
+  // the adjacency stays valid enough for the flip test.
+  size_t performCollapses(const TriangleAdjacency &adjacency,
+                          const std::vector<Collapse> &collapses,
+                          size_t triangleGoal) {
+    targets.assign(vertexCount, NO_VERTEX);
+    std::vector<bool> locked(vertexCount, false);
+
+    size_t removed = 0;
+    size_t performed = 0;
+    for (const Collapse &collapse : collapses) {
+      if (removed >= triangleGoal) {
+        break;
+      }
+      uint32_t toPosition = remap[collapse.to];
+      if (locked[collapse.from] || locked[toPosition] ||
+          flipsTriangles(adjacency, collapse.from, toPosition)) {
+        continue;
+      }
+
+      removed += countEdgeTriangles(adjacency, collapse.from, toPosition);
+      targets[collapse.from] = collapse.to;
+      locked[collapse.from] = true;
+      locked[toPosition] = true;
+      quadrics[toPosition] += quadrics[collapse.from];
+      attributeQuadrics[collapse.to] += attributeQuadrics[collapse.from];
+      maxDistance = std::max(maxDistance, std::sqrt(collapse.distance));
+      performed++;
+    }
+    return performed;
+  }
+
+  void applyCollapses() {
+    for (uint32_t &index : indices) {
+      // positions that collapse have a single wedge, which is the position
+      if (targets[index] != NO_VERTEX) {
+        index = targets[index];
+      }
+    }
+    removeDegenerateTriangles();
+  }
+
+  size_t vertexCount;
+  std::vector<uint32_t> indices;
+  float scale = 0.f;
+  float maxDistance = 0.f;
+
+  // per vertex
+  std::vector<glm::vec3> positions;
+  std::vector<float> attributes;
+  std::vector<uint32_t> remap;
+  std::vector<AttributeQuadric> attributeQuadrics;
+  // per position, indexed by the position's first vertex
+  std::vector<uint32_t> wedgeCounts;
+  std::vector<Quadric> quadrics;
+  std::vector<VertexKind> kinds;
+  std::vector<uint32_t> targets;
+};
+
+} // namespace
+
+std::vector<LodLevel> buildLodChain(const std::vector<Model::Vertex> &vertices,
+                                    const std::vector<uint32_t> &indices,
+                                    const std::vector<float> &ratios) {
+  std::vector<LodLevel> levels;
+  if (indices.empty()) {
+    return levels;
+  }
+
+  Simplifier simplifier{vertices, indices};
+  size_t previousCount = indices.size();
+  for (float ratio : ratios) {
+    size_t triangleCount =
+        static_cast<size_t>(static_cast<float>(indices.size() / 3) * ratio);
+    bool reached = simplifier.simplify(triangleCount * 3);
+
+    size_t count = simplifier.getIndices().size();
+    if (static_cast<float>(count) >
+        static_cast<float>(previousCount) * (1.f - MIN_LEVEL_REDUCTION)) {
+      break;
+    }
+    levels.push_back({simplifier.getIndices(), simplifier.getError()});
+    previousCount = count;
+    if (!reached) {
+      break;
+    }
+  }
+  return levels;
+}
+
+} // namespace vkEngine
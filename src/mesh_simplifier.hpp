@@ -0,0 +1,37 @@
+#pragma once
+
+#include "model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vkEngine {
+
+// triangle counts of the LOD chain, relative to the full mesh
+inline const std::vector<float> DEFAULT_LOD_RATIOS{0.5f, 0.25f, 0.1f, 0.02f};
+
+// One simplified level, indexing the vertices of the source mesh.
+struct LodLevel {
+  std::vector<uint32_t> indices{};
+  // estimated distance between this level and the source surface, in model
+  // units
+  float error = 0.f;
+};
+
+// Builds a chain of simplified index buffers with quadric error metrics
+// (Garland and Heckbert 1997). Edges are collapsed onto one of their existing
+// vertices, so every level shares the source vertex buffer. The cost of a
+// collapse adds the normal, uv and color difference it introduces to the
+// plane distance error, so attributes survive as well as the shape does.
+//
+// Border vertices only collapse along the border. Vertices on uv or normal
+// seams and non-manifold vertices are never moved. Every level continues
+// from the previous one. A level that cannot reach its ratio is kept if it
+// still removed a tenth of the triangles, otherwise the chain ends there.
+std::vector<LodLevel>
+buildLodChain(const std::vector<Model::Vertex> &vertices,
+              const std::vector<uint32_t> &indices,
+              const std::vector<float> &ratios = DEFAULT_LOD_RATIOS);
+
+} // namespace vkEngine
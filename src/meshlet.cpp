@@ -0,0 +1,102 @@
+#include "meshlet.hpp"
+#include "frustum.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// libs
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace vkEngine {
+
+MeshletCullStats &MeshletCullStats::operator+=(const MeshletCullStats &other) {
+  meshlets += other.meshlets;
+  triangles += other.triangles;
+  frustumRejected += other.frustumRejected;
+  backfaceRejected += other.backfaceRejected;
+  return *this;
+}
+
+MeshletCullStats cullMeshlets(const std::vector<Meshlet> &meshlets,
+                              const glm::mat4 &modelMatrix,
+                              const glm::mat4 &projectionView,
+                              const glm::vec3 &cameraPosition,
+                              std::vector<uint32_t> *visible) {
+  Frustum frustum{projectionView};
+  float scale = getMaxScale(modelMatrix);
+  glm::mat3 rotation{modelMatrix};
+
+  MeshletCullStats stats{};
+  if (visible) {
+    visible->clear();
+  }
+  for (size_t i = 0; i < meshlets.size(); i++) {
+    const Meshlet &meshlet = meshlets[i];
+    stats.meshlets++;
+    stats.triangles += meshlet.triangleCount;
+
+    glm::vec3 center = glm::vec3{modelMatrix * glm::vec4{meshlet.center, 1.f}};
+    float radius = meshlet.radius * scale;
+
+    if (!frustum.intersectsSphere(center, radius)) {
+      stats.frustumRejected += meshlet.triangleCount;
+      continue;
+    }
+
+    if (meshlet.coneCutoff < 1.f) {
+      glm::vec3 axis = glm::normalize(rotation * meshlet.coneAxis);
+      glm::vec3 toCenter = center - cameraPosition;
+      if (glm::dot(toCenter, axis) >=
+          meshlet.coneCutoff * glm::length(toCenter) + radius) {
+        stats.backfaceRejected += meshlet.triangleCount;
+        continue;
+      }
+    }
+
+    if (visible) {
+      visible->push_back(static_cast<uint32_t>(i));
+    }
+  }
+  return stats;
+}
+
+MeshletCullStats sampleMeshletCulling(const std::vector<Meshlet> &meshlets,
+                                      uint32_t viewCount) {
+  MeshletCullStats total{};
+  if (meshlets.empty()) {
+    return total;
+  }
+
+  glm::vec3 minimum{meshlets[0].center - meshlets[0].radius};
+  glm::vec3 maximum{meshlets[0].center + meshlets[0].radius};
+  for (const auto &meshlet : meshlets) {
+    minimum = glm::min(minimum, meshlet.center - meshlet.radius);
+    maximum = glm::max(maximum, meshlet.center + meshlet.radius);
+  }
+  glm::vec3 target = (minimum + maximum) * .5f;
+  float radius = std::max(glm::length(maximum - minimum) * .5f, 1e-6f);
+
+  glm::mat4 projection =
+      glm::perspective(glm::radians(50.f), 1.f, radius * .1f, radius * 10.f);
+  for (uint32_t i = 0; i < viewCount; i++) {
+    // spread the eyes over a sphere with a golden angle spiral
+    float y = 1.f - 2.f * (static_cast<float>(i) + .5f) /
+                        static_cast<float>(viewCount);
+    float ring = std::sqrt(1.f - y * y);
+    float angle = static_cast<float>(i) * glm::pi<float>() *
+                  (3.f - std::sqrt(5.f));
+    glm::vec3 direction{ring * std::cos(angle), y, ring * std::sin(angle)};
+    glm::vec3 eye = target + direction * (2.5f * radius);
+    glm::vec3 up = std::abs(y) > .99f ? glm::vec3{1.f, 0.f, 0.f}
+                                      : glm::vec3{0.f, 1.f, 0.f};
+
+    glm::mat4 view = glm::lookAt(eye, target, up);
+    total += cullMeshlets(meshlets, glm::mat4{1.f}, projection * view, eye);
+  }
+  return total;
+}
+
+} // namespace vkEngine
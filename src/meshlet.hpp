@@ -0,0 +1,76 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vkEngine {
+
+// limits that fit mesh shader and compute culling workgroups of 64 threads,
+// 124 triangles keep the local index block at 372 bytes
+constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+// A small cluster of triangles with the data needed to cull it as a whole.
+// The layout matches std430, so the array can be used in a storage buffer.
+struct Meshlet {
+  // bounding sphere in model space
+  glm::vec3 center;
+  float radius;
+  // normal cone, the meshlet faces away from any eye for which
+  // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius
+  glm::vec3 coneAxis;
+  float coneCutoff;
+
+  uint32_t vertexOffset;   // into MeshletData::vertices
+  uint32_t triangleOffset; // into MeshletData::triangles, in bytes
+  uint32_t vertexCount;
+  uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match its std430 layout");
+
+struct MeshletData {
+  std::vector<Meshlet> meshlets{};
+  // mesh vertex indices referenced by each meshlet
+  std::vector<uint32_t> vertices{};
+  // three local vertex indices per triangle, padded to 4 bytes per meshlet
+  std::vector<uint8_t> triangles{};
+
+  bool empty() const { return meshlets.empty(); }
+};
+
+struct MeshletCullStats {
+  size_t meshlets = 0;
+  size_t triangles = 0;
+  size_t frustumRejected = 0; // triangles in meshlets outside the frustum
+  size_t backfaceRejected = 0; // triangles in meshlets facing away
+
+  float rejectedFraction() const {
+    return triangles == 0 ? 0.f
+                          : static_cast<float>(frustumRejected +
+                                               backfaceRejected) /
+                                static_cast<float>(triangles);
+  }
+  MeshletCullStats &operator+=(const MeshletCullStats &other);
+};
+
+// CPU reference of the per meshlet culling test a compute pass would run.
+// visible, if given, receives the indices of the meshlets that survive.
+MeshletCullStats cullMeshlets(const std::vector<Meshlet> &meshlets,
+                              const glm::mat4 &modelMatrix,
+                              const glm::mat4 &projectionView,
+                              const glm::vec3 &cameraPosition,
+                              std::vector<uint32_t> *visible = nullptr);
+
+// Culls from a ring of views around the meshlets' bounds, looking at their
+// center from 2.5 bounding radii away, to estimate what culling saves.
+MeshletCullStats sampleMeshletCulling(const std::vector<Meshlet> &meshlets,
+                                      uint32_t viewCount = 14);
+
+} // namespace vkEngine
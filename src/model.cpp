@@ -1,6 +1,18 @@
 #include "model.hpp"
 #include "device.hpp"
+#include "game_object.hpp"
+#include "loaders/gltf_loader.hpp"
+#include "loaders/obj_loader.hpp"
+#include "loaders/ply_loader.hpp"
+#include "loaders/stl_loader.hpp"
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "tangent_space.hpp"
+#include "upload_context.hpp"
 #include "utils.hpp"
+#include "vertex_welder.hpp"
 
 #include <memory>
 #include <stdexcept>
@@ -11,168 +23,793 @@
 // https://github.com/tinyobjloader/tinyobjloader/blob/release/tiny_obj_loader.h
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <iostream>
-#include <unordered_map>
+#include <limits>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
 #include <vulkan/vulkan_core.h>
 
 #ifndef ENGINE_DIR
 #define ENGINE_DIR "../"
 #endif
 
-namespace std {
-template <> struct hash<vkEngine::Model::Vertex> {
-  size_t operator()(vkEngine::Model::Vertex const &vertex) const {
-    size_t seed = 0;
-    vkEngine::hashCombine(seed, vertex.position, vertex.color, vertex.normal,
-                          vertex.uv);
-    return seed;
+namespace vkEngine {
+
+// Folds the unit sphere onto an octahedron and its lower half over the upper
+// one, giving a square of directions with fairly even precision.
+static glm::vec2 encodeOctahedral(glm::vec3 n) {
+  n /= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+  if (n.z >= 0.f) {
+    return {n.x, n.y};
   }
-};
-} // namespace std
+  return {(1.f - std::fabs(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+          (1.f - std::fabs(n.x)) * (n.y >= 0.f ? 1.f : -1.f)};
+}
 
-namespace vkEngine {
+// matches octahedralDecode in packed_shader_vert.vert
+static glm::vec3 decodeOctahedral(const glm::vec2 &e) {
+  glm::vec3 n{e.x, e.y, 1.f - std::fabs(e.x) - std::fabs(e.y)};
+  float t = std::max(-n.z, 0.f);
+  n.x += n.x >= 0.f ? -t : t;
+  n.y += n.y >= 0.f ? -t : t;
+  return glm::normalize(n);
+}
+
+// Vertices are split after the position into the position stream and the
+// attribute stream.
+static_assert(offsetof(Model::Vertex, color) == sizeof(Model::Vertex::position),
+              "Vertex attributes have to follow the position");
+static_assert(offsetof(Model::PackedVertex, normal) ==
+                  sizeof(Model::PackedVertex::position),
+              "PackedVertex attributes have to follow the position");
+
+// copies size bytes at offset out of every stride bytes of source
+static void copyStream(void *destination, const void *source, uint32_t count,
+                       size_t stride, size_t offset, size_t size) {
+  char *out = static_cast<char *>(destination);
+  const char *in = static_cast<const char *>(source) + offset;
+  for (uint32_t i = 0; i < count; i++) {
+    std::memcpy(out, in, size);
+    out += size;
+    in += stride;
+  }
+}
+
+Model::Model(VkEngineDevice &device) : vkEngineDevice{device} {}
 
 Model::Model(VkEngineDevice &device, Model::Builder &builder)
     : vkEngineDevice{device} {
-  createVertexBuffers(builder.vertices);
-  createIndexBuffers(builder.indices);
+  VkIndexType type = getIndexType(builder.vertices.size());
+  std::vector<uint8_t> indices = packIndices(builder.indices, type);
+  upload(getMeshData(builder, indices.data(), type));
+}
+
+Model::Model(VkEngineDevice &device, const MeshData &data)
+    : vkEngineDevice{device} {
+  upload(data);
+}
+
+void Model::upload(const MeshData &data) {
+  VkEngineUploadBatch batch{vkEngineDevice};
+  upload(data, batch);
+  batch.submit();
+  batch.wait();
+}
+
+void Model::upload(const MeshData &data, VkEngineUploadBatch &batch) {
+  assert(!isResident() && "Model is already resident");
+  createVertexBuffers(batch, data);
+  createIndexBuffers(batch, data);
+  createMeshletBuffers(batch, data);
+
+  lods.assign(data.lods, data.lods + data.lodCount);
+  if (lods.empty()) {
+    lods.push_back({0, data.indexCount, 0.f});
+  }
+  subMeshes.assign(data.subMeshes, data.subMeshes + data.subMeshCount);
+  if (subMeshes.empty()) {
+    subMeshes.push_back(hasIndexBuffer
+                            ? SubMesh{lods[0].firstIndex, lods[0].indexCount}
+                            : SubMesh{0, vertexCount});
+  }
+
+  batch.onComplete(
+      [this]() { resident.store(true, std::memory_order_release); });
+}
+
+void Model::shareMesh(const Model &other) {
+  assert(!isResident() && "Model is already resident");
+  assert(other.isResident() && "Shared model is not resident");
+  positionBuffer = other.positionBuffer;
+  attributeBuffer = other.attributeBuffer;
+  tangentBuffer = other.tangentBuffer;
+  vertexCount = other.vertexCount;
+  quantized = other.quantized;
+  quantization = other.quantization;
+  hasIndexBuffer = other.hasIndexBuffer;
+  indexBuffer = other.indexBuffer;
+  indexCount = other.indexCount;
+  indexType = other.indexType;
+  lods = other.lods;
+  subMeshes = other.subMeshes;
+  bounds = other.bounds;
+  meshlets = other.meshlets;
+  meshletBuffer = other.meshletBuffer;
+  meshletVertexBuffer = other.meshletVertexBuffer;
+  meshletTriangleBuffer = other.meshletTriangleBuffer;
+  resident.store(true, std::memory_order_release);
 }
 
 Model::~Model() {}
 
+Bounds Model::getWorldBounds(const TransformComponent &transform) const {
+  return bounds.transformed(transform.mat4());
+}
+
 std::unique_ptr<Model> Model::createModelFromFile(VkEngineDevice &device,
                                                   const std::string &filepath) {
-  Builder builder{};
-  builder.loadModel(filepath);
-  std::cout << "vertex count: " << builder.vertices.size() << std::endl;
-  return std::make_unique<Model>(device, builder);
+  return createModelFromFile(device, filepath, LoadOptions{});
+}
+
+std::unique_ptr<Model> Model::createModelFromFile(VkEngineDevice &device,
+                                                  const std::string &filepath,
+                                                  const LoadOptions &options) {
+  std::unique_ptr<PreparedMesh> mesh = prepareMesh(filepath, options);
+  return std::make_unique<Model>(device, mesh->data);
 }
 
-void Model::createVertexBuffers(const std::vector<Vertex> &vertices) {
-  vertexCount = static_cast<uint32_t>(vertices.size());
+void Model::createVertexBuffers(VkEngineUploadBatch &batch,
+                                const MeshData &data) {
+  vertexCount = data.vertexCount;
   assert(vertexCount >= 3 && "Vertex count must be at least 3");
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-  uint32_t vertexSize = sizeof(vertices[0]);
-
-  VkEngineBuffer stagingBuffer{
-      vkEngineDevice,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+  quantized = data.packedVertices != nullptr;
+  quantization = quantized ? data.quantization : Quantization{};
+  const void *vertices =
+      quantized ? static_cast<const void *>(data.packedVertices)
+                : static_cast<const void *>(data.vertices);
+  size_t vertexSize = quantized ? sizeof(PackedVertex) : sizeof(Vertex);
+  size_t positionSize = quantized ? sizeof(PackedVertex::position)
+                                  : sizeof(Vertex::position);
+  size_t attributeSize = vertexSize - positionSize;
+
+  // de-interleaved on the way into the staging buffers, or written there by
+  // the source
+  const MeshSource *source = data.source;
+  uint32_t count = vertexCount;
+  auto createStream = [&](size_t size,
+                          const std::function<void(void *)> &fill) {
+    auto buffer = std::make_unique<VkEngineBuffer>(
+        vkEngineDevice, size, vertexCount,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    batch.uploadToBuffer(VkDeviceSize{size} * count, buffer->getBuffer(),
+                         fill);
+    return buffer;
   };
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)vertices.data());
+  positionBuffer = createStream(positionSize, [=](void *staging) {
+    if (source) {
+      source->writePositions(static_cast<glm::vec3 *>(staging));
+    } else {
+      copyStream(staging, vertices, count, vertexSize, 0, positionSize);
+    }
+  });
+  attributeBuffer = createStream(attributeSize, [=](void *staging) {
+    if (source) {
+      source->writeAttributes(staging);
+    } else {
+      copyStream(staging, vertices, count, vertexSize, positionSize,
+                 attributeSize);
+    }
+  });
+
+  // tangents are a stream of their own already
+  tangentBuffer = nullptr;
+  if (data.hasTangents) {
+    const void *tangents =
+        quantized ? static_cast<const void *>(data.packedTangents)
+                  : static_cast<const void *>(data.tangents);
+    size_t tangentSize = quantized ? sizeof(uint32_t) : sizeof(glm::vec4);
+    tangentBuffer = createStream(tangentSize, [=](void *staging) {
+      if (source) {
+        source->writeTangents(static_cast<glm::vec4 *>(staging));
+      } else {
+        std::memcpy(staging, tangents, tangentSize * count);
+      }
+    });
+  }
 
-  vertexBuffer = std::make_unique<VkEngineBuffer>(
-      vkEngineDevice, vertexSize, vertexCount,
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (source) {
+    bounds = source->getBounds();
+  } else if (quantized) {
+    bounds = computeBounds(data.packedVertices[0].position, vertexCount,
+                           sizeof(PackedVertex), quantization.offset,
+                           quantization.scale);
+  } else {
+    bounds = computeBounds(&data.vertices[0].position.x, vertexCount,
+                           sizeof(Vertex));
+  }
+}
 
-  vkEngineDevice.copyBuffer(stagingBuffer.getBuffer(),
-                            vertexBuffer->getBuffer(), bufferSize);
+VkIndexType Model::getIndexType(size_t vertexCount) {
+  // 16 bit indices halve the index bandwidth, so only widen when needed
+  return vertexCount <= std::numeric_limits<uint16_t>::max() + size_t{1}
+             ? VK_INDEX_TYPE_UINT16
+             : VK_INDEX_TYPE_UINT32;
 }
 
-void Model::createIndexBuffers(const std::vector<uint16_t> &indices) {
-  indexCount = static_cast<uint16_t>(indices.size());
+size_t Model::getIndexSize(VkIndexType indexType) {
+  return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t)
+                                           : sizeof(uint32_t);
+}
+
+std::vector<uint8_t> Model::packIndices(const std::vector<uint32_t> &indices,
+                                        VkIndexType indexType) {
+  std::vector<uint8_t> packed(indices.size() * getIndexSize(indexType));
+  if (indexType == VK_INDEX_TYPE_UINT32) {
+    std::memcpy(packed.data(), indices.data(), packed.size());
+    return packed;
+  }
+
+  for (size_t i = 0; i < indices.size(); i++) {
+    assert(indices[i] <= std::numeric_limits<uint16_t>::max() &&
+           "Index does not fit in 16 bits");
+    uint16_t index = static_cast<uint16_t>(indices[i]);
+    std::memcpy(packed.data() + i * sizeof(index), &index, sizeof(index));
+  }
+  return packed;
+}
+
+void Model::createIndexBuffers(VkEngineUploadBatch &batch,
+                               const MeshData &data) {
+  indexCount = data.indexCount;
+  indexType = data.indexType;
   hasIndexBuffer = indexCount > 0;
 
   if (!hasIndexBuffer) {
     return;
   }
 
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-  uint32_t indexSize = sizeof(indices[0]);
-  VkEngineBuffer stagingBuffer{
-      vkEngineDevice,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)indices.data());
+  uint32_t indexSize = static_cast<uint32_t>(getIndexSize(indexType));
+  VkDeviceSize bufferSize = VkDeviceSize{indexSize} * indexCount;
   indexBuffer = std::make_unique<VkEngineBuffer>(
       vkEngineDevice, indexSize, indexCount,
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  vkEngineDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(),
-                       bufferSize);
+
+  if (data.source) {
+    const MeshSource *source = data.source;
+    batch.uploadToBuffer(bufferSize, indexBuffer->getBuffer(),
+                         [=](void *staging) { source->writeIndices(staging); });
+  } else {
+    batch.uploadToBuffer(data.indices, bufferSize, indexBuffer->getBuffer());
+  }
+}
+
+std::unique_ptr<VkEngineBuffer>
+Model::createStorageBuffer(VkEngineUploadBatch &batch, const void *data,
+                           VkDeviceSize size) {
+  auto buffer = std::make_unique<VkEngineBuffer>(
+      vkEngineDevice, size, 1,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  batch.uploadToBuffer(data, size, buffer->getBuffer());
+  return buffer;
+}
+
+void Model::createMeshletBuffers(VkEngineUploadBatch &batch,
+                                 const MeshData &data) {
+  if (data.meshletCount == 0) {
+    return;
+  }
+
+  meshlets.assign(data.meshlets, data.meshlets + data.meshletCount);
+  meshletBuffer = createStorageBuffer(
+      batch, data.meshlets, sizeof(Meshlet) * VkDeviceSize{data.meshletCount});
+  meshletVertexBuffer = createStorageBuffer(
+      batch, data.meshletVertices,
+      sizeof(uint32_t) * VkDeviceSize{data.meshletVertexCount});
+  meshletTriangleBuffer = createStorageBuffer(batch, data.meshletTriangles,
+                                              data.meshletTriangleBytes);
+}
+
+Model::MeshData Model::getMeshData(const Builder &builder,
+                                   const void *packedIndices,
+                                   VkIndexType indexType) {
+  MeshData data{};
+  if (builder.packedVertices.empty()) {
+    data.vertices = builder.vertices.data();
+  } else {
+    data.packedVertices = builder.packedVertices.data();
+    data.quantization = builder.quantization;
+  }
+  data.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+  data.hasTangents = !builder.tangents.empty();
+  if (data.hasTangents) {
+    data.tangents = builder.tangents.data();
+    data.packedTangents = builder.packedTangents.data();
+  }
+  data.indices = packedIndices;
+  data.indexCount = static_cast<uint32_t>(builder.indices.size());
+  data.indexType = indexType;
+  data.meshlets = builder.meshlets.meshlets.data();
+  data.meshletCount = static_cast<uint32_t>(builder.meshlets.meshlets.size());
+  data.meshletVertices = builder.meshlets.vertices.data();
+  data.meshletVertexCount =
+      static_cast<uint32_t>(builder.meshlets.vertices.size());
+  data.meshletTriangles = builder.meshlets.triangles.data();
+  data.meshletTriangleBytes =
+      static_cast<uint32_t>(builder.meshlets.triangles.size());
+  data.lods = builder.lods.data();
+  data.lodCount = static_cast<uint32_t>(builder.lods.size());
+  data.subMeshes = builder.subMeshes.data();
+  data.subMeshCount = static_cast<uint32_t>(builder.subMeshes.size());
+  return data;
 }
 
-void Model::draw(VkCommandBuffer commandBuffer) {
+void Model::draw(VkCommandBuffer commandBuffer, uint32_t lod) {
   if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+    const Lod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    vkCmdDrawIndexed(commandBuffer, level.indexCount, 1, level.firstIndex, 0,
+                     0);
   } else {
     vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
   }
 }
 
+void Model::drawSubMesh(VkCommandBuffer commandBuffer, uint32_t subMesh) {
+  const SubMesh &part = subMeshes[subMesh];
+  if (hasIndexBuffer) {
+    vkCmdDrawIndexed(commandBuffer, part.indexCount, 1, part.firstIndex, 0, 0);
+  } else {
+    vkCmdDraw(commandBuffer, part.indexCount, 1, part.firstIndex, 0);
+  }
+}
+
 void Model::bind(VkCommandBuffer commandBuffer) {
-  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+  VkBuffer buffers[] = {
+      positionBuffer->getBuffer(), attributeBuffer->getBuffer(),
+      tangentBuffer ? tangentBuffer->getBuffer() : VK_NULL_HANDLE};
+  VkDeviceSize offsets[] = {0, 0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, tangentBuffer ? 3 : 2, buffers,
+                         offsets);
+
+  if (hasIndexBuffer) {
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0,
+                         indexType);
+  }
+}
+
+void Model::bindPositions(VkCommandBuffer commandBuffer) {
+  VkBuffer buffers[] = {positionBuffer->getBuffer()};
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
   if (hasIndexBuffer) {
-    vkCmdBindIndexBuffer(
-        commandBuffer, indexBuffer->getBuffer(), 0,
-        VK_INDEX_TYPE_UINT16); // change to 32 bit indices if models too big
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0,
+                         indexType);
   }
 }
 
 std::vector<VkVertexInputBindingDescription>
 Model::Vertex::getBindingDescriptions() {
-  std::vector<VkVertexInputBindingDescription> bindingDescriptions{1};
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{2};
   bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
+  bindingDescriptions[0].stride = sizeof(Vertex::position);
   bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  bindingDescriptions[1].binding = 1;
+  bindingDescriptions[1].stride = sizeof(Vertex) - sizeof(Vertex::position);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
   return bindingDescriptions;
 }
 
 std::vector<VkVertexInputAttributeDescription>
 Model::Vertex::getAttributeDescriptions() {
+  // offsets within the attribute stream start after the position
+  constexpr uint32_t base = offsetof(Vertex, color);
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
+  attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0});
   attributeDescriptions.push_back(
-      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
+      {1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) - base});
   attributeDescriptions.push_back(
-      {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
+      {2, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) - base});
   attributeDescriptions.push_back(
-      {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
+      {3, 1, VK_FORMAT_R32G32_SFLOAT,
+       offsetof(Vertex, uv) - base}); // textures only have 2 components
+
+  return attributeDescriptions;
+}
+
+std::vector<VkVertexInputBindingDescription>
+Model::Vertex::getPositionBindingDescriptions() {
+  return {getBindingDescriptions()[0]};
+}
+
+std::vector<VkVertexInputAttributeDescription>
+Model::Vertex::getPositionAttributeDescriptions() {
+  return {getAttributeDescriptions()[0]};
+}
+
+std::vector<VkVertexInputBindingDescription>
+Model::Vertex::getTangentBindingDescriptions() {
+  return {{2, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX}};
+}
+
+std::vector<VkVertexInputAttributeDescription>
+Model::Vertex::getTangentAttributeDescriptions() {
+  return {{4, 2, VK_FORMAT_R32G32B32A32_SFLOAT, 0}};
+}
+
+std::vector<VkVertexInputBindingDescription>
+Model::PackedVertex::getBindingDescriptions() {
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{2};
+  bindingDescriptions[0].binding = 0;
+  bindingDescriptions[0].stride = sizeof(PackedVertex::position);
+  bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  bindingDescriptions[1].binding = 1;
+  bindingDescriptions[1].stride =
+      sizeof(PackedVertex) - sizeof(PackedVertex::position);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription>
+Model::PackedVertex::getAttributeDescriptions() {
+  // same locations as Vertex, the fixed function fetch does the unorm,
+  // snorm and half conversions
+  constexpr uint32_t base = offsetof(PackedVertex, normal);
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+  attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, 0});
+  attributeDescriptions.push_back(
+      {1, 1, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color) - base});
   attributeDescriptions.push_back(
-      {3, 0, VK_FORMAT_R32G32_SFLOAT,
-       offsetof(Vertex, uv)}); // textures only have 2 components
+      {2, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal) - base});
+  attributeDescriptions.push_back(
+      {3, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv) - base});
 
   return attributeDescriptions;
 }
 
+std::vector<VkVertexInputBindingDescription>
+Model::PackedVertex::getPositionBindingDescriptions() {
+  return {getBindingDescriptions()[0]};
+}
+
+std::vector<VkVertexInputAttributeDescription>
+Model::PackedVertex::getPositionAttributeDescriptions() {
+  return {getAttributeDescriptions()[0]};
+}
+
+std::vector<VkVertexInputBindingDescription>
+Model::PackedVertex::getTangentBindingDescriptions() {
+  return {{2, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_VERTEX}};
+}
+
+std::vector<VkVertexInputAttributeDescription>
+Model::PackedVertex::getTangentAttributeDescriptions() {
+  // the snorm variant of the format is not guaranteed for vertex fetch
+  return {{4, 2, VK_FORMAT_A2B10G10R10_UNORM_PACK32, 0}};
+}
+
+glm::mat4 Model::Quantization::matrix() const {
+  glm::mat4 m{1.f};
+  m[0][0] = scale.x;
+  m[1][1] = scale.y;
+  m[2][2] = scale.z;
+  m[3] = glm::vec4{offset, 1.f};
+  return m;
+}
+
 void Model::Builder::loadModel(const std::string &filepath) {
   std::string enginePath = ENGINE_DIR + filepath;
+  subMeshes.clear();
+  tangents.clear();
+  if (hasExtension(filepath, ".stl")) {
+    loadStl(enginePath, *this);
+  } else if (hasExtension(filepath, ".glb")) {
+    loadGlb(enginePath, *this);
+  } else if (hasExtension(filepath, ".ply")) {
+    loadPly(enginePath, *this);
+  } else if (options.parallelObjParsing) {
+    loadObjParallel(enginePath, *this);
+  } else {
+    loadTinyObj(enginePath);
+  }
+
+  if (options.normalGeneration != NormalGeneration::None ||
+      options.generateAngleWeightedTangents) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t vertexCount = vertices.size();
+    size_t normalCount = generateTangentSpace();
+    // sources with normals and no tangents asked for have nothing to report
+    if (normalCount > 0 || options.generateAngleWeightedTangents) {
+      std::ostringstream log;
+      log << filepath << ": generated " << normalCount << " normals";
+      if (options.generateAngleWeightedTangents) {
+        log << " and " << tangents.size() << " tangents ("
+            << vertices.size() - vertexCount << " vertices split)";
+      }
+      log << " in "
+          << std::chrono::duration<float, std::chrono::milliseconds::period>(
+                 std::chrono::high_resolution_clock::now() - start)
+                 .count()
+          << " ms\n";
+      std::cout << log.str() << std::flush;
+    }
+  }
+
+  if (options.optimizeMeshes) {
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+    OverdrawStats overdrawBefore{};
+    if (options.reportOverdraw) {
+      overdrawBefore = analyzeOverdraw(vertices, indices);
+    }
+    optimize();
+    VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+    std::ostringstream log;
+    log << filepath << ": vertex cache ACMR " << before.acmr << " -> "
+        << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr;
+    if (options.reportOverdraw) {
+      log << ", overdraw " << overdrawBefore.overdraw << " -> "
+          << analyzeOverdraw(vertices, indices).overdraw;
+    }
+    log << '\n';
+    std::cout << log.str() << std::flush;
+  }
+
+  meshlets = {};
+  if (options.generateMeshlets) {
+    meshlets = buildMeshlets(vertices, indices);
+  }
+  // an empty mesh has no meshlets to average over
+  if (!meshlets.meshlets.empty()) {
+    MeshletCullStats culled = sampleMeshletCulling(meshlets.meshlets);
+    float meshletCount = static_cast<float>(meshlets.meshlets.size());
+    std::ostringstream log;
+    log << filepath << ": " << meshlets.meshlets.size() << " meshlets ("
+        << static_cast<float>(meshlets.vertices.size()) / meshletCount
+        << " vertices, "
+        << static_cast<float>(indices.size() / 3) / meshletCount
+        << " triangles on average), culling rejects "
+        << 100.f * culled.rejectedFraction() << "% of triangles over "
+        << culled.meshlets / meshlets.meshlets.size() << " views\n";
+    std::cout << log.str() << std::flush;
+  }
+
+  lods.clear();
+  if (options.generateLods) {
+    generateLods();
+    std::ostringstream log;
+    log << filepath << ": " << lods.size() << " levels of detail";
+    for (const Lod &lod : lods) {
+      log << (&lod == lods.data() ? " (" : ", ") << lod.indexCount / 3
+          << " triangles at error " << lod.error;
+    }
+    log << ")\n";
+    std::cout << log.str() << std::flush;
+  }
+
+  packedVertices.clear();
+  packedTangents.clear();
+  if (options.quantizeVertices) {
+    QuantizationError error = quantizeVertices();
+    std::ostringstream log;
+    log << filepath << ": quantized " << sizeof(Vertex) << " to "
+        << sizeof(PackedVertex) << " bytes per vertex, max error position "
+        << error.position << ", normal " << error.normal << " degrees, uv "
+        << error.uv << ", color " << error.color;
+    if (!tangents.empty()) {
+      log << ", tangent " << error.tangent << " degrees";
+    }
+    log << '\n';
+    std::cout << log.str() << std::flush;
+  }
+}
+
+size_t Model::Builder::generateTangentSpace() {
+  size_t normalCount = 0;
+  if (options.normalGeneration != NormalGeneration::None) {
+    normalCount = generateNormals(
+        vertices, indices,
+        options.normalGeneration == NormalGeneration::Missing,
+        options.angleWeightedNormals);
+  }
+  if (options.generateAngleWeightedTangents) {
+    generateAngleWeightedTangents(vertices, indices, tangents);
+  }
+  return normalCount;
+}
+
+void Model::Builder::generateLods() {
+  uint32_t indexCount = static_cast<uint32_t>(indices.size());
+  lods = {{0, indexCount, 0.f}};
+  for (LodLevel &level : buildLodChain(vertices, indices)) {
+    if (options.optimizeMeshes) {
+      optimizeVertexCache(level.indices, vertices.size());
+    }
+    lods.push_back({static_cast<uint32_t>(indices.size()),
+                    static_cast<uint32_t>(level.indices.size()), level.error});
+    indices.insert(indices.end(), level.indices.begin(), level.indices.end());
+  }
+}
+
+void Model::Builder::optimize() {
+  auto optimizeTriangles = [&](std::vector<uint32_t> &triangles,
+                               const std::vector<Vertex> &triangleVertices) {
+    if (options.overdrawThreshold > 0.f) {
+      optimizeOverdraw(triangles, triangleVertices, options.overdrawThreshold);
+    } else {
+      optimizeVertexCache(triangles, triangleVertices.size());
+    }
+  };
+
+  if (subMeshes.size() <= 1) {
+    optimizeTriangles(indices, vertices);
+  } else {
+    // every part is optimized over its own compacted vertices, which keeps
+    // the cost linear in the part instead of in the whole mesh
+    std::vector<uint32_t> localIds(vertices.size(), UINT32_MAX);
+    for (const SubMesh &subMesh : subMeshes) {
+      auto first = indices.begin() + subMesh.firstIndex;
+      std::vector<uint32_t> part(first, first + subMesh.indexCount);
+      std::vector<uint32_t> globalIds;
+      std::vector<Vertex> partVertices;
+      for (uint32_t &index : part) {
+        if (localIds[index] == UINT32_MAX) {
+          localIds[index] = static_cast<uint32_t>(globalIds.size());
+          globalIds.push_back(index);
+          partVertices.push_back(vertices[index]);
+        }
+        index = localIds[index];
+      }
+
+      optimizeTriangles(part, partVertices);
+      for (size_t i = 0; i < part.size(); i++) {
+        first[i] = globalIds[part[i]];
+      }
+      for (uint32_t id : globalIds) {
+        localIds[id] = UINT32_MAX;
+      }
+    }
+  }
+  // keeps the triangle order, so the parts stay where they are
+  std::vector<uint32_t> remap = optimizeVertexFetch(vertices, indices);
+  if (!tangents.empty()) {
+    std::vector<glm::vec4> reordered(vertices.size());
+    for (size_t v = 0; v < remap.size(); v++) {
+      if (remap[v] != UINT32_MAX) {
+        reordered[remap[v]] = tangents[v];
+      }
+    }
+    tangents.swap(reordered);
+  }
+}
+
+Model::QuantizationError Model::Builder::quantizeVertices() {
+  QuantizationError error{};
+  packedVertices.clear();
+  packedTangents.clear();
+  if (vertices.empty()) {
+    return error;
+  }
+
+  glm::vec3 minimum = vertices[0].position;
+  glm::vec3 maximum = minimum;
+  for (const Vertex &vertex : vertices) {
+    minimum = glm::min(minimum, vertex.position);
+    maximum = glm::max(maximum, vertex.position);
+  }
+  quantization.offset = minimum;
+  quantization.scale = maximum - minimum;
+
+  packedVertices.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const Vertex &vertex = vertices[i];
+    PackedVertex &packed = packedVertices[i];
+
+    glm::vec3 decoded;
+    for (int axis = 0; axis < 3; axis++) {
+      float unit = quantization.scale[axis] > 0.f
+                       ? (vertex.position[axis] - minimum[axis]) /
+                             quantization.scale[axis]
+                       : 0.f;
+      packed.position[axis] = static_cast<uint16_t>(
+          std::lround(std::clamp(unit, 0.f, 1.f) * 65535.f));
+      decoded[axis] = minimum[axis] + quantization.scale[axis] *
+                                          packed.position[axis] / 65535.f;
+    }
+    packed.position[3] = 0;
+    error.position =
+        std::max(error.position, glm::length(decoded - vertex.position));
+
+    // an unset normal stays unusable either way, it only has to encode
+    float normalLength = glm::length(vertex.normal);
+    glm::vec3 normal =
+        normalLength > 0.f ? vertex.normal / normalLength : glm::vec3{0.f, 0.f, 1.f};
+    packed.normal = glm::packSnorm2x16(encodeOctahedral(normal));
+    if (normalLength > 0.f) {
+      float cosine = glm::dot(
+          normal, decodeOctahedral(glm::unpackSnorm2x16(packed.normal)));
+      error.normal = std::max(
+          error.normal, glm::degrees(std::acos(std::clamp(cosine, -1.f, 1.f))));
+    }
+
+    packed.uv = glm::packHalf2x16(vertex.uv);
+    glm::vec2 uvError = glm::abs(glm::unpackHalf2x16(packed.uv) - vertex.uv);
+    error.uv = std::max(error.uv, std::max(uvError.x, uvError.y));
+
+    packed.color = glm::packUnorm4x8(glm::vec4{vertex.color, 1.f});
+    glm::vec3 colorError =
+        glm::abs(glm::vec3{glm::unpackUnorm4x8(packed.color)} - vertex.color);
+    error.color = std::max(
+        error.color, std::max(colorError.x, std::max(colorError.y, colorError.z)));
+  }
+
+  packedTangents.resize(tangents.size());
+  for (size_t i = 0; i < tangents.size(); i++) {
+    const glm::vec4 &tangent = tangents[i];
+    packedTangents[i] = glm::packUnorm3x10_1x2(glm::vec4{
+        glm::vec3{tangent} * .5f + .5f, tangent.w < 0.f ? 0.f : 1.f});
+    if (tangent != glm::vec4{0.f}) {
+      glm::vec4 unpacked = glm::unpackUnorm3x10_1x2(packedTangents[i]);
+      float cosine = glm::dot(glm::vec3{tangent},
+                              glm::normalize(glm::vec3{unpacked} * 2.f - 1.f));
+      error.tangent = std::max(
+          error.tangent, glm::degrees(std::acos(std::clamp(cosine, -1.f, 1.f))));
+    }
+  }
+  return error;
+}
+
+namespace {
+
+// Read only stream buffer over a memory range, so tinyobj's istream parser
+// reads the mapped file in place instead of through a buffered ifstream.
+class MemoryStreamBuffer : public std::streambuf {
+public:
+  explicit MemoryStreamBuffer(std::string_view data) {
+    char *begin = const_cast<char *>(data.data());
+    setg(begin, begin, begin + data.size());
+  }
+};
+
+} // namespace
+
+void Model::Builder::loadTinyObj(const std::string &enginePath) {
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
   std::string warn, err;
 
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
-                        enginePath.c_str())) {
+  MappedFile file{enginePath, MappedFile::Access::Sequential};
+  MemoryStreamBuffer buffer{file.view()};
+  std::istream stream{&buffer};
+  // materials are looked up relative to the working directory, as the path
+  // overload of LoadObj does without a base directory
+  tinyobj::MaterialFileReader materialReader{""};
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream,
+                        &materialReader)) {
     throw std::runtime_error(warn + err);
   }
 
   vertices.clear();
   indices.clear();
 
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+  VertexWelder welder{vertices, 0.f, attrib.vertices.size() / 3};
   for (const auto &shape : shapes) {
     for (const auto &index : shape.mesh.indices) {
       Vertex vertex{};
@@ -206,11 +843,7 @@ void Model::Builder::loadModel(const std::string &filepath) {
         };
       }
 
-      if (uniqueVertices.count(vertex) == 0) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-        vertices.push_back(vertex);
-      }
-      indices.push_back(uniqueVertices[vertex]);
+      indices.push_back(welder.weld(vertex));
     }
   }
 }
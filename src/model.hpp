@@ -1,8 +1,11 @@
 #pragma once
 
+#include "bounds.hpp"
 #include "device.hpp"
 #include "buffer.hpp"
+#include "meshlet.hpp"
 
+#include <atomic>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 #include <memory>
@@ -13,6 +16,9 @@
 
 namespace vkEngine {
 
+class VkEngineUploadBatch;
+struct TransformComponent;
+
 class Model {
 public:
 
@@ -22,44 +28,330 @@ public:
     glm::vec3 normal{};
     glm::vec2 uv{};
 
+    // positions at binding 0, the other attributes at binding 1
     static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    // binding 0 only, for passes that bind nothing but the positions
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+    // the vec4 tangent stream at binding 2, location 4, added to the above by
+    // pipelines that read tangents. Only models with hasTangents() have it.
+    static std::vector<VkVertexInputBindingDescription> getTangentBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getTangentAttributeDescriptions();
 
     bool operator==(const Vertex &other) const {
       return position == other.position && color == other.color && normal == other.normal && uv == other.uv;
     }
   };
 
+  // 20 byte alternative to Vertex. Positions are unorm16 relative to the mesh
+  // bounds (see Quantization), normals octahedral snorm16, uvs half floats
+  // and colors unorm8. Tangents are packed into a stream of their own as unorm
+  // 10:10:10:2 mapped from [-1, 1].
+  struct PackedVertex {
+    uint16_t position[4]; // w is padding
+    uint32_t normal;
+    uint32_t uv;
+    uint32_t color;
+
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+    static std::vector<VkVertexInputBindingDescription> getTangentBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getTangentAttributeDescriptions();
+  };
+
+  // Maps packed positions, as the unorm fetch returns them in [0, 1], back to
+  // model space as offset + scale * position.
+  struct Quantization {
+    glm::vec3 offset{0.f};
+    glm::vec3 scale{1.f};
+
+    // applied before the model matrix, so the shader never dequantizes
+    glm::mat4 matrix() const;
+  };
+
+  // largest differences between the packed and the full vertices
+  struct QuantizationError {
+    float position = 0.f; // model units
+    float normal = 0.f;   // degrees
+    float uv = 0.f;
+    float color = 0.f;
+    float tangent = 0.f; // degrees
+  };
+
+  // which vertex normals generateNormals() computes
+  enum class NormalGeneration : uint32_t {
+    None,    // keep the loaded normals, zero where the source has none
+    Missing, // fill in the normals the source does not have
+    All,     // replace the loaded normals, e.g. to angle weight a scan
+  };
+
+  // how a model file is turned into mesh data
+  struct LoadOptions {
+    // OBJ files are parsed on all cores unless this is cleared, in which case
+    // the single threaded tinyobj path is used
+    bool parallelObjParsing = true;
+    // reorder loaded meshes for vertex cache reuse and fetch locality
+    bool optimizeMeshes = true;
+    // ACMR the overdraw pass may give up for smaller triangle clusters, as a
+    // factor of the cache optimized one. 0 skips the overdraw pass.
+    float overdrawThreshold = 1.05f;
+    // log the software rasterized overdraw before and after optimizing, this
+    // costs about as much as the optimization itself
+    bool reportOverdraw = false;
+    // split the mesh into meshlets with culling bounds
+    bool generateMeshlets = false;
+    // smooth vertex normals for sources without them, like OBJ faces without
+    // normal indices. Shared by every vertex at the same position.
+    NormalGeneration normalGeneration = NormalGeneration::Missing;
+    // weigh the faces around a vertex by their corner angle instead of their
+    // area, which keeps long thin triangles from dominating
+    bool angleWeightedNormals = true;
+    // angle weighted tangents from the normals and uvs, splitting vertices
+    // whose triangles disagree on the handedness. Replaces the source's
+    // tangents, see generateAngleWeightedTangents()
+    bool generateAngleWeightedTangents = false;
+    // build a chain of simplified levels of detail. Only pays for dense
+    // meshes seen from a distance, for small ones it costs cook time and index
+    // memory for levels that are never drawn
+    bool generateLods = false;
+    // upload PackedVertex instead of Vertex, less than half the memory and
+    // bandwidth for a small loss of precision
+    bool quantizeVertices = false;
+    // compress the cooked mesh cache entry, trading decode time for a
+    // fraction of the disk reads. A compressed entry is decoded into memory
+    // of its own instead of being copied straight out of the mapping, so it
+    // is only worth it where reads are slower than decoding
+    bool compressCache = false;
+  };
+
+  // A level of detail, a range of the index buffer over the shared vertices.
+  struct Lod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // distance from the full mesh in model units, as estimated by the
+    // simplifier
+    float error;
+  };
+
+  // A primitive of a multi-part source like glTF, a range of the full
+  // mesh's indices. Indices are rebased onto the shared vertex buffer, so a
+  // sub-mesh draws with a vertex offset of 0.
+  struct SubMesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+  };
+
   struct Builder {
     std::vector<Vertex> vertices{};
-    std::vector<uint16_t> indices{};
+    // always built as 32 bit, the Model narrows them when the mesh allows.
+    // Holds every level of detail back to back once they are generated.
+    std::vector<uint32_t> indices{};
+    MeshletData meshlets{};
+    // empty, or one entry per level with the full mesh first
+    std::vector<Lod> lods{};
+    // empty for single part sources, otherwise ranges of the full mesh in
+    // file order that together cover it
+    std::vector<SubMesh> subMeshes{};
+    // empty, or one per vertex when the source has tangents or they are
+    // generated. w is the handedness: the bitangent is
+    // w * cross(normal, tangent.xyz). Kept out of Vertex so meshes without
+    // them do not pay for the stream.
+    std::vector<glm::vec4> tangents{};
+    // filled from vertices and tangents by quantizeVertices()
+    std::vector<PackedVertex> packedVertices{};
+    std::vector<uint32_t> packedTangents{};
+    Quantization quantization{};
+
+    LoadOptions options{};
 
     void loadModel(const std::string &filepath);
+    // Reorders triangles for the post-transform vertex cache and overdraw,
+    // then vertices into first use order. Does not change what is rendered.
+    // Triangles stay within their sub-mesh.
+    void optimize();
+
+    // Computes normals as options.normalGeneration asks, then tangents if
+    // options.generateAngleWeightedTangents is set. Runs on all cores,
+    // returns the number of normals written.
+    size_t generateTangentSpace();
+    // Appends the simplified levels to indices.
+    void generateLods();
+    // Packs vertices into packedVertices and tangents into packedTangents,
+    // returns the precision lost.
+    QuantizationError quantizeVertices();
+
+    // The single threaded OBJ parser loadModel() falls back to without
+    // options.parallelObjParsing, public for comparing it with
+    // loadObjParallel(). enginePath already includes ENGINE_DIR.
+    void loadTinyObj(const std::string &enginePath);
+  };
+
+  struct MeshData;
+
+  // Writes a mesh straight into the staging buffers of its upload, for
+  // sources whose data is close enough to the GPU layout that building a
+  // Builder first would only add a copy (see openGlbSource()).
+  class MeshSource {
+  public:
+    virtual ~MeshSource() = default;
+
+    // counts, index type and sub-meshes, with source set to this
+    virtual MeshData getMeshData() const = 0;
+    // MeshData::vertexCount positions
+    virtual void writePositions(glm::vec3 *positions) const = 0;
+    // MeshData::vertexCount times the Vertex members after the position, in
+    // their Vertex layout
+    virtual void writeAttributes(void *attributes) const = 0;
+    // MeshData::vertexCount tangents, only called with MeshData::hasTangents
+    virtual void writeTangents(glm::vec4 *tangents) const = 0;
+    // MeshData::indexCount indices of MeshData::indexType
+    virtual void writeIndices(void *indices) const = 0;
+    virtual Bounds getBounds() const = 0;
   };
 
+  // GPU ready mesh data that is uploaded as is, e.g. a view into a mapped
+  // mesh cache file
+  struct MeshData {
+    // exactly one of vertices, packedVertices and source is set. A source
+    // also provides the indices.
+    const Vertex *vertices = nullptr;
+    const PackedVertex *packedVertices = nullptr;
+    Quantization quantization{};
+    uint32_t vertexCount = 0;
+    // optional. With hasTangents, tangents go with vertices, packedTangents
+    // with packedVertices and a source writes its own.
+    bool hasTangents = false;
+    const glm::vec4 *tangents = nullptr;
+    const uint32_t *packedTangents = nullptr;
+    const void *indices = nullptr;
+    uint32_t indexCount = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+    // optional, meshletCount is 0 when the mesh has none
+    const Meshlet *meshlets = nullptr;
+    uint32_t meshletCount = 0;
+    const uint32_t *meshletVertices = nullptr;
+    uint32_t meshletVertexCount = 0;
+    const uint8_t *meshletTriangles = nullptr;
+    uint32_t meshletTriangleBytes = 0;
+
+    // optional, without levels the whole index buffer is the only one
+    const Lod *lods = nullptr;
+    uint32_t lodCount = 0;
+
+    // optional, without sub-meshes the full mesh is the only one
+    const SubMesh *subMeshes = nullptr;
+    uint32_t subMeshCount = 0;
+
+    const MeshSource *source = nullptr;
+  };
+
+  // Creates an empty model that is not resident until upload() is called,
+  // so it can be handed out before its file has been loaded.
+  explicit Model(VkEngineDevice &device);
   Model(VkEngineDevice &device, Model::Builder & builder);
+  Model(VkEngineDevice &device, const MeshData &data);
   ~Model();
 
   Model(const Model &) = delete;
   Model &operator=(const Model &) = delete;
 
+  // Prefers the cooked mesh cache and falls back to parsing the source file,
+  // cooking it for the next launch.
   static std::unique_ptr<Model> createModelFromFile(VkEngineDevice &device, const std::string &filepath); 
+  static std::unique_ptr<Model> createModelFromFile(VkEngineDevice &device, const std::string &filepath, const LoadOptions &options);
+
+  // narrowest index type able to address every vertex of a mesh
+  static VkIndexType getIndexType(size_t vertexCount);
+  static size_t getIndexSize(VkIndexType indexType);
+  // converts indices to the layout of indexType, as consumed by the GPU
+  static std::vector<uint8_t> packIndices(const std::vector<uint32_t> &indices,
+                                          VkIndexType indexType);
+  // view of a builder's data with its indices packed by packIndices
+  static MeshData getMeshData(const Builder &builder, const void *packedIndices,
+                              VkIndexType indexType);
 
+  // Creates the GPU buffers and waits for their copies. Must be called from
+  // the thread that submits to the device's queues.
+  void upload(const MeshData &data);
+  // Records the copies into batch, the model becomes resident once the batch
+  // completes. data only has to stay valid until this returns.
+  void upload(const MeshData &data, VkEngineUploadBatch &batch);
+  bool isResident() const { return resident.load(std::memory_order_acquire); }
+  // Makes this model resident with the GPU buffers of a resident model of
+  // the same mesh, e.g. a copy of its file, instead of an upload of its own.
+  // The buffers live until both models are gone.
+  void shareMesh(const Model &other);
+
+  // The vertices live in two streams, positions and everything else, so a
+  // depth only pass can fetch just the positions. Tangents, where the model
+  // has them, are bound as a third stream.
   void bind(VkCommandBuffer commandBuffer);
-  void draw(VkCommandBuffer commandBuffer);
+  // binds the position stream and the indices, for pipelines made with
+  // getPositionBindingDescriptions()
+  void bindPositions(VkCommandBuffer commandBuffer);
+  void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+  // draws one part of the full mesh, levels of detail span every part
+  void drawSubMesh(VkCommandBuffer commandBuffer, uint32_t subMesh);
+
+  bool isQuantized() const { return quantized; }
+  bool hasTangents() const { return tangentBuffer != nullptr; }
+  // identity unless the model is quantized
+  const Quantization &getQuantization() const { return quantization; }
+
+  // Levels of detail from full to coarsest, at least one once resident.
+  const std::vector<Lod> &getLods() const { return lods; }
+  // Parts of the full mesh, at least one once resident.
+  const std::vector<SubMesh> &getSubMeshes() const { return subMeshes; }
+  // box and sphere in model space, computed from the vertices on upload
+  const Bounds &getBounds() const { return bounds; }
+  Bounds getWorldBounds(const glm::mat4 &modelMatrix) const {
+    return bounds.transformed(modelMatrix);
+  }
+  Bounds getWorldBounds(const TransformComponent &transform) const;
+
+  // Meshlets are kept on the CPU for reference culling and in storage
+  // buffers for a culling pass. The buffers are null without meshlets.
+  const std::vector<Meshlet> &getMeshlets() const { return meshlets; }
+  VkEngineBuffer *getMeshletBuffer() const { return meshletBuffer.get(); }
+  VkEngineBuffer *getMeshletVertexBuffer() const { return meshletVertexBuffer.get(); }
+  VkEngineBuffer *getMeshletTriangleBuffer() const { return meshletTriangleBuffer.get(); }
 
 private:
-  void createVertexBuffers(const std::vector<Vertex> &vertices);
-  void createIndexBuffers(const std::vector<uint16_t> &indices);
+  void createVertexBuffers(VkEngineUploadBatch &batch, const MeshData &data);
+  void createIndexBuffers(VkEngineUploadBatch &batch, const MeshData &data);
+  void createMeshletBuffers(VkEngineUploadBatch &batch, const MeshData &data);
+  std::unique_ptr<VkEngineBuffer> createStorageBuffer(VkEngineUploadBatch &batch,
+                                                      const void *data,
+                                                      VkDeviceSize size);
 
   VkEngineDevice &vkEngineDevice;
+  std::atomic<bool> resident{false};
 
-  std::unique_ptr<VkEngineBuffer> vertexBuffer;
+  // shared with the models of shareMesh()
+  std::shared_ptr<VkEngineBuffer> positionBuffer;
+  std::shared_ptr<VkEngineBuffer> attributeBuffer;
+  std::shared_ptr<VkEngineBuffer> tangentBuffer;
   uint32_t vertexCount;
+  bool quantized = false;
+  Quantization quantization{};
 
   bool hasIndexBuffer = false;
-  std::unique_ptr<VkEngineBuffer> indexBuffer;
+  std::shared_ptr<VkEngineBuffer> indexBuffer;
   uint32_t indexCount;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+
+  std::vector<Lod> lods;
+  std::vector<SubMesh> subMeshes;
+  Bounds bounds{};
+
+  std::vector<Meshlet> meshlets;
+  std::shared_ptr<VkEngineBuffer> meshletBuffer;
+  std::shared_ptr<VkEngineBuffer> meshletVertexBuffer;
+  std::shared_ptr<VkEngineBuffer> meshletTriangleBuffer;
 };
 
 } // namespace vkEngine
@@ -0,0 +1,165 @@
+#include "model_loader.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace vkEngine {
+
+ModelLoader::ModelLoader(VkEngineDevice &device, size_t threadCount)
+    : vkEngineDevice{device} {
+  threadCount = std::max<size_t>(1, threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    workers.emplace_back(&ModelLoader::workerLoop, this);
+  }
+}
+
+ModelLoader::~ModelLoader() {
+  for (auto &batch : inFlight) {
+    batch->wait();
+  }
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  requestAdded.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+ModelLoader::Handle ModelLoader::load(const std::string &filepath,
+                                      const Model::LoadOptions &options,
+                                      MeshMatcher findShared) {
+  auto model = std::make_shared<Model>(vkEngineDevice);
+  auto resident = std::make_shared<std::promise<void>>();
+  Handle handle{model, resident->get_future().share()};
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    requests.push_back({model, filepath, options, std::move(resident),
+                        std::move(findShared)});
+    pendingCount++;
+  }
+  requestAdded.notify_one();
+  return handle;
+}
+
+size_t ModelLoader::flushUploads(VkDeviceSize budget) {
+  size_t residentBefore = residentCount;
+  while (!inFlight.empty() && inFlight.front()->poll()) {
+    inFlight.pop_front();
+  }
+
+  // copies of another model wait for it without an upload of their own
+  for (auto it = sharing.begin(); it != sharing.end();) {
+    it = finishShared(*it) ? sharing.erase(it) : std::next(it);
+  }
+
+  // everything parsed since the last flush goes out in one submission
+  auto batch = std::make_unique<VkEngineUploadBatch>(vkEngineDevice);
+  while (batch->empty() || batch->getStagedBytes() < budget) {
+    Parsed next;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (parsed.empty()) {
+        break;
+      }
+      next = std::move(parsed.front());
+      parsed.pop_front();
+    }
+
+    if (next.request.model.use_count() == 1) {
+      std::lock_guard<std::mutex> lock{mutex};
+      pendingCount--;
+      continue; // nobody holds the model anymore
+    }
+    if (next.shared.model) {
+      if (!finishShared(next)) {
+        sharing.push_back(std::move(next));
+      }
+      continue;
+    }
+
+    // the mapped or parsed mesh is released here, the batch owns the staging
+    // copy and the model is kept alive until its copies are done
+    next.request.model->upload(next.mesh->data, *batch);
+    batch->onComplete([this, request = std::move(next.request)]() {
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        pendingCount--;
+      }
+      residentCount++;
+      request.resident->set_value();
+    });
+  }
+
+  if (!batch->empty()) {
+    batch->submit();
+    inFlight.push_back(std::move(batch));
+  }
+  return residentCount - residentBefore;
+}
+
+bool ModelLoader::finishShared(Parsed &next) {
+  std::shared_future<void> &shared = next.shared.resident;
+  if (shared.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+    return false;
+  }
+  // a copy of a file that failed to load fails the same way
+  try {
+    shared.get();
+    next.request.model->shareMesh(*next.shared.model);
+    residentCount++;
+    next.request.resident->set_value();
+  } catch (...) {
+    next.request.resident->set_exception(std::current_exception());
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  pendingCount--;
+  return true;
+}
+
+size_t ModelLoader::getPendingCount() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return pendingCount;
+}
+
+void ModelLoader::workerLoop() {
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      requestAdded.wait(lock, [this] { return stopping || !requests.empty(); });
+      if (stopping) {
+        return;
+      }
+      request = std::move(requests.front());
+      requests.pop_front();
+    }
+
+    std::unique_ptr<PreparedMesh> mesh;
+    Handle shared;
+    try {
+      if (request.findShared) {
+        shared = request.findShared();
+      }
+      if (!shared.model) {
+        mesh = prepareMesh(request.filepath, request.options);
+      }
+    } catch (const std::exception &e) {
+      // the model stays non resident, the rest of the scene keeps loading
+      std::cerr << request.filepath << ": failed to load, " << e.what()
+                << std::endl;
+      request.resident->set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock{mutex};
+      pendingCount--;
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    parsed.push_back({std::move(request), std::move(mesh), std::move(shared)});
+  }
+}
+
+} // namespace vkEngine
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "device.hpp"
+#include "mesh_cache.hpp"
+#include "model.hpp"
+#include "upload_context.hpp"
+
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vkEngine {
+
+// Loads models in the background. load() returns a model right away that
+// stays non resident until its file has been parsed on a worker thread and
+// flushUploads() has created its GPU buffers on the main thread, so renderers
+// only have to skip models that are not resident yet.
+class ModelLoader {
+public:
+  // A model that is not loaded yet and the future of its load. resident
+  // becomes ready once the model is, or holds the exception that stopped the
+  // load. Loads dropped because nobody held the model end in a
+  // broken_promise. flushUploads() completes the loads, so the thread that
+  // calls it can poll resident but must not block on it.
+  struct Handle {
+    std::shared_ptr<Model> model;
+    std::shared_future<void> resident;
+  };
+
+  // Runs on a worker before the file is parsed. Returns a model with the
+  // same mesh, whose GPU buffers the load then shares (see
+  // Model::shareMesh()), or no model to parse and upload the file.
+  using MeshMatcher = std::function<Handle()>;
+
+  // staged bytes per flush, at least one model is uploaded per flush
+  static constexpr VkDeviceSize DEFAULT_UPLOAD_BUDGET = 64 * 1024 * 1024;
+
+  // a load already parses on all cores, so a couple of workers are enough to
+  // overlap file I/O with parsing
+  explicit ModelLoader(VkEngineDevice &device, size_t threadCount = 2);
+  ~ModelLoader();
+
+  ModelLoader(const ModelLoader &) = delete;
+  ModelLoader &operator=(const ModelLoader &) = delete;
+
+  Handle load(const std::string &filepath,
+              const Model::LoadOptions &options = {},
+              MeshMatcher findShared = {});
+
+  // Records the uploads of parsed models into one batch until the budget is
+  // used up and submits it without waiting. Must be called from the thread
+  // that submits to the device's queues, once per frame. Returns the number
+  // of models whose earlier uploads completed, making them resident.
+  size_t flushUploads(VkDeviceSize budget = DEFAULT_UPLOAD_BUDGET);
+
+  // models that were requested but are not resident yet
+  size_t getPendingCount() const;
+
+private:
+  struct Request {
+    std::shared_ptr<Model> model;
+    std::string filepath;
+    Model::LoadOptions options;
+    // shared, so the completion callback holding it can be copied
+    std::shared_ptr<std::promise<void>> resident;
+    MeshMatcher findShared;
+  };
+
+  // either a mesh to upload or a model to share
+  struct Parsed {
+    Request request;
+    std::unique_ptr<PreparedMesh> mesh;
+    Handle shared;
+  };
+
+  void workerLoop();
+  // false while the shared model is still loading
+  bool finishShared(Parsed &parsed);
+
+  VkEngineDevice &vkEngineDevice;
+
+  mutable std::mutex mutex;
+  std::condition_variable requestAdded;
+  std::deque<Request> requests;
+  std::deque<Parsed> parsed;
+  size_t pendingCount = 0;
+  bool stopping = false;
+
+  std::vector<std::thread> workers;
+
+  // main thread only
+  std::deque<std::unique_ptr<VkEngineUploadBatch>> inFlight;
+  std::deque<Parsed> sharing;
+  size_t residentCount = 0;
+};
+
+} // namespace vkEngine
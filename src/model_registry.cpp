@@ -0,0 +1,194 @@
+#include "model_registry.hpp"
+#include "mapped_file.hpp"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace vkEngine {
+
+namespace {
+
+bool isUnchanged(const std::string &path, const SourceStamp &stamp) {
+  SourceStamp current = stampSource(path);
+  return current.size == stamp.size &&
+         current.modifiedTime == stamp.modifiedTime;
+}
+
+} // namespace
+
+ModelRegistry::ModelRegistry(ModelLoader &loader)
+    : modelLoader{loader}, index{std::make_shared<Index>()} {}
+
+ModelLoader::Handle ModelRegistry::load(const std::string &filepath,
+                                        const Model::LoadOptions &options) {
+  // the cache compression does not change the model
+  Model::LoadOptions meshOptions = options;
+  meshOptions.compressCache = false;
+  uint64_t optionsHash = MeshCache::getOptionsHash(meshOptions);
+  Source source{};
+  try {
+    source.path =
+        std::filesystem::weakly_canonical(ENGINE_DIR + filepath).string();
+    source.stamp = stampSource(source.path);
+  } catch (const std::filesystem::filesystem_error &) {
+    // not interned, the loader reports the missing file
+    std::lock_guard<std::mutex> lock{index->mutex};
+    index->stats.misses++;
+    return modelLoader.load(filepath, options);
+  }
+  source.optionsHash = optionsHash;
+  std::string key = std::to_string(optionsHash) + ':' + source.path;
+
+  std::lock_guard<std::mutex> lock{index->mutex};
+  auto found = index->sources.find(key);
+  // an edited file is loaded again, whoever holds the old model keeps it
+  if (found != index->sources.end() &&
+      found->second.stamp.size == source.stamp.size &&
+      found->second.stamp.modifiedTime == source.stamp.modifiedTime) {
+    if (auto model = found->second.model.lock()) {
+      index->stats.pathHits++;
+      return {model, found->second.resident};
+    }
+  }
+
+  removeExpired();
+  // the worker looks for a copy before it parses, and finds this source
+  // registered since the lock is held until it is
+  source.loadId = index->nextLoadId++;
+  ModelLoader::Handle handle = modelLoader.load(
+      filepath, options,
+      [index = index, key]() { return findContent(*index, key); });
+  source.model = handle.model;
+  source.resident = handle.resident;
+  index->sources[key] = std::move(source);
+  return handle;
+}
+
+ModelRegistry::Stats ModelRegistry::getStats() const {
+  std::lock_guard<std::mutex> lock{index->mutex};
+  Stats current = index->stats;
+  // several paths can share one model
+  std::unordered_set<const Model *> live;
+  for (const auto &entry : index->sources) {
+    if (auto model = entry.second.model.lock()) {
+      live.insert(model.get());
+    }
+  }
+  current.liveModels = live.size();
+  return current;
+}
+
+ModelLoader::Handle ModelRegistry::findContent(Index &index,
+                                               const std::string &key) {
+  // copied out, so the files are hashed and compared without the lock
+  Source source;
+  std::vector<std::pair<std::string, Source>> candidates;
+  {
+    std::lock_guard<std::mutex> lock{index.mutex};
+    auto found = index.sources.find(key);
+    if (found == index.sources.end()) {
+      // replaced by a later load of the edited file
+      index.stats.misses++;
+      return {};
+    }
+    source = found->second;
+    for (const auto &entry : index.sources) {
+      const Source &other = entry.second;
+      // files of different sizes cannot match, so most loads never hash
+      if (other.optionsHash == source.optionsHash &&
+          other.stamp.size == source.stamp.size &&
+          other.path != source.path && other.loadId < source.loadId &&
+          !other.model.expired()) {
+        candidates.push_back(entry);
+      }
+    }
+  }
+
+  // hashes are kept for the next copy of the same size
+  auto storeHash = [&](const std::string &sourceKey, const Source &hashed) {
+    std::lock_guard<std::mutex> lock{index.mutex};
+    auto found = index.sources.find(sourceKey);
+    if (found != index.sources.end() &&
+        found->second.loadId == hashed.loadId) {
+      found->second.hash = hashed.hash;
+    }
+  };
+
+  ModelLoader::Handle match;
+  for (auto &[otherKey, other] : candidates) {
+    if (!source.hash) {
+      source.hash = hashUnchanged(source);
+      if (!source.hash) {
+        break;
+      }
+      storeHash(key, source);
+    }
+    if (!other.hash) {
+      other.hash = hashUnchanged(other);
+      storeHash(otherKey, other);
+    }
+    // the 64 bit hash only rules out files, a match is compared byte by byte
+    if (other.hash == source.hash && sameContents(source, other)) {
+      if (std::shared_ptr<Model> model = other.model.lock()) {
+        match = {model, other.resident};
+        break;
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock{index.mutex};
+  if (match.model) {
+    index.stats.contentHits++;
+  } else {
+    index.stats.misses++;
+  }
+  return match;
+}
+
+std::optional<uint64_t> ModelRegistry::hashUnchanged(const Source &source) {
+  try {
+    // the contents hashed now have to be the ones the model was loaded from
+    if (isUnchanged(source.path, source.stamp)) {
+      return hashSource(source.path);
+    }
+  } catch (const std::runtime_error &) {
+    // the file went away since it was stamped
+  }
+  return std::nullopt;
+}
+
+bool ModelRegistry::sameContents(const Source &a, const Source &b) {
+  try {
+    if (!isUnchanged(a.path, a.stamp) || !isUnchanged(b.path, b.stamp)) {
+      return false;
+    }
+    MappedFile fileA{a.path, MappedFile::Access::Sequential};
+    MappedFile fileB{b.path, MappedFile::Access::Sequential};
+    return fileA.size() == fileB.size() &&
+           (fileA.size() == 0 ||
+            std::memcmp(fileA.data(), fileB.data(), fileA.size()) == 0);
+  } catch (const std::runtime_error &) {
+    return false;
+  }
+}
+
+void ModelRegistry::removeExpired() {
+  for (auto it = index->sources.begin(); it != index->sources.end();) {
+    if (it->second.model.expired()) {
+      it = index->sources.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+} // namespace vkEngine
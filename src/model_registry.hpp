@@ -0,0 +1,89 @@
+#pragma once
+
+#include "mesh_cache.hpp"
+#include "model.hpp"
+#include "model_loader.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace vkEngine {
+
+// Interns the models of a ModelLoader, so a file loaded again, under any path
+// or as a copy with the same contents, shares the model that is already
+// loaded or loading instead of being parsed, uploaded and held twice. Only
+// weak references are kept: a model and its GPU buffers are released with
+// the last handle, the next load of its file is a miss again.
+class ModelRegistry {
+public:
+  struct Stats {
+    // loads that found the model of the same file
+    uint64_t pathHits = 0;
+    // loads that share the GPU buffers of another file with the same
+    // contents, counted once a worker has compared them
+    uint64_t contentHits = 0;
+    // loads the loader parsed
+    uint64_t misses = 0;
+    // models still held by someone
+    size_t liveModels = 0;
+  };
+
+  explicit ModelRegistry(ModelLoader &loader);
+
+  ModelRegistry(const ModelRegistry &) = delete;
+  ModelRegistry &operator=(const ModelRegistry &) = delete;
+
+  // Same as ModelLoader::load, returning the live model for the file and the
+  // options that change its mesh, and the future of its load, if there is
+  // one. Copies are found on the loader's worker before the file is parsed:
+  // a file is hashed the first time another live model's source has the
+  // same size, and a matching hash is confirmed by comparing the files. The
+  // calling thread never reads the file.
+  ModelLoader::Handle load(const std::string &filepath,
+                           const Model::LoadOptions &options = {});
+
+  Stats getStats() const;
+
+private:
+  struct Source {
+    std::string path;
+    uint64_t optionsHash;
+    SourceStamp stamp;
+    // a load only shares the model of an earlier one, so two copies loading
+    // at once cannot wait on each other
+    uint64_t loadId;
+    std::optional<uint64_t> hash;
+    std::weak_ptr<Model> model;
+    std::shared_future<void> resident;
+  };
+
+  // shared with the loads queued on the loader, which can outlive the
+  // registry
+  struct Index {
+    std::mutex mutex;
+    // keyed by canonical path and MeshCache options hash
+    std::unordered_map<std::string, Source> sources;
+    uint64_t nextLoadId = 0;
+    Stats stats{};
+  };
+
+  // Runs on a worker, finds the live model of an earlier load of another
+  // file with the same contents as the source under key. The files are read
+  // without holding the lock.
+  static ModelLoader::Handle findContent(Index &index, const std::string &key);
+  // empty if the file changed since it was stamped or went away
+  static std::optional<uint64_t> hashUnchanged(const Source &source);
+  static bool sameContents(const Source &a, const Source &b);
+  void removeExpired();
+
+  ModelLoader &modelLoader;
+  std::shared_ptr<Index> index;
+};
+
+} // namespace vkEngine
@@ -4,7 +4,6 @@
 
 #include <cassert>
 #include <cstddef>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -24,23 +23,8 @@ Pipeline::Pipeline(VkEngineDevice &device, const std::string &vertFilepath,
   createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
 }
 
-std::vector<char> Pipeline::readFile(const std::string &filePath) {
-
-  std::string enginePath = ENGINE_DIR + filePath;
-  std::ifstream file(enginePath, std::ios::ate | std::ios::binary);
-
-  if (!file.is_open()) {
-    throw std::runtime_error("Falied to open file: " + enginePath);
-  }
-
-  size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
-
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-
-  file.close();
-  return buffer;
+MappedFile Pipeline::readFile(const std::string &filePath) {
+  return MappedFile{ENGINE_DIR + filePath, MappedFile::Access::Sequential};
 }
 
 Pipeline::~Pipeline() {
@@ -61,8 +45,8 @@ void Pipeline::createGraphicsPipeline(const std::string &vertFilepath,
   auto vertCode = readFile(vertFilepath);
   auto fragCode = readFile(fragFilepath);
 
-  createShaderModule(vertCode, &vertShaderModule);
-  createShaderModule(fragCode, &fragShaderModule);
+  createShaderModule(vertCode.view(), &vertShaderModule);
+  createShaderModule(fragCode.view(), &fragShaderModule);
 
   VkPipelineShaderStageCreateInfo shaderStages[2];
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -119,7 +103,7 @@ void Pipeline::createGraphicsPipeline(const std::string &vertFilepath,
   }
 }
 
-void Pipeline::createShaderModule(const std::vector<char> &code,
+void Pipeline::createShaderModule(std::string_view code,
                                   VkShaderModule *shaderModule) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
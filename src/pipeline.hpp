@@ -1,10 +1,12 @@
 #pragma once
 
 #include "device.hpp"
+#include "mapped_file.hpp"
 
 // std
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <sys/types.h>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -48,13 +50,14 @@ public:
   static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
 private:
-  static std::vector<char> readFile(const std::string &filePath);
+  // mapped rather than read, page alignment satisfies SPIR-V's 4 bytes
+  static MappedFile readFile(const std::string &filePath);
 
   void createGraphicsPipeline(const std::string& vertFilepath,
                               const std::string& fragFilepath,
                               const PipelineConfigInfo& configInfo);
 
-  void createShaderModule(const std::vector<char> &code, VkShaderModule* shaderModule);
+  void createShaderModule(std::string_view code, VkShaderModule* shaderModule);
 
   VkEngineDevice &vkEngineDevice;
   VkPipeline graphicsPipeline;
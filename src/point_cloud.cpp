@@ -0,0 +1,156 @@
+#include "point_cloud.hpp"
+#include "loaders/ply_loader.hpp"
+#include "upload_context.hpp"
+#include "utils.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace vkEngine {
+
+namespace {
+
+// points per conversion task
+constexpr size_t BLOCK_SIZE = 16384;
+static_assert(PointCloud::UPLOAD_SLICE_SIZE %
+                      (BLOCK_SIZE * sizeof(PointCloud::Point)) ==
+                  0,
+              "Upload slices have to hold whole blocks");
+
+// Stride of the Weyl sequence i * step mod count, which visits every point
+// once when step is coprime with count. A stride of count over the golden
+// ratio spreads any run of the sequence evenly over the file order, and
+// scanners write their points in scan order.
+uint64_t getLodStep(uint64_t count) {
+  uint64_t step = std::max<uint64_t>(
+      static_cast<uint64_t>(static_cast<double>(count) * 0.6180339887498949),
+      1);
+  while (std::gcd(step, count) != 1) {
+    step++;
+  }
+  return step;
+}
+
+} // namespace
+
+PointCloud::PointCloud(VkEngineDevice &device, const std::string &filepath)
+    : vkEngineDevice{device} {
+  using Clock = std::chrono::high_resolution_clock;
+  auto start = Clock::now();
+
+  PlyFile ply{ENGINE_DIR + filepath};
+  if (ply.getVertexCount() == 0 ||
+      ply.getVertexCount() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("PLY file has no points or too many: " +
+                             filepath);
+  }
+  pointCount = static_cast<uint32_t>(ply.getVertexCount());
+  pointBuffer = std::make_unique<VkEngineBuffer>(
+      vkEngineDevice, sizeof(Point), pointCount,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // Converted straight into staging memory, each slice on all cores while
+  // the one before is copied, so a scan never needs a second copy in memory.
+  uint64_t step = getLodStep(pointCount);
+  std::vector<Aabb> blockBoxes((pointCount + BLOCK_SIZE - 1) / BLOCK_SIZE);
+  size_t slicePoints = UPLOAD_SLICE_SIZE / sizeof(Point);
+  std::unique_ptr<VkEngineUploadBatch> inFlight;
+  for (size_t first = 0; first < pointCount; first += slicePoints) {
+    size_t count = std::min<size_t>(slicePoints, pointCount - first);
+    auto fill = [&](void *staging) {
+      Point *points = static_cast<Point *>(staging);
+      parallelFor((count + BLOCK_SIZE - 1) / BLOCK_SIZE, [&](size_t block) {
+        size_t begin = block * BLOCK_SIZE;
+        size_t end = std::min(begin + BLOCK_SIZE, count);
+        Aabb box{glm::vec3{std::numeric_limits<float>::max()},
+                 glm::vec3{std::numeric_limits<float>::lowest()}};
+        for (size_t i = begin; i < end; i++) {
+          size_t source = static_cast<size_t>((first + i) * step % pointCount);
+          Point point{ply.readPosition(source), ply.readColor(source)};
+          box.minimum = glm::min(box.minimum, point.position);
+          box.maximum = glm::max(box.maximum, point.position);
+          points[i] = point;
+        }
+        blockBoxes[(first + begin) / BLOCK_SIZE] = box;
+      });
+    };
+
+    auto batch = std::make_unique<VkEngineUploadBatch>(vkEngineDevice);
+    batch->uploadToBuffer(count * sizeof(Point), pointBuffer->getBuffer(),
+                          fill, first * sizeof(Point));
+    batch->submit();
+    if (inFlight) {
+      inFlight->wait();
+    }
+    inFlight = std::move(batch);
+  }
+  inFlight->wait();
+
+  // the sphere around the box, a second pass over the points would read
+  // back the staging memory
+  bounds.box = blockBoxes[0];
+  for (const Aabb &box : blockBoxes) {
+    bounds.box.minimum = glm::min(bounds.box.minimum, box.minimum);
+    bounds.box.maximum = glm::max(bounds.box.maximum, box.maximum);
+  }
+  bounds.sphere = {bounds.box.getCenter(),
+                   glm::length(bounds.box.getExtent()) * .5f};
+
+  float ms = std::chrono::duration<float, std::milli>(Clock::now() - start)
+                 .count();
+  std::ostringstream log;
+  log << filepath << ": " << pointCount << " points ("
+      << static_cast<float>(ply.getFileSize()) / 1e6f << " MB) uploaded in "
+      << ms << " ms, " << static_cast<float>(pointCount) / (ms * 1e3f)
+      << " M points/s\n";
+  std::cout << log.str() << std::flush;
+}
+
+PointCloud::~PointCloud() {}
+
+std::unique_ptr<PointCloud>
+PointCloud::createFromFile(VkEngineDevice &device,
+                           const std::string &filepath) {
+  return std::make_unique<PointCloud>(device, filepath);
+}
+
+void PointCloud::bind(VkCommandBuffer commandBuffer) {
+  VkBuffer buffers[] = {pointBuffer->getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+}
+
+void PointCloud::draw(VkCommandBuffer commandBuffer, uint32_t count) {
+  vkCmdDraw(commandBuffer, std::min(count, pointCount), 1, 0, 0);
+}
+
+std::vector<VkVertexInputBindingDescription>
+PointCloud::Point::getBindingDescriptions() {
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{1};
+  bindingDescriptions[0].binding = 0;
+  bindingDescriptions[0].stride = sizeof(Point);
+  bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription>
+PointCloud::Point::getAttributeDescriptions() {
+  return {
+      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Point, position)},
+      {1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Point, color)},
+  };
+}
+
+} // namespace vkEngine
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "buffer.hpp"
+#include "device.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace vkEngine {
+
+// Points of a scan in one device local buffer, drawn as screen space sized
+// point sprites by PointCloudRenderSystem.
+//
+// The points are stored in a low discrepancy order of the file's points, so
+// every prefix of the buffer is an even subsample of the whole cloud. Levels
+// of detail are just shorter draws, without any extra memory.
+class PointCloud {
+public:
+  // 16 bytes per point
+  struct Point {
+    glm::vec3 position;
+    uint32_t color; // RGBA unorm8, red in the lowest byte
+
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+  };
+
+  // staged bytes per upload submission, a scan's points are converted one
+  // slice at a time while the previous slice is copied
+  static constexpr VkDeviceSize UPLOAD_SLICE_SIZE = 64 * 1024 * 1024;
+
+  PointCloud(VkEngineDevice &device, const std::string &filepath);
+  ~PointCloud();
+
+  PointCloud(const PointCloud &) = delete;
+  PointCloud &operator=(const PointCloud &) = delete;
+
+  // Loads the vertices of a binary PLY file (relative to ENGINE_DIR) and
+  // waits for their upload. Must be called from the thread that submits to
+  // the device's queues.
+  static std::unique_ptr<PointCloud> createFromFile(VkEngineDevice &device,
+                                                    const std::string &filepath);
+
+  uint32_t getPointCount() const { return pointCount; }
+  // box and sphere in model space
+  const Bounds &getBounds() const { return bounds; }
+
+  void bind(VkCommandBuffer commandBuffer);
+  // draws the first count points, an even subsample for any count
+  void draw(VkCommandBuffer commandBuffer, uint32_t count);
+
+private:
+  VkEngineDevice &vkEngineDevice;
+  std::unique_ptr<VkEngineBuffer> pointBuffer;
+  uint32_t pointCount = 0;
+  Bounds bounds{};
+};
+
+} // namespace vkEngine
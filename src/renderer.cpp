@@ -10,8 +10,9 @@
 
 namespace vkEngine {
 
-VkEngineRenderer::VkEngineRenderer(Window &window, VkEngineDevice &device)
-    : window{window}, vkEngineDevice{device} {
+VkEngineRenderer::VkEngineRenderer(Window &window, VkEngineDevice &device,
+                                   bool vsync)
+    : window{window}, vkEngineDevice{device}, vsync{vsync} {
   recreateSwapchain();
   createCommandBuffers();
 }
@@ -28,12 +29,12 @@ void VkEngineRenderer::recreateSwapchain() {
 
   if (vkEngineSwapChain == nullptr) {
     vkEngineSwapChain =
-        std::make_unique<VkEngineSwapChain>(vkEngineDevice, extent);
+        std::make_unique<VkEngineSwapChain>(vkEngineDevice, extent, vsync);
   } else {
     std::shared_ptr<VkEngineSwapChain> oldSwapChain =
         std::move(vkEngineSwapChain);
     vkEngineSwapChain = std::make_unique<VkEngineSwapChain>(
-        vkEngineDevice, extent, oldSwapChain);
+        vkEngineDevice, extent, oldSwapChain, vsync);
     
     if (!oldSwapChain->compareSwapFormats(*vkEngineSwapChain.get())) {
       throw std::runtime_error("Swap Chain image or depth format has changed");
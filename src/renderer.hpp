@@ -13,7 +13,7 @@
 namespace vkEngine {
 class VkEngineRenderer {
 public:
-  VkEngineRenderer(Window &window, VkEngineDevice &device);
+  VkEngineRenderer(Window &window, VkEngineDevice &device, bool vsync = true);
   ~VkEngineRenderer();
 
   VkEngineRenderer(const VkEngineRenderer &) = delete;
@@ -23,6 +23,9 @@ public:
     return vkEngineSwapChain->getRenderPass();
   }
   float getAspectRatio() const {return vkEngineSwapChain->extentAspectRatio();}
+  VkExtent2D getSwapChainExtent() const {
+    return vkEngineSwapChain->getSwapChainExtent();
+  }
   bool isFrameInProgress() const { return isFrameStarted; }
 
   VkCommandBuffer getCurrentCommandBuffer() const {
@@ -48,6 +51,7 @@ private:
 
   Window &window;
   VkEngineDevice &vkEngineDevice;
+  bool vsync;
   std::unique_ptr<VkEngineSwapChain> vkEngineSwapChain;
   std::vector<VkCommandBuffer> commandBuffers;
 
@@ -0,0 +1,73 @@
+#include "ring_buffer.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace vkEngine {
+
+VkEngineRingBuffer::VkEngineRingBuffer(VkEngineDevice &device,
+                                       VkDeviceSize frameBudget,
+                                       uint32_t frameCount)
+    : vkEngineDevice{device}, frameCount{frameCount} {
+  const VkPhysicalDeviceLimits &limits = device.properties.limits;
+  // both are powers of two, so the larger one satisfies either
+  minOffsetAlignment = std::max<VkDeviceSize>(
+      {limits.minUniformBufferOffsetAlignment,
+       limits.minStorageBufferOffsetAlignment, 16});
+  this->frameBudget =
+      (frameBudget + minOffsetAlignment - 1) & ~(minOffsetAlignment - 1);
+  assert(this->frameBudget * frameCount <=
+             std::numeric_limits<uint32_t>::max() &&
+         "Dynamic offsets are 32 bit");
+
+  buffer = std::make_unique<VkEngineBuffer>(
+      vkEngineDevice, this->frameBudget, frameCount,
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+  if (buffer->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map frame ring buffer!");
+  }
+}
+
+VkEngineRingBuffer::~VkEngineRingBuffer() {}
+
+void VkEngineRingBuffer::beginFrame(uint32_t frameIndex) {
+  assert(frameIndex < frameCount && "Frame index out of range");
+  frameStart = frameIndex * frameBudget;
+  head = frameStart;
+}
+
+VkResult VkEngineRingBuffer::flush() {
+  if (head == frameStart) {
+    return VK_SUCCESS;
+  }
+  return buffer->flush(head - frameStart, frameStart);
+}
+
+VkEngineRingBuffer::Allocation
+VkEngineRingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+  if (alignment == 0) {
+    alignment = minOffsetAlignment;
+  }
+  VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+  if (offset + size > frameStart + frameBudget) {
+    throw std::runtime_error("frame ring buffer budget of " +
+                             std::to_string(frameBudget) +
+                             " bytes exceeded");
+  }
+  head = offset + size;
+  peakBytes = std::max(peakBytes, head - frameStart);
+
+  Allocation allocation{};
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mapped = static_cast<char *>(buffer->getMappedMemory()) + offset;
+  return allocation;
+}
+
+} // namespace vkEngine
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vulkan/vulkan_core.h>
+
+namespace vkEngine {
+
+// One persistently mapped buffer for the transient data of every frame in
+// flight: uniforms, storage and vertex data that is written once per frame.
+//
+// Each frame owns a range of frameBudget bytes that is handed out linearly
+// and starts over in beginFrame, once the frame's fence has signaled. The
+// buffer is bound once with dynamic descriptors, and an allocation's offset
+// is the dynamic offset, so no per-frame buffers or descriptor sets are
+// needed.
+class VkEngineRingBuffer {
+public:
+  struct Allocation {
+    // from the start of the buffer, the dynamic offset of descriptors
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+
+    uint32_t getDynamicOffset() const { return static_cast<uint32_t>(offset); }
+  };
+
+  VkEngineRingBuffer(VkEngineDevice &device, VkDeviceSize frameBudget,
+                     uint32_t frameCount);
+  ~VkEngineRingBuffer();
+
+  VkEngineRingBuffer(const VkEngineRingBuffer &) = delete;
+  VkEngineRingBuffer &operator=(const VkEngineRingBuffer &) = delete;
+
+  // Starts handing out frameIndex's range. The commands of the frame that
+  // last used it have to be complete, i.e. its fence has been waited on.
+  void beginFrame(uint32_t frameIndex);
+  // Makes this frame's writes visible to the device, before its submit.
+  VkResult flush();
+
+  // size bytes of the current frame's range. The alignment defaults to the
+  // one required for uniform and storage buffer offsets. Throws when the
+  // frame's budget is used up.
+  Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+  template <typename T> Allocation write(const T &data) {
+    Allocation allocation = allocate(sizeof(T));
+    std::memcpy(allocation.mapped, &data, sizeof(T));
+    return allocation;
+  }
+
+  VkBuffer getBuffer() const { return buffer->getBuffer(); }
+  // for dynamic descriptors, whose offset is given when binding them
+  VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const {
+    return {buffer->getBuffer(), 0, range};
+  }
+  VkDeviceSize getFrameBudget() const { return frameBudget; }
+  // bytes handed out in the current frame, and at most in any frame
+  VkDeviceSize getUsedBytes() const { return head - frameStart; }
+  VkDeviceSize getPeakBytes() const { return peakBytes; }
+
+private:
+  VkEngineDevice &vkEngineDevice;
+  std::unique_ptr<VkEngineBuffer> buffer;
+  VkDeviceSize frameBudget;
+  uint32_t frameCount;
+  VkDeviceSize minOffsetAlignment;
+
+  VkDeviceSize frameStart = 0;
+  VkDeviceSize head = 0;
+  VkDeviceSize peakBytes = 0;
+};
+
+} // namespace vkEngine
@@ -0,0 +1,98 @@
+#include "staging_pool.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace vkEngine {
+
+namespace {
+
+// smallest class whose blocks hold size bytes, CLASS_COUNT when none does
+size_t getSizeClass(VkDeviceSize size) {
+  size_t sizeClass = 0;
+  VkDeviceSize blockSize = VkEngineStagingPool::MIN_BLOCK_SIZE;
+  while (blockSize < size && blockSize < VkEngineStagingPool::MAX_BLOCK_SIZE) {
+    blockSize *= 2;
+    sizeClass++;
+  }
+  return blockSize < size ? sizeClass + 1 : sizeClass;
+}
+
+} // namespace
+
+VkEngineStagingPool::VkEngineStagingPool(VkEngineDevice &device)
+    : vkEngineDevice{device} {
+  // 16 covers the largest texel blocks, the device may prefer more
+  copyAlignment = std::max<VkDeviceSize>(
+      16, device.properties.limits.optimalBufferCopyOffsetAlignment);
+}
+
+VkEngineStagingPool::~VkEngineStagingPool() {}
+
+VkEngineStagingPool::Range VkEngineStagingPool::allocate(Lease &lease,
+                                                         VkDeviceSize size) {
+  VkDeviceSize offset =
+      (lease.head + copyAlignment - 1) & ~(copyAlignment - 1);
+  if (lease.blocks.empty() ||
+      offset + size > lease.blocks.back()->getBufferSize()) {
+    lease.blocks.push_back(acquireBlock(size));
+    offset = 0;
+  }
+  lease.head = offset + size;
+  stats.copies++;
+
+  VkEngineBuffer &block = *lease.blocks.back();
+  return {block.getBuffer(), offset,
+          static_cast<char *>(block.getMappedMemory()) + offset};
+}
+
+void VkEngineStagingPool::release(Lease &lease) {
+  for (auto &block : lease.blocks) {
+    VkDeviceSize size = block->getBufferSize();
+    size_t sizeClass = getSizeClass(size);
+    if (sizeClass == CLASS_COUNT || idleBytes + size > MAX_IDLE_BYTES) {
+      stats.blockCount--;
+      stats.blockBytes -= size;
+      block.reset();
+      continue;
+    }
+    idleBytes += size;
+    stats.idleBlocks++;
+    idleBlocks[sizeClass].push_back(std::move(block));
+  }
+  lease.blocks.clear();
+  lease.head = 0;
+}
+
+std::unique_ptr<VkEngineBuffer>
+VkEngineStagingPool::acquireBlock(VkDeviceSize size) {
+  // an idle block of the class, or of a larger one before creating a block
+  size_t sizeClass = getSizeClass(std::max(size, MIN_BLOCK_SIZE));
+  for (size_t i = sizeClass; i < CLASS_COUNT; i++) {
+    if (!idleBlocks[i].empty()) {
+      std::unique_ptr<VkEngineBuffer> block = std::move(idleBlocks[i].back());
+      idleBlocks[i].pop_back();
+      idleBytes -= block->getBufferSize();
+      stats.idleBlocks--;
+      stats.blocksReused++;
+      return block;
+    }
+  }
+
+  VkDeviceSize blockSize =
+      sizeClass < CLASS_COUNT ? MIN_BLOCK_SIZE << sizeClass : size;
+  auto block = std::make_unique<VkEngineBuffer>(
+      vkEngineDevice, blockSize, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (block->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map staging block!");
+  }
+  stats.blocksCreated++;
+  stats.blockCount++;
+  stats.blockBytes += blockSize;
+  return block;
+}
+
+} // namespace vkEngine
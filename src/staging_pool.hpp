@@ -0,0 +1,87 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vkEngine {
+
+// Persistently mapped staging buffers, recycled across uploads instead of
+// creating a buffer per copy.
+//
+// Blocks come in power of two size classes. An upload batch leases blocks
+// and hands out the ranges of its copies from them one after the other, so
+// small copies share a block. The blocks go back to the pool once the
+// batch's fence has signaled and are reused by later batches. Requests
+// larger than the largest class get a block of their own that is destroyed
+// on release.
+//
+// Like upload batches, only used from the thread that submits to the
+// device's queues.
+class VkEngineStagingPool {
+public:
+  static constexpr VkDeviceSize MIN_BLOCK_SIZE = 1024 * 1024;
+  static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+  // released blocks beyond this many idle bytes are destroyed
+  static constexpr VkDeviceSize MAX_IDLE_BYTES = 256 * 1024 * 1024;
+
+  struct Stats {
+    // staging ranges handed out, each used to be a buffer and allocation
+    uint64_t copies = 0;
+    uint64_t blocksCreated = 0;
+    uint64_t blocksReused = 0;
+    uint32_t blockCount = 0;
+    uint32_t idleBlocks = 0;
+    VkDeviceSize blockBytes = 0;
+  };
+
+  // the staging memory of one batch
+  struct Lease {
+    std::vector<std::unique_ptr<VkEngineBuffer>> blocks;
+    // first free byte of the last block
+    VkDeviceSize head = 0;
+  };
+
+  struct Range {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    void *mapped = nullptr;
+  };
+
+  explicit VkEngineStagingPool(VkEngineDevice &device);
+  ~VkEngineStagingPool();
+
+  VkEngineStagingPool(const VkEngineStagingPool &) = delete;
+  VkEngineStagingPool &operator=(const VkEngineStagingPool &) = delete;
+
+  // size bytes from the lease's last block, or from a block added to it
+  Range allocate(Lease &lease, VkDeviceSize size);
+  // Returns the lease's blocks. The commands reading from them have to be
+  // complete.
+  void release(Lease &lease);
+
+  const Stats &getStats() const { return stats; }
+
+private:
+  static constexpr size_t CLASS_COUNT = 7;
+  static_assert(MIN_BLOCK_SIZE << (CLASS_COUNT - 1) == MAX_BLOCK_SIZE,
+                "Size classes have to span the block sizes");
+
+  std::unique_ptr<VkEngineBuffer> acquireBlock(VkDeviceSize size);
+
+  VkEngineDevice &vkEngineDevice;
+  // offsets of copies, image copies need multiples of the texel size
+  VkDeviceSize copyAlignment;
+
+  std::array<std::vector<std::unique_ptr<VkEngineBuffer>>, CLASS_COUNT>
+      idleBlocks;
+  VkDeviceSize idleBytes = 0;
+  Stats stats{};
+};
+
+} // namespace vkEngine
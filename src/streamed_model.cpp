@@ -0,0 +1,251 @@
+#include "streamed_model.hpp"
+#include "frustum.hpp"
+#include "swap_chain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace vkEngine {
+
+namespace {
+
+constexpr VkDeviceSize POSITION_SIZE = sizeof(glm::vec3);
+constexpr VkDeviceSize ATTRIBUTE_SIZE = sizeof(Model::Vertex) - POSITION_SIZE;
+constexpr VkDeviceSize INDEX_SIZE = sizeof(uint16_t);
+
+VkDeviceSize getChunkBytes(const MeshChunk &chunk) {
+  return chunk.vertexCount * (POSITION_SIZE + ATTRIBUTE_SIZE) +
+         chunk.indexCount * INDEX_SIZE;
+}
+
+} // namespace
+
+StreamedModel::StreamedModel(VkEngineDevice &device,
+                             std::unique_ptr<ChunkedMesh> mesh,
+                             VkDeviceSize poolSize)
+    : vkEngineDevice{device}, mesh{std::move(mesh)} {
+  chunks.resize(this->mesh->getChunkCount());
+  stats.chunkCount = this->mesh->getChunkCount();
+  if (!chunks.empty()) {
+    createPool(poolSize);
+  }
+}
+
+StreamedModel::~StreamedModel() {
+  // the copies read staging buffers owned by the batches
+  for (auto &batch : inFlight) {
+    batch->wait();
+  }
+}
+
+std::unique_ptr<StreamedModel>
+StreamedModel::createFromFile(VkEngineDevice &device,
+                              const std::string &filepath,
+                              VkDeviceSize poolSize,
+                              uint32_t maxChunkTriangles) {
+  return std::make_unique<StreamedModel>(
+      device, ChunkedMesh::open(filepath, maxChunkTriangles), poolSize);
+}
+
+void StreamedModel::createPool(VkDeviceSize poolSize) {
+  const ChunkedMeshHeader &header = mesh->getHeader();
+  slotVertices = std::max(header.maxChunkVertices, 1u);
+  slotIndices = std::max(header.maxChunkIndices, 1u);
+  VkDeviceSize slotBytes = slotVertices * (POSITION_SIZE + ATTRIBUTE_SIZE) +
+                           slotIndices * INDEX_SIZE;
+  // at least one slot, and no more than there are chunks to put in them
+  uint32_t slotCount = static_cast<uint32_t>(std::clamp<VkDeviceSize>(
+      poolSize / slotBytes, 1, mesh->getChunkCount()));
+
+  auto createBuffer = [&](VkDeviceSize slotSize, VkBufferUsageFlags usage) {
+    return std::make_unique<VkEngineBuffer>(
+        vkEngineDevice, slotSize, slotCount,
+        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  };
+  positionPool =
+      createBuffer(slotVertices * POSITION_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  attributePool = createBuffer(slotVertices * ATTRIBUTE_SIZE,
+                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  indexPool =
+      createBuffer(slotIndices * INDEX_SIZE, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+  // handed out from the back, so slot 0 goes first
+  for (uint32_t slot = slotCount; slot-- > 0;) {
+    freeSlots.push_back(slot);
+  }
+  stats.slotCount = slotCount;
+  stats.poolBytes = slotBytes * slotCount;
+}
+
+void StreamedModel::pollUploads() {
+  while (!inFlight.empty() && inFlight.front()->poll()) {
+    inFlight.pop_front();
+  }
+}
+
+bool StreamedModel::acquireSlot(uint32_t &slot, bool evict) {
+  if (!freeSlots.empty()) {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+    return true;
+  }
+  if (!evict || lru.empty()) {
+    return false;
+  }
+
+  // frames still in flight may be drawing a chunk. Completed loads join at
+  // the cold end whenever they were last drawn, so busy chunks are skipped
+  // rather than ending the search.
+  auto entry = std::find_if(lru.rbegin(), lru.rend(), [&](uint32_t chunk) {
+    return chunks[chunk].lastUsedFrame +
+               VkEngineSwapChain::MAX_FRAMES_IN_FLIGHT <
+           frame;
+  });
+  if (entry == lru.rend()) {
+    return false;
+  }
+  uint32_t victim = *entry;
+  ChunkState &state = chunks[victim];
+  lru.erase(state.lruEntry);
+  state.residency = Residency::Absent;
+  slot = state.slot;
+  stats.evictions++;
+  stats.residentBytes -= getChunkBytes(mesh->getChunk(victim));
+  return true;
+}
+
+void StreamedModel::loadChunk(VkEngineUploadBatch &batch, uint32_t chunk,
+                              uint32_t slot) {
+  const MeshChunk &meshChunk = mesh->getChunk(chunk);
+  batch.uploadToBuffer(mesh->getPositions(chunk),
+                       meshChunk.vertexCount * POSITION_SIZE,
+                       positionPool->getBuffer(),
+                       VkDeviceSize{slot} * slotVertices * POSITION_SIZE);
+  batch.uploadToBuffer(mesh->getAttributes(chunk),
+                       meshChunk.vertexCount * ATTRIBUTE_SIZE,
+                       attributePool->getBuffer(),
+                       VkDeviceSize{slot} * slotVertices * ATTRIBUTE_SIZE);
+  batch.uploadToBuffer(mesh->getIndices(chunk),
+                       meshChunk.indexCount * INDEX_SIZE,
+                       indexPool->getBuffer(),
+                       VkDeviceSize{slot} * slotIndices * INDEX_SIZE);
+
+  ChunkState &state = chunks[chunk];
+  state.residency = Residency::Loading;
+  state.slot = slot;
+  stats.loads++;
+  stats.uploadedBytes += getChunkBytes(meshChunk);
+
+  // least recently used until the next update finds it visible
+  batch.onComplete([this, chunk]() {
+    ChunkState &state = chunks[chunk];
+    state.residency = Residency::Resident;
+    state.lruEntry = lru.insert(lru.end(), chunk);
+    stats.residentBytes += getChunkBytes(mesh->getChunk(chunk));
+  });
+}
+
+void StreamedModel::update(const VkEngineCamera &camera,
+                           const glm::mat4 &modelMatrix,
+                           VkDeviceSize uploadBudget) {
+  frame++;
+  pollUploads();
+
+  // the planes are taken to model space, so the chunk spheres are tested as
+  // they are stored
+  Frustum frustum{camera.getProjection() * camera.getView() * modelMatrix};
+  float scale = getMaxScale(modelMatrix);
+  glm::vec3 cameraPosition = camera.getPosition();
+
+  visible.clear();
+  std::vector<std::pair<float, uint32_t>> wanted;
+  std::vector<std::pair<float, uint32_t>> prefetch;
+  stats.visibleChunks = 0;
+  for (uint32_t c = 0; c < chunks.size(); c++) {
+    const MeshChunk &chunk = mesh->getChunk(c);
+    ChunkState &state = chunks[c];
+    glm::vec3 center{modelMatrix * glm::vec4{chunk.center, 1.f}};
+    float distance = std::max(
+        glm::length(center - cameraPosition) - chunk.radius * scale, 0.f);
+
+    if (!frustum.intersectsSphere(chunk.center, chunk.radius)) {
+      if (state.residency == Residency::Absent) {
+        prefetch.emplace_back(distance, c);
+      }
+      continue;
+    }
+
+    stats.visibleChunks++;
+    state.lastUsedFrame = frame;
+    if (state.residency == Residency::Resident) {
+      visible.push_back(c);
+      lru.splice(lru.begin(), lru, state.lruEntry);
+    } else if (state.residency == Residency::Absent) {
+      wanted.emplace_back(distance, c);
+    }
+  }
+  std::sort(wanted.begin(), wanted.end());
+  std::sort(prefetch.begin(), prefetch.end());
+
+  // chunks in view may evict, prefetching only fills free slots
+  std::unique_ptr<VkEngineUploadBatch> batch;
+  VkDeviceSize staged = 0;
+  auto request = [&](const std::vector<std::pair<float, uint32_t>> &queue,
+                     bool evict) {
+    for (const auto &entry : queue) {
+      VkDeviceSize bytes = getChunkBytes(mesh->getChunk(entry.second));
+      uint32_t slot;
+      // the first chunk goes regardless of the budget, so every chunk loads
+      if ((staged > 0 && staged + bytes > uploadBudget) ||
+          !acquireSlot(slot, evict)) {
+        return;
+      }
+      if (!batch) {
+        batch = std::make_unique<VkEngineUploadBatch>(vkEngineDevice);
+      }
+      loadChunk(*batch, entry.second, slot);
+      staged += bytes;
+    }
+  };
+  request(wanted, true);
+  request(prefetch, false);
+  if (batch) {
+    batch->submit();
+    inFlight.push_back(std::move(batch));
+  }
+
+  stats.residentChunks = static_cast<uint32_t>(lru.size());
+  stats.loadingChunks = 0;
+  for (const ChunkState &state : chunks) {
+    if (state.residency == Residency::Loading) {
+      stats.loadingChunks++;
+    }
+  }
+  stats.drawnChunks = static_cast<uint32_t>(visible.size());
+}
+
+void StreamedModel::draw(VkCommandBuffer commandBuffer) {
+  if (visible.empty()) {
+    return;
+  }
+
+  VkBuffer buffers[] = {positionPool->getBuffer(), attributePool->getBuffer()};
+  VkDeviceSize offsets[] = {0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, indexPool->getBuffer(), 0,
+                       VK_INDEX_TYPE_UINT16);
+
+  for (uint32_t c : visible) {
+    const ChunkState &state = chunks[c];
+    assert(state.residency == Residency::Resident &&
+           "Chunk was evicted after the update that found it visible");
+    vkCmdDrawIndexed(commandBuffer, mesh->getChunk(c).indexCount, 1,
+                     state.slot * slotIndices,
+                     static_cast<int32_t>(state.slot * slotVertices), 0);
+  }
+}
+
+} // namespace vkEngine
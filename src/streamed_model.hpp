@@ -0,0 +1,115 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "camera.hpp"
+#include "chunked_mesh.hpp"
+#include "device.hpp"
+#include "upload_context.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vkEngine {
+
+// A mesh too large to keep on the GPU, drawn from a fixed size pool of
+// chunk slots. Every frame the chunks in view are requested nearest first
+// and paged in from the mapped ChunkedMesh, evicting the least recently
+// drawn chunks once the pool is full. Chunks out of view are prefetched by
+// distance into free slots only. Whatever is resident gets drawn, so a
+// missing chunk is a hole for a few frames rather than a stall.
+//
+// Drawn with the pipelines for Model::Vertex, the pool buffers are bound
+// like a Model's streams.
+class StreamedModel {
+public:
+  // device memory for chunks, vertices and indices together
+  static constexpr VkDeviceSize DEFAULT_POOL_SIZE = 256 * 1024 * 1024;
+  // staged bytes per update
+  static constexpr VkDeviceSize DEFAULT_UPLOAD_BUDGET = 16 * 1024 * 1024;
+
+  struct Stats {
+    uint32_t chunkCount = 0;
+    uint32_t slotCount = 0;
+    uint32_t residentChunks = 0;
+    uint32_t loadingChunks = 0;
+    uint32_t visibleChunks = 0;
+    // visible and resident, what the last update leaves draw() to draw
+    uint32_t drawnChunks = 0;
+    VkDeviceSize residentBytes = 0;
+    VkDeviceSize poolBytes = 0;
+    // totals since creation
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+    VkDeviceSize uploadedBytes = 0;
+  };
+
+  StreamedModel(VkEngineDevice &device, std::unique_ptr<ChunkedMesh> mesh,
+                VkDeviceSize poolSize = DEFAULT_POOL_SIZE);
+  ~StreamedModel();
+
+  StreamedModel(const StreamedModel &) = delete;
+  StreamedModel &operator=(const StreamedModel &) = delete;
+
+  // Opens or cooks the chunked form of a model file, see ChunkedMesh::open.
+  static std::unique_ptr<StreamedModel>
+  createFromFile(VkEngineDevice &device, const std::string &filepath,
+                 VkDeviceSize poolSize = DEFAULT_POOL_SIZE,
+                 uint32_t maxChunkTriangles = DEFAULT_CHUNK_TRIANGLES);
+
+  // Picks the chunks to draw for this view and records the uploads of the
+  // missing ones into a batch that is submitted without waiting. Must be
+  // called once per frame, before the frame is recorded, from the thread
+  // that submits to the device's queues.
+  void update(const VkEngineCamera &camera, const glm::mat4 &modelMatrix,
+              VkDeviceSize uploadBudget = DEFAULT_UPLOAD_BUDGET);
+  // binds the pool and draws the chunks the last update found visible and
+  // resident
+  void draw(VkCommandBuffer commandBuffer);
+
+  const Stats &getStats() const { return stats; }
+
+private:
+  enum class Residency : uint8_t { Absent, Loading, Resident };
+
+  struct ChunkState {
+    Residency residency = Residency::Absent;
+    uint32_t slot = 0;
+    // last update that found the chunk visible
+    uint64_t lastUsedFrame = 0;
+    std::list<uint32_t>::iterator lruEntry;
+  };
+
+  void createPool(VkDeviceSize poolSize);
+  void pollUploads();
+  // a free slot, or the slot of the least recently used chunk that no frame
+  // in flight can still be reading. False if there is neither.
+  bool acquireSlot(uint32_t &slot, bool evict);
+  void loadChunk(VkEngineUploadBatch &batch, uint32_t chunk, uint32_t slot);
+
+  VkEngineDevice &vkEngineDevice;
+  std::unique_ptr<ChunkedMesh> mesh;
+
+  // one slot per resident chunk, sized for the largest chunk
+  std::unique_ptr<VkEngineBuffer> positionPool;
+  std::unique_ptr<VkEngineBuffer> attributePool;
+  std::unique_ptr<VkEngineBuffer> indexPool;
+  uint32_t slotVertices = 0;
+  uint32_t slotIndices = 0;
+  std::vector<uint32_t> freeSlots;
+
+  std::vector<ChunkState> chunks;
+  // resident chunks, most recently used first
+  std::list<uint32_t> lru;
+  std::vector<uint32_t> visible;
+  uint64_t frame = 0;
+
+  std::deque<std::unique_ptr<VkEngineUploadBatch>> inFlight;
+  Stats stats{};
+};
+
+} // namespace vkEngine
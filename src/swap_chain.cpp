@@ -1,6 +1,7 @@
 #include "swap_chain.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -14,14 +15,16 @@
 namespace vkEngine {
 
 VkEngineSwapChain::VkEngineSwapChain(VkEngineDevice &deviceRef,
-                                     VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+                                     VkExtent2D extent, bool vsync)
+    : device{deviceRef}, windowExtent{extent}, vsync{vsync} {
   init();
 }
 
 VkEngineSwapChain::VkEngineSwapChain(VkEngineDevice &deviceRef,
-                                     VkExtent2D extent, std::shared_ptr<VkEngineSwapChain> previous)
-    : device{deviceRef}, windowExtent{extent}, oldSwapchain{previous} {
+                                     VkExtent2D extent, std::shared_ptr<VkEngineSwapChain> previous,
+                                     bool vsync)
+    : device{deviceRef}, windowExtent{extent}, vsync{vsync},
+      oldSwapchain{previous} {
   init();
 
   // clean up old swap chain since it's no longer used
@@ -51,7 +54,7 @@ VkEngineSwapChain::~VkEngineSwapChain() {
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.getAllocator().free(depthImageAllocations[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -312,7 +315,7 @@ void VkEngineSwapChain::createDepthResources() {
   VkExtent2D swapChainExtent = getSwapChainExtent();
 
   depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
+  depthImageAllocations.resize(imageCount());
   depthImageViews.resize(imageCount());
 
   for (int i = 0; i < depthImages.size(); i++) {
@@ -332,8 +335,12 @@ void VkEngineSwapChain::createDepthResources() {
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
+    // the depth images are created and destroyed together with the swap
+    // chain, so they bump through linear blocks instead of scattering over
+    // the blocks of long lived images on every resize
     device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                               depthImages[i], depthImageMemorys[i]);
+                               depthImages[i], depthImageAllocations[i],
+                               VkEngineAllocator::Strategy::Linear);
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -407,6 +414,20 @@ VkPresentModeKHR VkEngineSwapChain::chooseSwapPresentMode(
   //   }
   // }
 
+  if (!vsync) {
+    for (VkPresentModeKHR presentMode :
+         {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR}) {
+      if (std::find(availablePresentModes.begin(), availablePresentModes.end(),
+                    presentMode) != availablePresentModes.end()) {
+        std::cout << "Present mode: "
+                  << (presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR ? "Immediate"
+                                                                   : "Mailbox")
+                  << std::endl;
+        return presentMode;
+      }
+    }
+  }
+
   std::cout << "Present mode: V-Sync" << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
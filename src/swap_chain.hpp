@@ -16,9 +16,13 @@ class VkEngineSwapChain {
 public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-  VkEngineSwapChain(VkEngineDevice &deviceRef, VkExtent2D windowExtent);
+  // without vsync, presents do not wait for the display if the surface
+  // supports it
   VkEngineSwapChain(VkEngineDevice &deviceRef, VkExtent2D windowExtent,
-                    std::shared_ptr<VkEngineSwapChain> previous);
+                    bool vsync = true);
+  VkEngineSwapChain(VkEngineDevice &deviceRef, VkExtent2D windowExtent,
+                    std::shared_ptr<VkEngineSwapChain> previous,
+                    bool vsync = true);
   ~VkEngineSwapChain();
 
   VkEngineSwapChain(const VkEngineSwapChain &) = delete;
@@ -74,13 +78,14 @@ private:
   VkRenderPass renderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<VkEngineAllocation> depthImageAllocations;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
   VkEngineDevice &device;
   VkExtent2D windowExtent;
+  bool vsync;
 
   VkSwapchainKHR swapChain;
   std::shared_ptr<VkEngineSwapChain> oldSwapchain;
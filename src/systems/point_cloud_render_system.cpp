@@ -0,0 +1,142 @@
+#include "point_cloud_render_system.hpp"
+#include "camera.hpp"
+#include "frustum.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <glm/gtc/constants.hpp>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vkEngine {
+
+struct PointCloudPushConstantData {
+    glm::mat4 modelMatrix{1.f};
+    float pointSize = 1.f;
+};
+
+// points drawn per pixel the bounding sphere covers, about half of a closed scan faces away
+constexpr float LOD_POINTS_PER_PIXEL = 2.f;
+// below this the subsample stops looking like the scan
+constexpr uint32_t MIN_LOD_POINTS = 1024;
+
+PointCloudRenderSystem::PointCloudRenderSystem(VkEngineDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout descriptorSetLayout) : vkEngineDevice{device} {
+    createPipelineLayout(descriptorSetLayout);
+    createPipeline(renderPass);
+}
+
+PointCloudRenderSystem::~PointCloudRenderSystem() { vkDestroyPipelineLayout(vkEngineDevice.device(), pipelineLayout, nullptr); }
+
+void
+PointCloudRenderSystem::createPipelineLayout(VkDescriptorSetLayout descriptorSetLayout) {
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PointCloudPushConstantData);
+
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{descriptorSetLayout};
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(vkEngineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout");
+    }
+}
+
+void
+PointCloudRenderSystem::createPipeline(VkRenderPass renderPass) {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+    PipelineConfigInfo pipelineConfig{};
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+    pipelineConfig.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    // points have no winding
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+    pipelineConfig.bindingDescription = PointCloud::Point::getBindingDescriptions();
+    pipelineConfig.attributeDescription = PointCloud::Point::getAttributeDescriptions();
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipeline = std::make_unique<Pipeline>(vkEngineDevice, "shaders/point_cloud_vert.spv", "shaders/point_cloud_frag.spv", pipelineConfig);
+}
+
+void
+PointCloudRenderSystem::render(FrameInfo &frameInfo) {
+    drawnPoints = 0;
+    Frustum frustum{frameInfo.camera.getProjection() * frameInfo.camera.getView()};
+
+    bool bound = false;
+    for (auto &kvPair : frameInfo.gameObject) {
+        auto &obj = kvPair.second;
+        if (obj.pointCloud == nullptr)
+            continue;
+
+        glm::mat4 modelMatrix = obj.transform.mat4();
+        BoundingSphere sphere = obj.pointCloud->getBounds().transformed(modelMatrix).sphere;
+        if (!frustum.intersectsSphere(sphere.center, sphere.radius))
+            continue;
+
+        if (!bound) {
+            pipeline->bind(frameInfo.commandBuffer);
+            vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+            bound = true;
+        }
+
+        Lod lod = selectLod(*obj.pointCloud, sphere, frameInfo);
+        PointCloudPushConstantData push{};
+        push.modelMatrix = modelMatrix;
+        push.pointSize = lod.pointSize;
+
+        vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PointCloudPushConstantData), &push);
+        obj.pointCloud->bind(frameInfo.commandBuffer);
+        obj.pointCloud->draw(frameInfo.commandBuffer, lod.pointCount);
+        drawnPoints += lod.pointCount;
+    }
+}
+
+PointCloudRenderSystem::Lod
+PointCloudRenderSystem::selectLod(const PointCloud &cloud, const BoundingSphere &sphere, const FrameInfo &frameInfo) const {
+    float viewportPixels = static_cast<float>(frameInfo.extent.width) * static_cast<float>(frameInfo.extent.height);
+
+    // radius of the projected bounding sphere in pixels, the whole viewport from inside of it
+    const glm::mat4 &projection = frameInfo.camera.getProjection();
+    float pixelsPerUnit = glm::abs(projection[1][1]) * .5f * static_cast<float>(frameInfo.extent.height);
+    float coveredPixels = viewportPixels;
+    if (projection[2][3] == 0.f) {
+        float radius = sphere.radius * pixelsPerUnit;
+        coveredPixels = glm::pi<float>() * radius * radius;
+    } else {
+        float distance = glm::length(sphere.center - frameInfo.camera.getPosition());
+        if (distance > sphere.radius) {
+            float radius = sphere.radius * pixelsPerUnit / std::sqrt(distance * distance - sphere.radius * sphere.radius);
+            coveredPixels = glm::pi<float>() * radius * radius;
+        }
+    }
+    coveredPixels = glm::min(coveredPixels, viewportPixels);
+
+    // every prefix of the buffer is an even subsample, so fewer points are just drawn larger
+    uint32_t pointCount = cloud.getPointCount();
+    float wanted = coveredPixels * LOD_POINTS_PER_PIXEL;
+    if (wanted < static_cast<float>(pointCount)) {
+        pointCount = std::max(std::min(MIN_LOD_POINTS, pointCount), static_cast<uint32_t>(wanted));
+    }
+
+    // one pixel at the wanted density, the visible points share the covered pixels below it
+    float pointSize = std::sqrt(wanted / static_cast<float>(pointCount));
+    return {pointCount, glm::clamp(pointSize, 1.f, vkEngineDevice.getMaxPointSize())};
+}
+
+}   // namespace vkEngine
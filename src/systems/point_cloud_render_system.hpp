@@ -0,0 +1,50 @@
+#pragma once
+
+#include "camera.hpp"
+#include "device.hpp"
+#include "frame_info.hpp"
+#include "game_object.hpp"
+#include "pipeline.hpp"
+#include "point_cloud.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace vkEngine {
+// Draws the point clouds of game objects as round point sprites, sized so the
+// points drawn cover the cloud's footprint on screen without holes.
+class PointCloudRenderSystem {
+public:
+  PointCloudRenderSystem(VkEngineDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout descriptorSetLayout);
+  ~PointCloudRenderSystem();
+
+  PointCloudRenderSystem(const PointCloudRenderSystem &) = delete;
+  PointCloudRenderSystem &operator=(const PointCloudRenderSystem &) = delete;
+
+  void render(FrameInfo &frameInfo);
+
+  // points drawn by the last render call, over all clouds
+  uint64_t getDrawnPoints() const { return drawnPoints; }
+
+private:
+  struct Lod {
+    uint32_t pointCount;
+    float pointSize;
+  };
+
+  void createPipelineLayout(VkDescriptorSetLayout descriptorSetLayout);
+  void createPipeline(VkRenderPass renderPass);
+  // subsamples clouds to a few points per pixel their world sphere covers on screen
+  Lod selectLod(const PointCloud &cloud, const BoundingSphere &sphere, const FrameInfo &frameInfo) const;
+
+  VkEngineDevice &vkEngineDevice;
+
+  std::unique_ptr<Pipeline> pipeline;
+  VkPipelineLayout pipelineLayout;
+  uint64_t drawnPoints = 0;
+};
+
+} // namespace vkEngine
@@ -75,7 +75,8 @@ void PointLightSystem::render(FrameInfo &frameInfo) {
 
   vkCmdBindDescriptorSets(frameInfo.commandBuffer,
                           VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-                          &frameInfo.globalDescriptorSet, 0, nullptr);
+                          &frameInfo.globalDescriptorSet, 1,
+                          &frameInfo.globalUboOffset);
 
   vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 }
@@ -1,5 +1,6 @@
 #include "simple_render_system.hpp"
 #include "camera.hpp"
+#include "frustum.hpp"
 #include <GLFW/glfw3.h>
 #include <array>
 #include <cmath>
@@ -23,6 +24,11 @@ struct SimplePushConstantData {
     glm::mat4 normalMatrix{1.f};
 };
 
+// coarsest level whose error stays below this many pixels on screen is drawn
+constexpr float MAX_LOD_PIXEL_ERROR = 1.f;
+// closer than this to the bounds the full mesh is drawn
+constexpr float MIN_LOD_DISTANCE = 1e-4f;
+
 SimpleRenderSystem::SimpleRenderSystem(VkEngineDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout descriptorSetLayout) : vkEngineDevice{device} {
     createPipelineLayout(descriptorSetLayout);
     createPipeline(renderPass);
@@ -61,27 +67,76 @@ SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
     pipelineConfig.renderPass = renderPass;
     pipelineConfig.pipelineLayout = pipelineLayout;
     pipeline = std::make_unique<Pipeline>(vkEngineDevice, "shaders/shader_vert.spv", "shaders/shader_frag.spv", pipelineConfig);
+
+    pipelineConfig.bindingDescription = Model::PackedVertex::getBindingDescriptions();
+    pipelineConfig.attributeDescription = Model::PackedVertex::getAttributeDescriptions();
+    packedPipeline = std::make_unique<Pipeline>(vkEngineDevice, "shaders/packed_shader_vert.spv", "shaders/shader_frag.spv", pipelineConfig);
 }
 
 void
 SimpleRenderSystem::renderGameObjects(FrameInfo &frameInfo) {
 
-    pipeline->bind(frameInfo.commandBuffer);
-
-    vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+    vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
 
+    Pipeline *boundPipeline = nullptr;
     for (auto &kvPair : frameInfo.gameObject) {
         auto &obj = kvPair.second;
+        if (obj.streamedModel != nullptr) {
+            // chunks hold full vertices, and whatever the last update made resident is drawn
+            if (boundPipeline != pipeline.get()) {
+                pipeline->bind(frameInfo.commandBuffer);
+                boundPipeline = pipeline.get();
+            }
+            SimplePushConstantData push{};
+            push.modelMatrix = obj.transform.mat4();
+            push.normalMatrix = obj.transform.normalMatrix();
+            vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
+            obj.streamedModel->draw(frameInfo.commandBuffer);
+            continue;
+        }
         if (obj.model == nullptr)
             continue;   // Skip over no associated model object
+        if (!obj.model->isResident())
+            continue;   // still loading in the background
+
+        // both pipelines share the layout, so the descriptor set stays bound
+        Pipeline *modelPipeline = obj.model->isQuantized() ? packedPipeline.get() : pipeline.get();
+        if (modelPipeline != boundPipeline) {
+            modelPipeline->bind(frameInfo.commandBuffer);
+            boundPipeline = modelPipeline;
+        }
+
+        glm::mat4 modelMatrix = obj.transform.mat4();
         SimplePushConstantData push{};
-        push.modelMatrix = obj.transform.mat4();
+        push.modelMatrix = modelMatrix * obj.model->getQuantization().matrix();
         push.normalMatrix = obj.transform.normalMatrix();
 
         vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
         obj.model->bind(frameInfo.commandBuffer);
-        obj.model->draw(frameInfo.commandBuffer);
+        obj.model->draw(frameInfo.commandBuffer, selectLod(*obj.model, modelMatrix, frameInfo));
+    }
+}
+
+uint32_t
+SimpleRenderSystem::selectLod(const Model &model, const glm::mat4 &modelMatrix, const FrameInfo &frameInfo) const {
+    const std::vector<Model::Lod> &lods = model.getLods();
+    // errors grow with the largest scale of the transform, as do the world bounds
+    float scale = getMaxScale(modelMatrix);
+
+    // a perspective projection shrinks the error with the distance to the nearest point of the bounds
+    const glm::mat4 &projection = frameInfo.camera.getProjection();
+    float pixelsPerUnit = glm::abs(projection[1][1]) * .5f * static_cast<float>(frameInfo.extent.height);
+    if (projection[2][3] != 0.f) {
+        BoundingSphere sphere = model.getWorldBounds(modelMatrix).sphere;
+        float distance = glm::length(sphere.center - frameInfo.camera.getPosition()) - sphere.radius;
+        pixelsPerUnit /= glm::max(distance, MIN_LOD_DISTANCE);
+    }
+
+    uint32_t lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * scale * pixelsPerUnit <= MAX_LOD_PIXEL_ERROR) {
+        lod++;
     }
+    return lod;
 }
 
 }   // namespace vkEngine
\ No newline at end of file
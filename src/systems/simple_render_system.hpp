@@ -26,10 +26,14 @@ public:
 private:
   void createPipelineLayout(VkDescriptorSetLayout descriptorSetLayout);
   void createPipeline(VkRenderPass renderPass);
+  // picks the level of detail from the error it projects to on screen
+  uint32_t selectLod(const Model &model, const glm::mat4 &modelMatrix, const FrameInfo &frameInfo) const;
 
   VkEngineDevice &vkEngineDevice;
 
   std::unique_ptr<Pipeline> pipeline;
+  // for models with Model::PackedVertex
+  std::unique_ptr<Pipeline> packedPipeline;
   VkPipelineLayout pipelineLayout;
 };
 
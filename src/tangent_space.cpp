@@ -0,0 +1,289 @@
+#include "tangent_space.hpp"
+#include "mesh_optimizer.hpp"
+#include "utils.hpp"
+#include "vertex_welder.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace vkEngine {
+
+namespace {
+
+// triangles or vertices per parallelFor task
+constexpr size_t BLOCK_SIZE = 4096;
+
+template <typename Fn> void parallelBlocks(size_t count, Fn &&fn) {
+  parallelFor((count + BLOCK_SIZE - 1) / BLOCK_SIZE, [&](size_t block) {
+    size_t begin = block * BLOCK_SIZE;
+    fn(begin, std::min(begin + BLOCK_SIZE, count));
+  });
+}
+
+// Sums corner contributions, four lanes at a time where SSE2 is available.
+class Accumulator {
+public:
+#ifdef VKENGINE_SSE2
+  void add(const glm::vec4 &value) {
+    sum = _mm_add_ps(sum, _mm_loadu_ps(&value.x));
+  }
+  glm::vec4 get() const {
+    glm::vec4 value;
+    _mm_storeu_ps(&value.x, sum);
+    return value;
+  }
+
+private:
+  __m128 sum = _mm_setzero_ps();
+#else
+  void add(const glm::vec4 &value) { sum += value; }
+  glm::vec4 get() const { return sum; }
+
+private:
+  glm::vec4 sum{0.f};
+#endif
+};
+
+// Calls fn(corner) for the corners of key in the triangles adjacent to it.
+// keys holds the key of every corner, the adjacency is built over keys.
+template <typename Fn>
+void forEachCorner(const TriangleAdjacency &adjacency,
+                   const std::vector<uint32_t> &keys, uint32_t key, Fn &&fn) {
+  uint32_t previous = UINT32_MAX;
+  for (uint32_t i = adjacency.offsets[key]; i < adjacency.offsets[key + 1];
+       i++) {
+    uint32_t triangle = adjacency.triangles[i];
+    // a triangle with the key at two corners is listed twice
+    if (triangle == previous) {
+      continue;
+    }
+    previous = triangle;
+    for (uint32_t corner = 3 * triangle; corner < 3 * triangle + 3; corner++) {
+      if (keys[corner] == key) {
+        fn(corner);
+      }
+    }
+  }
+}
+
+// angle between the edges leaving corner, 0 if one of them is degenerate
+float getCornerAngle(const glm::vec3 &corner, const glm::vec3 &a,
+                     const glm::vec3 &b) {
+  glm::vec3 u = a - corner;
+  glm::vec3 v = b - corner;
+  float lengths = glm::length(u) * glm::length(v);
+  if (lengths <= 0.f) {
+    return 0.f;
+  }
+  return std::acos(std::clamp(glm::dot(u, v) / lengths, -1.f, 1.f));
+}
+
+glm::vec3 getAnyPerpendicular(const glm::vec3 &normal) {
+  glm::vec3 axis = std::fabs(normal.x) < .9f ? glm::vec3{1.f, 0.f, 0.f}
+                                             : glm::vec3{0.f, 1.f, 0.f};
+  glm::vec3 perpendicular = glm::cross(normal, axis);
+  float length = glm::length(perpendicular);
+  return length > 0.f ? perpendicular / length : axis;
+}
+
+} // namespace
+
+size_t generateNormals(std::vector<Model::Vertex> &vertices,
+                       const std::vector<uint32_t> &indices, bool onlyMissing,
+                       bool angleWeighted) {
+  if (indices.empty()) {
+    return 0;
+  }
+  if (onlyMissing &&
+      std::none_of(vertices.begin(), vertices.end(),
+                   [](const Model::Vertex &vertex) {
+                     return vertex.normal == glm::vec3{0.f};
+                   })) {
+    return 0;
+  }
+
+  // vertices split on other attributes still share the normal
+  std::vector<Model::Vertex> positions;
+  std::vector<uint32_t> positionIds(vertices.size());
+  {
+    VertexWelder welder{positions, 0.f, vertices.size()};
+    for (size_t v = 0; v < vertices.size(); v++) {
+      Model::Vertex key{};
+      key.position = vertices[v].position;
+      positionIds[v] = welder.weld(key);
+    }
+  }
+
+  // weighted face normal per corner, summed per position below
+  std::vector<uint32_t> cornerPositions(indices.size());
+  std::vector<glm::vec4> cornerNormals(indices.size());
+  parallelBlocks(indices.size() / 3, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; t++) {
+      glm::vec3 p[3];
+      for (size_t k = 0; k < 3; k++) {
+        p[k] = vertices[indices[3 * t + k]].position;
+        cornerPositions[3 * t + k] = positionIds[indices[3 * t + k]];
+      }
+      // as long as twice the triangle's area, which is the area weight
+      glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+      if (angleWeighted) {
+        float length = glm::length(normal);
+        normal = length > 0.f ? normal / length : glm::vec3{0.f};
+      }
+      for (size_t k = 0; k < 3; k++) {
+        float weight =
+            angleWeighted
+                ? getCornerAngle(p[k], p[(k + 1) % 3], p[(k + 2) % 3])
+                : 1.f;
+        cornerNormals[3 * t + k] = glm::vec4{normal * weight, 0.f};
+      }
+    }
+  });
+
+  TriangleAdjacency adjacency{cornerPositions, positions.size()};
+  std::vector<glm::vec3> normals(positions.size());
+  parallelBlocks(positions.size(), [&](size_t begin, size_t end) {
+    for (size_t g = begin; g < end; g++) {
+      Accumulator sum;
+      forEachCorner(adjacency, cornerPositions, static_cast<uint32_t>(g),
+                    [&](uint32_t corner) { sum.add(cornerNormals[corner]); });
+      glm::vec3 normal{sum.get()};
+      float length = glm::length(normal);
+      normals[g] = length > 0.f ? normal / length : glm::vec3{0.f};
+    }
+  });
+
+  std::atomic<size_t> written{0};
+  parallelBlocks(vertices.size(), [&](size_t begin, size_t end) {
+    size_t count = 0;
+    for (size_t v = begin; v < end; v++) {
+      const glm::vec3 &normal = normals[positionIds[v]];
+      // isolated and degenerate vertices keep what they have
+      if ((onlyMissing && vertices[v].normal != glm::vec3{0.f}) ||
+          normal == glm::vec3{0.f}) {
+        continue;
+      }
+      vertices[v].normal = normal;
+      count++;
+    }
+    written += count;
+  });
+  return written;
+}
+
+size_t generateAngleWeightedTangents(std::vector<Model::Vertex> &vertices,
+                                     std::vector<uint32_t> &indices,
+                                     std::vector<glm::vec4> &tangents) {
+  tangents.assign(vertices.size(), glm::vec4{0.f});
+  if (indices.empty()) {
+    return 0;
+  }
+
+  // angle weighted tangent per corner in the plane of the vertex normal, w is
+  // the weight signed with the handedness of the triangle's uv mapping and 0
+  // where the uvs give no direction
+  std::vector<glm::vec4> cornerTangents(indices.size());
+  parallelBlocks(indices.size() / 3, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; t++) {
+      const Model::Vertex *v[3] = {&vertices[indices[3 * t]],
+                                   &vertices[indices[3 * t + 1]],
+                                   &vertices[indices[3 * t + 2]]};
+      glm::vec3 e1 = v[1]->position - v[0]->position;
+      glm::vec3 e2 = v[2]->position - v[0]->position;
+      glm::vec2 d1 = v[1]->uv - v[0]->uv;
+      glm::vec2 d2 = v[2]->uv - v[0]->uv;
+      // twice the signed uv area, its sign is the handedness
+      float uvArea = d1.x * d2.y - d2.x * d1.y;
+      glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) * (uvArea < 0.f ? -1.f : 1.f);
+      float handedness = uvArea < 0.f ? -1.f : 1.f;
+
+      for (size_t k = 0; k < 3; k++) {
+        const glm::vec3 &normal = v[k]->normal;
+        glm::vec3 projected = tangent - normal * glm::dot(normal, tangent);
+        float length = glm::length(projected);
+        float angle = getCornerAngle(v[k]->position, v[(k + 1) % 3]->position,
+                                     v[(k + 2) % 3]->position);
+        cornerTangents[3 * t + k] =
+            uvArea != 0.f && length > 0.f && angle > 0.f
+                ? glm::vec4{projected * (angle / length), handedness * angle}
+                : glm::vec4{0.f};
+      }
+    }
+  });
+
+  // per vertex, the side with more weight stays and the other one moves to a
+  // new vertex appended after the existing ones
+  size_t vertexCount = vertices.size();
+  TriangleAdjacency adjacency{indices, vertexCount};
+  std::vector<glm::vec4> sums[2] = {std::vector<glm::vec4>(vertexCount),
+                                    std::vector<glm::vec4>(vertexCount)};
+  parallelBlocks(vertexCount, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      Accumulator right;
+      Accumulator left;
+      forEachCorner(adjacency, indices, static_cast<uint32_t>(v),
+                    [&](uint32_t corner) {
+                      const glm::vec4 &tangent = cornerTangents[corner];
+                      if (tangent.w > 0.f) {
+                        right.add(tangent);
+                      } else if (tangent.w < 0.f) {
+                        left.add(tangent);
+                      }
+                    });
+      sums[0][v] = right.get();
+      sums[1][v] = left.get();
+    }
+  });
+
+  std::vector<uint32_t> splitVertex(vertexCount, UINT32_MAX);
+  uint32_t nextVertex = static_cast<uint32_t>(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    if (sums[0][v].w != 0.f && sums[1][v].w != 0.f) {
+      splitVertex[v] = nextVertex++;
+    }
+  }
+  vertices.resize(nextVertex);
+  tangents.resize(nextVertex);
+
+  auto finish = [&](const glm::vec4 &sum, const glm::vec3 &normal,
+                    float handedness) {
+    glm::vec3 tangent{sum};
+    float length = glm::length(tangent);
+    return glm::vec4{length > 0.f ? tangent / length
+                                  : getAnyPerpendicular(normal),
+                     handedness};
+  };
+
+  // corners are rewritten into a copy, the adjacency scan reads the original
+  std::vector<uint32_t> splitIndices = indices;
+  parallelBlocks(vertexCount, [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end; v++) {
+      const glm::vec4 &right = sums[0][v];
+      const glm::vec4 &left = sums[1][v];
+      bool rightStays = right.w >= -left.w;
+      tangents[v] = rightStays ? finish(right, vertices[v].normal, 1.f)
+                               : finish(left, vertices[v].normal, -1.f);
+      if (splitVertex[v] == UINT32_MAX) {
+        continue;
+      }
+
+      vertices[splitVertex[v]] = vertices[v];
+      tangents[splitVertex[v]] = rightStays
+                                     ? finish(left, vertices[v].normal, -1.f)
+                                     : finish(right, vertices[v].normal, 1.f);
+      forEachCorner(adjacency, indices, static_cast<uint32_t>(v),
+                    [&](uint32_t corner) {
+                      float w = cornerTangents[corner].w;
+                      if (rightStays ? w < 0.f : w > 0.f) {
+                        splitIndices[corner] = splitVertex[v];
+                      }
+                    });
+    }
+  });
+  indices = std::move(splitIndices);
+  return nextVertex - vertexCount;
+}
+
+} // namespace vkEngine
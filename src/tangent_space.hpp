@@ -0,0 +1,36 @@
+#pragma once
+
+#include "model.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkEngine {
+
+// Computes smooth vertex normals from the triangles, weighing every face by
+// its area or by its angle at the vertex. Vertices at the same position share
+// the normal, so vertices split on uvs or colors do not show a seam. With
+// onlyMissing only zero normals are replaced. Returns the number of normals
+// written.
+size_t generateNormals(std::vector<Model::Vertex> &vertices,
+                       const std::vector<uint32_t> &indices, bool onlyMissing,
+                       bool angleWeighted);
+
+// Computes one tangent per vertex into tangents, w is the handedness and the
+// bitangent w * cross(normal, tangent). Every corner contributes the uv
+// aligned tangent of its triangle, projected onto the plane of the vertex
+// normal and weighted by the corner angle. A vertex whose triangles disagree
+// on the handedness, e.g. on mirrored uvs, is split in two. Vertices without
+// a usable uv gradient get some tangent perpendicular to the normal. Returns
+// the number of vertices added by splits.
+//
+// Normal maps are usually baked against MikkTSpace tangents, which these are
+// not, so such maps can show faint seams. Their assets should bring their own
+// tangents (glTF TANGENT).
+size_t generateAngleWeightedTangents(std::vector<Model::Vertex> &vertices,
+                                     std::vector<uint32_t> &indices,
+                                     std::vector<glm::vec4> &tangents);
+
+} // namespace vkEngine
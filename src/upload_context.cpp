@@ -0,0 +1,306 @@
+#include "upload_context.hpp"
+
+// std
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace vkEngine {
+
+namespace {
+
+// stages and accesses that consume uploaded data
+constexpr VkPipelineStageFlags CONSUMER_STAGES =
+    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+constexpr VkAccessFlags CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                          VK_ACCESS_INDEX_READ_BIT |
+                                          VK_ACCESS_SHADER_READ_BIT;
+
+} // namespace
+
+VkEngineUploadBatch::VkEngineUploadBatch(VkEngineDevice &device)
+    : vkEngineDevice{device} {}
+
+VkEngineUploadBatch::~VkEngineUploadBatch() {
+  if (submitted && !completed) {
+    // the copies may still read from the staging buffers
+    vkWaitForFences(vkEngineDevice.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+  vkEngineDevice.getStagingPool().release(staging);
+  if (fence != VK_NULL_HANDLE) {
+    vkDestroyFence(vkEngineDevice.device(), fence, nullptr);
+  }
+  if (transferDone != VK_NULL_HANDLE) {
+    vkDestroySemaphore(vkEngineDevice.device(), transferDone, nullptr);
+  }
+  if (commandBuffer != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(vkEngineDevice.device(),
+                         vkEngineDevice.getTransferCommandPool(), 1,
+                         &commandBuffer);
+  }
+  if (acquireCommandBuffer != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(vkEngineDevice.device(),
+                         vkEngineDevice.getCommandPool(), 1,
+                         &acquireCommandBuffer);
+  }
+}
+
+VkCommandBuffer VkEngineUploadBatch::beginCommandBuffer(VkCommandPool pool) {
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = pool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer buffer;
+  if (vkAllocateCommandBuffers(vkEngineDevice.device(), &allocInfo, &buffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload command buffer!");
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(buffer, &beginInfo);
+  return buffer;
+}
+
+VkCommandBuffer VkEngineUploadBatch::getCommandBuffer() {
+  assert(!submitted && "Cannot record into a submitted upload batch");
+  if (commandBuffer == VK_NULL_HANDLE) {
+    commandBuffer = beginCommandBuffer(vkEngineDevice.getTransferCommandPool());
+  }
+  return commandBuffer;
+}
+
+void VkEngineUploadBatch::addOwnershipTransfer(VkBuffer buffer,
+                                               VkDeviceSize offset,
+                                               VkDeviceSize size) {
+  if (!vkEngineDevice.hasDedicatedTransferQueue()) {
+    return;
+  }
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = vkEngineDevice.getTransferQueueFamily();
+  barrier.dstQueueFamilyIndex = vkEngineDevice.getGraphicsQueueFamily();
+  barrier.buffer = buffer;
+  // only the copied range, the rest of the buffer may be in use by graphics
+  barrier.offset = offset;
+  barrier.size = size;
+  bufferTransfers.push_back(barrier);
+}
+
+void VkEngineUploadBatch::addOwnershipTransfer(VkImage image,
+                                               uint32_t layerCount) {
+  if (!vkEngineDevice.hasDedicatedTransferQueue()) {
+    return;
+  }
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  // the layout is left alone, only ownership moves
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = vkEngineDevice.getTransferQueueFamily();
+  barrier.dstQueueFamilyIndex = vkEngineDevice.getGraphicsQueueFamily();
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = layerCount;
+  imageTransfers.push_back(barrier);
+}
+
+void VkEngineUploadBatch::uploadToBuffer(const void *data, VkDeviceSize size,
+                                         VkBuffer dstBuffer,
+                                         VkDeviceSize dstOffset) {
+  uploadToBuffer(
+      size, dstBuffer,
+      [data, size](void *staging) {
+        std::memcpy(staging, data, static_cast<size_t>(size));
+      },
+      dstOffset);
+}
+
+void VkEngineUploadBatch::uploadToBuffer(
+    VkDeviceSize size, VkBuffer dstBuffer,
+    const std::function<void(void *)> &fill, VkDeviceSize dstOffset) {
+  VkEngineStagingPool::Range range =
+      vkEngineDevice.getStagingPool().allocate(staging, size);
+  fill(range.mapped);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = range.offset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(getCommandBuffer(), range.buffer, dstBuffer, 1, &copyRegion);
+  addOwnershipTransfer(dstBuffer, dstOffset, size);
+
+  stagedBytes += size;
+}
+
+void VkEngineUploadBatch::uploadToImage(const void *data, VkDeviceSize size,
+                                        VkImage image, uint32_t width,
+                                        uint32_t height, uint32_t layerCount) {
+  VkEngineStagingPool::Range range =
+      vkEngineDevice.getStagingPool().allocate(staging, size);
+  std::memcpy(range.mapped, data, static_cast<size_t>(size));
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = range.offset;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = layerCount;
+  region.imageExtent = {width, height, 1};
+  vkCmdCopyBufferToImage(getCommandBuffer(), range.buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  addOwnershipTransfer(image, layerCount);
+
+  stagedBytes += size;
+}
+
+void VkEngineUploadBatch::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
+                                     VkDeviceSize size) {
+  VkBufferCopy copyRegion{};
+  copyRegion.size = size;
+  vkCmdCopyBuffer(getCommandBuffer(), srcBuffer, dstBuffer, 1, &copyRegion);
+  addOwnershipTransfer(dstBuffer, 0, size);
+}
+
+void VkEngineUploadBatch::onComplete(std::function<void()> callback) {
+  callbacks.push_back(std::move(callback));
+}
+
+void VkEngineUploadBatch::submit() {
+  assert(!submitted && "Upload batch was already submitted");
+  if (empty()) {
+    complete();
+    return;
+  }
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(vkEngineDevice.device(), &fenceInfo, nullptr, &fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload fence!");
+  }
+
+  if (vkEngineDevice.hasDedicatedTransferQueue()) {
+    submitDedicated();
+  } else {
+    submitGraphics();
+  }
+  submitted = true;
+}
+
+void VkEngineUploadBatch::submitGraphics() {
+  // make the copies visible to every draw submitted after this batch
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = CONSUMER_ACCESS;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       CONSUMER_STAGES, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  vkEndCommandBuffer(commandBuffer);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  if (vkQueueSubmit(vkEngineDevice.graphicsQueue(), 1, &submitInfo, fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload batch!");
+  }
+}
+
+void VkEngineUploadBatch::submitDedicated() {
+  // release on the transfer queue
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                       static_cast<uint32_t>(bufferTransfers.size()),
+                       bufferTransfers.data(),
+                       static_cast<uint32_t>(imageTransfers.size()),
+                       imageTransfers.data());
+  vkEndCommandBuffer(commandBuffer);
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  if (vkCreateSemaphore(vkEngineDevice.device(), &semaphoreInfo, nullptr,
+                        &transferDone) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload semaphore!");
+  }
+
+  VkSubmitInfo transferSubmit{};
+  transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  transferSubmit.commandBufferCount = 1;
+  transferSubmit.pCommandBuffers = &commandBuffer;
+  transferSubmit.signalSemaphoreCount = 1;
+  transferSubmit.pSignalSemaphores = &transferDone;
+  if (vkQueueSubmit(vkEngineDevice.transferQueue(), 1, &transferSubmit,
+                    VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload batch!");
+  }
+
+  // acquire on the graphics queue, the access masks of the release half do
+  // not apply here
+  for (auto &barrier : bufferTransfers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = CONSUMER_ACCESS;
+  }
+  for (auto &barrier : imageTransfers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+  acquireCommandBuffer = beginCommandBuffer(vkEngineDevice.getCommandPool());
+  vkCmdPipelineBarrier(acquireCommandBuffer, CONSUMER_STAGES, CONSUMER_STAGES,
+                       0, 0, nullptr,
+                       static_cast<uint32_t>(bufferTransfers.size()),
+                       bufferTransfers.data(),
+                       static_cast<uint32_t>(imageTransfers.size()),
+                       imageTransfers.data());
+  vkEndCommandBuffer(acquireCommandBuffer);
+
+  VkPipelineStageFlags waitStage = CONSUMER_STAGES;
+  VkSubmitInfo acquireSubmit{};
+  acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  acquireSubmit.waitSemaphoreCount = 1;
+  acquireSubmit.pWaitSemaphores = &transferDone;
+  acquireSubmit.pWaitDstStageMask = &waitStage;
+  acquireSubmit.commandBufferCount = 1;
+  acquireSubmit.pCommandBuffers = &acquireCommandBuffer;
+  if (vkQueueSubmit(vkEngineDevice.graphicsQueue(), 1, &acquireSubmit, fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload acquire!");
+  }
+}
+
+bool VkEngineUploadBatch::poll() {
+  if (!completed && submitted &&
+      vkGetFenceStatus(vkEngineDevice.device(), fence) == VK_SUCCESS) {
+    complete();
+  }
+  return completed;
+}
+
+void VkEngineUploadBatch::wait() {
+  if (!completed && submitted) {
+    vkWaitForFences(vkEngineDevice.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+    complete();
+  }
+}
+
+void VkEngineUploadBatch::complete() {
+  completed = true;
+  vkEngineDevice.getStagingPool().release(staging);
+  for (auto &callback : callbacks) {
+    callback();
+  }
+  callbacks.clear();
+}
+
+} // namespace vkEngine
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "staging_pool.hpp"
+
+// std
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace vkEngine {
+
+// Records any number of staging copies into a single command buffer that is
+// submitted with one fence, instead of one submit and vkQueueWaitIdle per
+// copy. Staging memory is leased from the device's VkEngineStagingPool and
+// returned to it once the fence has signaled.
+//
+// With a dedicated transfer queue the copies run there, overlapping with
+// rendering. Every destination is then released to the graphics family at
+// the end of the copies and acquired by a small graphics submission that
+// waits on a semaphore, which is what the fence is attached to.
+//
+// A batch is recorded, submitted once and then polled until it completes.
+// All calls must come from the thread that submits to the device's queues.
+class VkEngineUploadBatch {
+public:
+  explicit VkEngineUploadBatch(VkEngineDevice &device);
+  ~VkEngineUploadBatch();
+
+  VkEngineUploadBatch(const VkEngineUploadBatch &) = delete;
+  VkEngineUploadBatch &operator=(const VkEngineUploadBatch &) = delete;
+
+  // Copies data into staging memory and records its copy into dstBuffer.
+  void uploadToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer,
+                      VkDeviceSize dstOffset = 0);
+  // Same, but fill writes the size bytes straight into the mapped staging
+  // memory, for data that is converted on its way to the GPU.
+  void uploadToBuffer(VkDeviceSize size, VkBuffer dstBuffer,
+                      const std::function<void(void *)> &fill,
+                      VkDeviceSize dstOffset = 0);
+  // image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+  void uploadToImage(const void *data, VkDeviceSize size, VkImage image,
+                     uint32_t width, uint32_t height, uint32_t layerCount);
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+
+  // runs once the uploads are complete, e.g. to mark a resource resident
+  void onComplete(std::function<void()> callback);
+
+  // Submits everything recorded so far. Nothing can be recorded afterwards.
+  void submit();
+  // Returns the staging memory and runs the callbacks once the fence has
+  // signaled. Returns true when the batch is complete.
+  bool poll();
+  void wait();
+
+  bool empty() const { return commandBuffer == VK_NULL_HANDLE; }
+  VkDeviceSize getStagedBytes() const { return stagedBytes; }
+
+private:
+  VkCommandBuffer getCommandBuffer();
+  VkCommandBuffer beginCommandBuffer(VkCommandPool pool);
+  void addOwnershipTransfer(VkBuffer buffer, VkDeviceSize offset,
+                            VkDeviceSize size);
+  void addOwnershipTransfer(VkImage image, uint32_t layerCount);
+  void submitDedicated();
+  void submitGraphics();
+  void complete();
+
+  VkEngineDevice &vkEngineDevice;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+  VkSemaphore transferDone = VK_NULL_HANDLE;
+  VkFence fence = VK_NULL_HANDLE;
+  bool submitted = false;
+  bool completed = false;
+
+  VkEngineStagingPool::Lease staging;
+  // release barriers, recorded again as acquire barriers on graphics
+  std::vector<VkBufferMemoryBarrier> bufferTransfers;
+  std::vector<VkImageMemoryBarrier> imageTransfers;
+  std::vector<std::function<void()>> callbacks;
+  VkDeviceSize stagedBytes = 0;
+};
+
+} // namespace vkEngine
@@ -1,6 +1,24 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SSE2 is part of every x86-64 target, elsewhere the scalar paths are used
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKENGINE_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace vkEngine {
 
@@ -11,4 +29,96 @@ void hashCombine(std::size_t& seed, const T& v, const Rest&... rest) {
   (hashCombine(seed, rest), ...);
 };
 
+// Fast non cryptographic 64 bit hash of a byte range, eight bytes at a time.
+// Used to tell whether a file's contents changed, not for hash tables.
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0) {
+  const char *bytes = static_cast<const char *>(data);
+  uint64_t h = seed ^ (0x9e3779b97f4a7c15ULL * (size + 1));
+  auto mix = [&h](uint64_t word) {
+    word *= 0x87c37b91114253d5ULL;
+    word = (word << 31) | (word >> 33);
+    h ^= word * 0x4cf5ad432745937fULL;
+    h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
+  };
+
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    mix(word);
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + i, size - i);
+    mix(word);
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// case insensitive, extension includes the dot
+inline bool hasExtension(const std::string &filepath,
+                         const std::string &extension) {
+  if (filepath.size() < extension.size()) {
+    return false;
+  }
+  return std::equal(extension.rbegin(), extension.rend(), filepath.rbegin(),
+                    [](char a, char b) {
+                      return std::tolower(static_cast<unsigned char>(a)) ==
+                             std::tolower(static_cast<unsigned char>(b));
+                    });
+}
+
+inline size_t workerCount() {
+  size_t count = std::thread::hardware_concurrency();
+  return count == 0 ? 1 : count;
+}
+
+// Runs fn(i) for every i in [0, count) on up to workerCount() threads, the
+// calling thread included. The first exception thrown by a task is rethrown
+// once all threads have joined.
+template <typename Fn>
+void parallelFor(size_t count, Fn &&fn) {
+  size_t threadCount = std::min(count, workerCount());
+  if (threadCount <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      try {
+        fn(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{errorMutex};
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount - 1);
+  for (size_t i = 1; i < threadCount; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
 }  // namespace vkEngine
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "vertex_welder.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vkEngine {
+
+namespace {
+
+constexpr size_t VERTEX_COMPONENTS = sizeof(Model::Vertex) / sizeof(float);
+static_assert(sizeof(Model::Vertex) == VERTEX_COMPONENTS * sizeof(float),
+              "Model::Vertex is expected to be a tightly packed set of floats");
+
+// murmur3 finalizer
+uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace
+
+VertexWelder::VertexWelder(std::vector<Model::Vertex> &vertices, float epsilon,
+                           size_t expectedVertexCount)
+    : vertices{vertices}, inverseEpsilon{epsilon > 0.f ? 1.f / epsilon : 0.f} {
+  size_t capacity = 16;
+  while (capacity < 2 * std::max(expectedVertexCount, vertices.size())) {
+    capacity *= 2;
+  }
+  vertices.reserve(expectedVertexCount);
+
+  // index anything that is already in the output
+  rebuild(capacity);
+}
+
+uint32_t VertexWelder::weld(const Model::Vertex &vertex) {
+  // keep the load factor at or below one half so probe sequences stay short
+  if (2 * (vertices.size() + 1) > slots.size()) {
+    rebuild(slots.size() * 2);
+  }
+
+  uint64_t h = hash(vertex);
+  uint64_t tag = h & ~uint64_t{UINT32_MAX};
+  uint64_t slot = h & slotMask;
+  while (true) {
+    probeCount++;
+    uint64_t entry = slots[slot];
+    if (entry == EMPTY_SLOT) {
+      uint32_t index = static_cast<uint32_t>(vertices.size());
+      slots[slot] = tag | index;
+      vertices.push_back(vertex);
+      return index;
+    }
+    uint32_t index = static_cast<uint32_t>(entry);
+    if ((entry & ~uint64_t{UINT32_MAX}) == tag && equal(vertices[index], vertex)) {
+      return index;
+    }
+    slot = (slot + 1) & slotMask;
+  }
+}
+
+uint64_t VertexWelder::hash(const Model::Vertex &vertex) const {
+  float components[VERTEX_COMPONENTS];
+  std::memcpy(components, &vertex, sizeof(components));
+
+  uint64_t h = 0x9e3779b97f4a7c15ULL;
+  for (float component : components) {
+    uint64_t word;
+    if (inverseEpsilon > 0.f) {
+      word = static_cast<uint64_t>(std::llround(component * inverseEpsilon));
+    } else {
+      uint32_t bits;
+      std::memcpy(&bits, &component, sizeof(bits));
+      word = bits == 0x80000000u ? 0u : bits; // -0.0 == 0.0
+    }
+    h = (h ^ word) * 0x100000001b3ULL;
+  }
+  return mix(h);
+}
+
+bool VertexWelder::equal(const Model::Vertex &a, const Model::Vertex &b) const {
+  if (inverseEpsilon == 0.f) {
+    return a == b;
+  }
+
+  float componentsA[VERTEX_COMPONENTS];
+  float componentsB[VERTEX_COMPONENTS];
+  std::memcpy(componentsA, &a, sizeof(componentsA));
+  std::memcpy(componentsB, &b, sizeof(componentsB));
+  for (size_t i = 0; i < VERTEX_COMPONENTS; i++) {
+    if (std::llround(componentsA[i] * inverseEpsilon) !=
+        std::llround(componentsB[i] * inverseEpsilon)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void VertexWelder::rebuild(size_t capacity) {
+  slots.assign(capacity, EMPTY_SLOT);
+  slotMask = capacity - 1;
+
+  for (size_t i = 0; i < vertices.size(); i++) {
+    uint64_t h = hash(vertices[i]);
+    uint64_t slot = h & slotMask;
+    while (slots[slot] != EMPTY_SLOT) {
+      slot = (slot + 1) & slotMask;
+    }
+    slots[slot] = (h & ~uint64_t{UINT32_MAX}) | i;
+  }
+}
+
+} // namespace vkEngine
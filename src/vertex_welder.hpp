@@ -0,0 +1,49 @@
+#pragma once
+
+#include "model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vkEngine {
+
+// Deduplicates vertices into an output array through an open addressing
+// (linear probing) table of indices, so welding a vertex costs a single
+// probe sequence and no allocation per unique vertex.
+//
+// With epsilon == 0 vertices are welded on their exact bits, with -0.0 and
+// 0.0 treated as equal. A positive epsilon snaps every component to a grid
+// of that size before comparing, which also welds near duplicates left by
+// exporters. The stored vertex is the first one that landed in a cell.
+class VertexWelder {
+public:
+  VertexWelder(std::vector<Model::Vertex> &vertices, float epsilon = 0.f,
+               size_t expectedVertexCount = 0);
+
+  VertexWelder(const VertexWelder &) = delete;
+  VertexWelder &operator=(const VertexWelder &) = delete;
+
+  // Returns the index of the matching vertex, appending it if it is new.
+  uint32_t weld(const Model::Vertex &vertex);
+
+  size_t getProbeCount() const { return probeCount; }
+
+private:
+  // a slot packs the upper hash bits with the vertex index, so most
+  // mismatches are rejected without touching the vertex array
+  static constexpr uint64_t EMPTY_SLOT = UINT64_MAX;
+
+  uint64_t hash(const Model::Vertex &vertex) const;
+  bool equal(const Model::Vertex &a, const Model::Vertex &b) const;
+  void rebuild(size_t capacity);
+
+  std::vector<Model::Vertex> &vertices;
+  float inverseEpsilon;
+
+  std::vector<uint64_t> slots;
+  uint64_t slotMask;
+  size_t probeCount = 0;
+};
+
+} // namespace vkEngine